@@ -0,0 +1,388 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Запуск одной конфигурации бенчмарка: команда после "--" выполняется
+// warmup раз без учёта и runs раз с замером. Время берётся из строки
+// "<metric>: <число>" в выводе программы (собственный замер программы,
+// без запуска процесса и генерации данных), а если такой строки нет -
+// по часам CLOCK_MONOTONIC вокруг fork/exec/wait.
+//
+// Итог: min, медиана и p95 в миллисекундах; строка дописывается в CSV
+// (заголовок - при создании файла) и в JSON Lines.
+//
+// Режим --compare old.csv new.csv сравнивает медианы одинаковых
+// конфигураций (name + params) и возвращает 1, если хотя бы одна стала
+// медленнее больше чем на threshold процентов.
+
+#define CSV_HEADER "name,params,metric,runs,min_ms,median_ms,p95_ms,wall_median_ms\n"
+#define OUTPUT_MAX (1 << 20)
+
+static double NowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Перцентиль методом ближайшего ранга по отсортированному массиву
+static double Percentile(const double *sorted, int count, double p) {
+    int rank = (int)(p / 100.0 * count + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+    return sorted[rank - 1];
+}
+
+// Последнее вхождение "<metric>:" в выводе; число сразу после двоеточия
+static bool ParseMetric(const char *output, const char *metric, double *value) {
+    size_t len = strlen(metric);
+    const char *found = NULL;
+    for (const char *p = strstr(output, metric); p != NULL;
+         p = strstr(p + 1, metric)) {
+        if (p[len] == ':')
+            found = p;
+    }
+    if (found == NULL)
+        return false;
+    char *end;
+    double parsed = strtod(found + len + 1, &end);
+    if (end == found + len + 1)
+        return false;
+    *value = parsed;
+    return true;
+}
+
+// Один запуск команды. Возвращает 0 при нулевом коде выхода;
+// *metric_ms < 0, если в выводе нет метрики.
+static int RunOnce(char **command, const char *metric, double *wall_ms,
+                   double *metric_ms) {
+    int pipefd[2];
+    if (pipe(pipefd) == -1) {
+        perror("pipe");
+        return -1;
+    }
+
+    double start = NowMs();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(pipefd[0]);
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[1]);
+        execvp(command[0], command);
+        perror(command[0]);
+        _exit(127);
+    }
+    close(pipefd[1]);
+
+    // Вывод читается целиком, чтобы ребёнок не заблокировался на записи
+    static char output[OUTPUT_MAX];
+    size_t used = 0;
+    for (;;) {
+        char sink[4096];
+        char *dst = used < OUTPUT_MAX - 1 ? output + used : sink;
+        size_t room = used < OUTPUT_MAX - 1 ? OUTPUT_MAX - 1 - used : sizeof(sink);
+        ssize_t got = read(pipefd[0], dst, room);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        if (dst == output + used)
+            used += (size_t)got;
+    }
+    output[used] = '\0';
+    close(pipefd[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            return -1;
+        }
+    }
+    *wall_ms = NowMs() - start;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Command failed (status %d): %s\n",
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1, command[0]);
+        return -1;
+    }
+    if (!ParseMetric(output, metric, metric_ms))
+        *metric_ms = -1;
+    return 0;
+}
+
+static void AppendCsv(const char *path, const char *name, const char *params,
+                      const char *metric, int runs, double min, double median,
+                      double p95, double wall_median) {
+    struct stat st;
+    bool fresh = stat(path, &st) != 0 || st.st_size == 0;
+    FILE *file = fopen(path, "a");
+    if (file == NULL) {
+        perror(path);
+        return;
+    }
+    if (fresh)
+        fputs(CSV_HEADER, file);
+    fprintf(file, "%s,%s,%s,%d,%.3f,%.3f,%.3f,%.3f\n", name, params, metric,
+            runs, min, median, p95, wall_median);
+    fclose(file);
+}
+
+static void AppendJson(const char *path, const char *name, const char *params,
+                       const char *metric, const double *samples, int runs,
+                       double min, double median, double p95,
+                       double wall_median) {
+    FILE *file = fopen(path, "a");
+    if (file == NULL) {
+        perror(path);
+        return;
+    }
+    fprintf(file,
+            "{\"name\": \"%s\", \"params\": \"%s\", \"metric\": \"%s\", "
+            "\"runs\": %d, \"min_ms\": %.3f, \"median_ms\": %.3f, "
+            "\"p95_ms\": %.3f, \"wall_median_ms\": %.3f, \"samples_ms\": [",
+            name, params, metric, runs, min, median, p95, wall_median);
+    for (int i = 0; i < runs; i++)
+        fprintf(file, "%s%.3f", i ? ", " : "", samples[i]);
+    fprintf(file, "]}\n");
+    fclose(file);
+}
+
+struct CsvRow {
+    char key[512];
+    double median;
+};
+
+// Строки CSV без заголовка: ключ "name,params" и медиана
+static int LoadCsv(const char *path, struct CsvRow **rows) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    int count = 0, capacity = 0;
+    *rows = NULL;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, "name,", 5) == 0)
+            continue;
+        char name[256], params[256], metric[128];
+        int runs;
+        double min, median;
+        if (sscanf(line, "%255[^,],%255[^,],%127[^,],%d,%lf,%lf", name, params,
+                   metric, &runs, &min, &median) != 6)
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            struct CsvRow *grown = realloc(*rows, capacity * sizeof(**rows));
+            if (grown == NULL) {
+                fclose(file);
+                return -1;
+            }
+            *rows = grown;
+        }
+        snprintf((*rows)[count].key, sizeof((*rows)[count].key), "%s,%s", name,
+                 params);
+        (*rows)[count].median = median;
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+static int Compare(const char *old_path, const char *new_path, double threshold) {
+    struct CsvRow *old_rows, *new_rows;
+    int old_num = LoadCsv(old_path, &old_rows);
+    int new_num = LoadCsv(new_path, &new_rows);
+    if (old_num < 0 || new_num < 0)
+        return 2;
+
+    int regressions = 0;
+    printf("%-40s %12s %12s %9s\n", "benchmark", "old ms", "new ms", "change");
+    for (int i = 0; i < new_num; i++) {
+        // Если конфигурация встречается несколько раз, берётся последняя
+        const struct CsvRow *old = NULL;
+        for (int j = 0; j < old_num; j++) {
+            if (strcmp(old_rows[j].key, new_rows[i].key) == 0)
+                old = &old_rows[j];
+        }
+        if (old == NULL) {
+            printf("%-40s %12s %12.3f %9s\n", new_rows[i].key, "-",
+                   new_rows[i].median, "new");
+            continue;
+        }
+        double change = old->median > 0
+                            ? (new_rows[i].median / old->median - 1) * 100
+                            : 0;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        printf("%-40s %12.3f %12.3f %+8.1f%%%s\n", new_rows[i].key, old->median,
+               new_rows[i].median, change, regressed ? "  REGRESSION" : "");
+    }
+    printf("\n%d regression(s) above %.1f%%\n", regressions, threshold);
+
+    free(old_rows);
+    free(new_rows);
+    return regressions ? 1 : 0;
+}
+
+static void Usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s --name <name> [--params <label>] [--warmup N] [--runs N]\n"
+            "          [--metric <text>] [--csv file] [--json file] -- command [args...]\n"
+            "       %s --compare <old.csv> <new.csv> [--threshold percent]\n",
+            program, program);
+}
+
+int main(int argc, char **argv) {
+    const char *name = NULL;
+    const char *params = "";
+    const char *metric = "Elapsed time";
+    const char *csv_path = NULL;
+    const char *json_path = NULL;
+    const char *compare_old = NULL;
+    int warmup = 1;
+    int runs = 5;
+    double threshold = 10.0;
+
+    static struct option options[] = {{"name", required_argument, 0, 'n'},
+                                      {"params", required_argument, 0, 'p'},
+                                      {"warmup", required_argument, 0, 'w'},
+                                      {"runs", required_argument, 0, 'r'},
+                                      {"metric", required_argument, 0, 'm'},
+                                      {"csv", required_argument, 0, 'c'},
+                                      {"json", required_argument, 0, 'j'},
+                                      {"compare", required_argument, 0, 'C'},
+                                      {"threshold", required_argument, 0, 't'},
+                                      {0, 0, 0, 0}};
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (c) {
+            case 'n':
+                name = optarg;
+                break;
+            case 'p':
+                params = optarg;
+                break;
+            case 'w':
+                warmup = atoi(optarg);
+                if (warmup < 0) {
+                    fprintf(stderr, "warmup must be non-negative\n");
+                    return 1;
+                }
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                if (runs <= 0) {
+                    fprintf(stderr, "runs must be positive\n");
+                    return 1;
+                }
+                break;
+            case 'm':
+                metric = optarg;
+                break;
+            case 'c':
+                csv_path = optarg;
+                break;
+            case 'j':
+                json_path = optarg;
+                break;
+            case 'C':
+                compare_old = optarg;
+                break;
+            case 't':
+                threshold = atof(optarg);
+                break;
+            default:
+                Usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (compare_old != NULL) {
+        if (optind >= argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        return Compare(compare_old, argv[optind], threshold);
+    }
+
+    if (name == NULL || optind >= argc) {
+        Usage(argv[0]);
+        return 1;
+    }
+    char **command = argv + optind;
+
+    double *samples = malloc(runs * sizeof(double));
+    double *walls = malloc(runs * sizeof(double));
+    if (samples == NULL || walls == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    bool use_metric = true;
+    for (int i = 0; i < warmup + runs; i++) {
+        double wall_ms, metric_ms;
+        if (RunOnce(command, metric, &wall_ms, &metric_ms) != 0) {
+            free(samples);
+            free(walls);
+            return 1;
+        }
+        if (i < warmup)
+            continue;
+        int run = i - warmup;
+        walls[run] = wall_ms;
+        samples[run] = metric_ms;
+        if (metric_ms < 0)
+            use_metric = false;
+    }
+
+    // Без метрики хотя бы в одном запуске - все замеры по часам снаружи
+    const char *source = use_metric ? metric : "wall";
+    if (!use_metric)
+        memcpy(samples, walls, runs * sizeof(double));
+    qsort(samples, runs, sizeof(double), CompareDoubles);
+    qsort(walls, runs, sizeof(double), CompareDoubles);
+
+    double min = samples[0];
+    double median = Percentile(samples, runs, 50);
+    double p95 = Percentile(samples, runs, 95);
+    double wall_median = Percentile(walls, runs, 50);
+
+    printf("%-18s %-28s min %10.3f  median %10.3f  p95 %10.3f ms (%s)\n", name,
+           params, min, median, p95, source);
+
+    if (csv_path != NULL)
+        AppendCsv(csv_path, name, params, source, runs, min, median, p95,
+                  wall_median);
+    if (json_path != NULL)
+        AppendJson(json_path, name, params, source, samples, runs, min, median,
+                   p95, wall_median);
+
+    free(samples);
+    free(walls);
+    return 0;
+}
@@ -1,23 +1,21 @@
 #include "find_min_max.h"
 
 #include <limits.h>
+#include <stdint.h>
+
+#include "extrema.h"
 
 struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end) {
   struct MinMax min_max;
   min_max.min = INT_MAX;
   min_max.max = INT_MIN;
 
-  // your code here
-
-  for (unsigned int i = begin; i < end; i++){
-    if (array[i] < min_max.min){
-      min_max.min = array[i];
-    }
-
-    if (array[i] > min_max.max){
-      min_max.max = array[i];
-    }
-  
+  // Один проход векторизованным ядром из lib/extrema.h; индексы
+  // экстремумов здесь не нужны
+  struct ExtremaI32 extrema = FindExtremaI32((const int32_t *)array + begin, end - begin);
+  if (extrema.argmin != EXTREMA_NONE){
+    min_max.min = extrema.min;
+    min_max.max = extrema.max;
   }
 
   return min_max;
@@ -1,21 +1,65 @@
 #include "find_min_max.h"
 
 #include <limits.h>
+#include <stdint.h>
 
 struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end) {
+  struct ExtremaI32 extrema = FindExtremaI32((const int32_t *)array + begin, end - begin);
+
   struct MinMax min_max;
   min_max.min = INT_MAX;
   min_max.max = INT_MIN;
+  min_max.argmin = EXTREMA_NONE;
+  min_max.argmax = EXTREMA_NONE;
 
-  for (unsigned int i = begin; i < end; i++){
-    if (array[i] < min_max.min){
-      min_max.min = array[i];
-    }
-
-    if (array[i] > min_max.max){
-      min_max.max = array[i];
-    }
+  if (extrema.argmin != EXTREMA_NONE){
+    min_max.min = extrema.min;
+    min_max.max = extrema.max;
+    min_max.argmin = begin + extrema.argmin;
+    min_max.argmax = begin + extrema.argmax;
   }
 
   return min_max;
-}
\ No newline at end of file
+}
+
+void MergeMinMax(struct MinMax *min_max, const struct MinMax *part) {
+  struct ExtremaI32 acc = {min_max->min, min_max->max, min_max->argmin, min_max->argmax};
+  struct ExtremaI32 other = {part->min, part->max, part->argmin, part->argmax};
+  MergeExtremaI32(&acc, &other);
+
+  min_max->min = acc.min;
+  min_max->max = acc.max;
+  min_max->argmin = acc.argmin;
+  min_max->argmax = acc.argmax;
+}
+
+int SelectMinMaxKernel(const char *name) {
+  return ExtremaSelectKernel(name);
+}
+
+const char *MinMaxKernelName(void) {
+  return ExtremaKernelName();
+}
+
+static void MinMaxInit(void *acc, void *ctx) {
+  (void)ctx;
+  struct MinMax *min_max = acc;
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
+  min_max->argmin = EXTREMA_NONE;
+  min_max->argmax = EXTREMA_NONE;
+}
+
+static void MinMaxCombine(void *acc, const void *other, void *ctx) {
+  (void)ctx;
+  MergeMinMax(acc, other);
+}
+
+static void MinMaxAccumulate(void *acc, size_t begin, size_t end, void *ctx) {
+  struct MinMax part = GetMinMax(ctx, begin, end);
+  MergeMinMax(acc, &part);
+}
+
+// Границы частей по кэш-линиям (16 чисел int)
+const struct ReduceOps MinMaxReduceOps = {
+    sizeof(struct MinMax), 16, MinMaxInit, MinMaxAccumulate, MinMaxCombine};
@@ -1,11 +1,35 @@
 #ifndef FIND_MIN_MAX_H
 #define FIND_MIN_MAX_H
 
+#include <stddef.h>
+
+#include "extrema.h"
+#include "reduce.h"
+
+// Экстремумы и индексы их первых вхождений во всём массиве;
+// EXTREMA_NONE, если элементов не было
 struct MinMax {
     int min;
     int max;
+    size_t argmin;
+    size_t argmax;
 };
 
+// Поиск min/max и их индексов в [begin, end) за один проход ядром из
+// lib/extrema.h (см. SelectMinMaxKernel)
 struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end);
 
-#endif
\ No newline at end of file
+// Слияние результатов частей: при равных значениях побеждает меньший индекс
+void MergeMinMax(struct MinMax *min_max, const struct MinMax *part);
+
+// Выбор ядра по имени ("scalar", "sse4", "avx2", "avx512") или, при
+// name == NULL, самого широкого из поддерживаемых процессором. 0 при
+// успехе, -1 если ядро неизвестно или не поддерживается.
+int SelectMinMaxKernel(const char *name);
+const char *MinMaxKernelName(void);
+
+// Операции редукции min/max для lib/reduce.h; контекст - указатель на
+// массив int, аккумулятор - struct MinMax
+extern const struct ReduceOps MinMaxReduceOps;
+
+#endif
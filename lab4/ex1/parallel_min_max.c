@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <ctype.h>
 #include <limits.h>
 #include <stdbool.h>
@@ -5,7 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
@@ -14,6 +16,7 @@
 #include <errno.h>
 
 #include "find_min_max.h"
+#include "shm_results.h"
 #include "utils.h"
 
 // Глобальные переменные для хранения PID дочерних процессов
@@ -21,8 +24,61 @@ pid_t *child_pids = NULL;
 int timeout = 0; // 0 означает таймаут не задан
 int pnum = 0;    // Количество процессов
 
+// Флаг таймаута для ожидания результатов в разделяемой памяти
+volatile sig_atomic_t timed_out = 0;
+
+// Вывод общей части результатов для всех режимов
+static void PrintResults(struct MinMax min_max, int collected, int total,
+                         double gen_time, bool parallel_gen, double elapsed_time,
+                         const char *method) {
+  printf("\n=== RESULTS ===\n");
+  printf("Min: %d\n", min_max.min);
+  printf("Max: %d\n", min_max.max);
+  if (min_max.argmin != EXTREMA_NONE) {
+    printf("Min index: %zu\n", min_max.argmin);
+    printf("Max index: %zu\n", min_max.argmax);
+  }
+  printf("Results collected from %d out of %d %s\n", collected, total,
+         strcmp(method, "threads") == 0 ? "threads" : "processes");
+  printf("Generation time: %fms (%s)\n", gen_time, parallel_gen ? "parallel" : "serial");
+  printf("Elapsed time: %fms\n", elapsed_time);
+  printf("Used method: %s\n", method);
+  printf("Min/max kernel: %s\n", MinMaxKernelName());
+}
+
+// Режим потоков: та же редукция в пуле из pnum потоков, без fork и
+// передачи результатов через pipes или файлы
+static int RunThreads(int *array, int array_size, double gen_time,
+                      bool parallel_gen) {
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+  struct WorkPool *pool = WorkPoolCreate(pnum, true);
+  if (pool == NULL) {
+    printf("Thread pool creation failed!\n");
+    return 1;
+  }
+
+  struct MinMax min_max;
+  bool ok = ReduceRun(pool, &MinMaxReduceOps, array, 0, array_size, 0, &min_max);
+  WorkPoolDestroy(pool);
+  if (!ok) {
+    printf("Reduction failed!\n");
+    return 1;
+  }
+
+  struct timespec finish_time;
+  clock_gettime(CLOCK_MONOTONIC, &finish_time);
+  double elapsed_time = (finish_time.tv_sec - start_time.tv_sec) * 1000.0;
+  elapsed_time += (finish_time.tv_nsec - start_time.tv_nsec) / 1e6;
+
+  PrintResults(min_max, pnum, pnum, gen_time, parallel_gen, elapsed_time, "threads");
+  return 0;
+}
+
 // Обработчик для SIGALRM
 void timeout_handler(int sig) {
+    timed_out = 1;
     printf("Timeout reached! Sending SIGKILL to all child processes.\n");
     if (child_pids != NULL) {
         for (int i = 0; i < pnum; i++) {
@@ -34,11 +90,44 @@ void timeout_handler(int sig) {
     }
 }
 
+// Обработчик для SIGCHLD в режиме --by_shm: ничего не делает, только
+// прерывает ожидание на futex, чтобы родитель сразу собрал потомка.
+// Считать потомков по сигналам нельзя - SIGCHLD склеиваются.
+void child_handler(int sig) {
+    (void)sig;
+}
+
+// Учет завершившегося потомка; true, если его убил SIGKILL по таймауту
+static bool ReapChild(pid_t finished_pid, int child_status) {
+    // Убираем PID из массива
+    for (int i = 0; i < pnum; i++) {
+        if (child_pids[i] == finished_pid) {
+            child_pids[i] = 0;
+            break;
+        }
+    }
+
+    if (WIFSIGNALED(child_status)) {
+        printf("Child process %d was terminated by signal %d\n",
+               finished_pid, WTERMSIG(child_status));
+        return WTERMSIG(child_status) == SIGKILL;
+    }
+    if (WIFEXITED(child_status)) {
+        printf("Child process %d exited normally with status %d\n",
+               finished_pid, WEXITSTATUS(child_status));
+    }
+    return false;
+}
+
 int main(int argc, char **argv) {
   int seed = -1;
   int array_size = -1;
   pnum = -1;
   bool with_files = false;
+  bool with_shm = false;
+  bool parallel_gen = false;
+  bool use_threads = false;
+  const char *kernel = NULL;
   timeout = 0; // Инициализация таймаута
 
   while (true) {
@@ -49,6 +138,10 @@ int main(int argc, char **argv) {
                                       {"pnum", required_argument, 0, 0},
                                       {"by_files", no_argument, 0, 'f'},
                                       {"timeout", required_argument, 0, 0},
+                                      {"parallel_gen", no_argument, 0, 0},
+                                      {"mode", required_argument, 0, 0},
+                                      {"kernel", required_argument, 0, 0},
+                                      {"by_shm", no_argument, 0, 0},
                                       {0, 0, 0, 0}};
 
     int option_index = 0;
@@ -90,6 +183,25 @@ int main(int argc, char **argv) {
                 return 1;
             }
             break;
+          case 5:
+            parallel_gen = true;
+            break;
+          case 6:
+            if (strcmp(optarg, "threads") == 0) {
+                use_threads = true;
+            } else if (strcmp(optarg, "processes") == 0) {
+                use_threads = false;
+            } else {
+                printf("mode must be processes or threads\n");
+                return 1;
+            }
+            break;
+          case 7:
+            kernel = optarg;
+            break;
+          case 8:
+            with_shm = true;
+            break;
 
           default:
             printf("Index %d is out of options\n", option_index);
@@ -113,11 +225,28 @@ int main(int argc, char **argv) {
   }
 
   if (seed == -1 || array_size == -1 || pnum == -1) {
-    printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" [--timeout \"seconds\"]\n",
+    printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" [--timeout \"seconds\"] [--parallel_gen] "
+           "[--mode processes|threads] [--kernel scalar|sse4|avx2|avx512] [--by_files|--by_shm]\n",
            argv[0]);
     return 1;
   }
 
+  // Ядро выбирается до fork, дочерние процессы наследуют выбор
+  if (SelectMinMaxKernel(kernel) != 0) {
+    printf("Kernel %s is unknown or not supported by this CPU\n", kernel);
+    return 1;
+  }
+
+  if (with_files && with_shm) {
+    printf("Only one of --by_files and --by_shm can be used\n");
+    return 1;
+  }
+
+  if (use_threads && timeout > 0) {
+    printf("Timeout is not supported in threads mode\n");
+    return 1;
+  }
+
   // Инициализация массива для хранения PID дочерних процессов
   child_pids = malloc(sizeof(pid_t) * pnum);
   for (int i = 0; i < pnum; i++) {
@@ -134,15 +263,57 @@ int main(int argc, char **argv) {
       printf("Timeout set to %d seconds\n", timeout);
   }
 
+  // Генерация замеряется отдельно; с --parallel_gen массив заполняют
+  // pnum потоков, результат от этого не меняется
   int *array = malloc(sizeof(int) * array_size);
-  GenerateArray(array, array_size, seed);
+  struct timespec gen_start;
+  clock_gettime(CLOCK_MONOTONIC, &gen_start);
+  if (parallel_gen) {
+    GenerateArrayParallel(array, array_size, seed, pnum);
+  } else {
+    GenerateArray(array, array_size, seed);
+  }
+  struct timespec gen_finish;
+  clock_gettime(CLOCK_MONOTONIC, &gen_finish);
+  double gen_time = (gen_finish.tv_sec - gen_start.tv_sec) * 1000.0;
+  gen_time += (gen_finish.tv_nsec - gen_start.tv_nsec) / 1e6;
+
+  if (use_threads) {
+    int status = RunThreads(array, array_size, gen_time, parallel_gen);
+    free(array);
+    free(child_pids);
+    return status;
+  }
+
   int active_child_processes = 0;
 
-  // Создаем pipes или файлы для каждого процесса
+  // Создаем pipes, файлы или область разделяемой памяти для результатов
   int pipes[pnum][2];
   char filenames[pnum][100];
+  struct ShmResults *shm = NULL;
   
-  if (!with_files) {
+  if (with_shm) {
+    shm = ShmResultsCreate(pnum);
+    if (shm == NULL) {
+      printf("Shared memory creation failed!\n");
+      free(child_pids);
+      free(array);
+      return 1;
+    }
+    // sigaction, а не signal: с -std=c99 signal() одноразовый (семантика
+    // SysV), и после первого потомка обработчик сбросился бы в SIG_DFL.
+    // Без SA_RESTART, чтобы сигнал прерывал ожидание.
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = child_handler;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGCHLD, &sa, NULL) == -1) {
+      printf("Failed to set signal handler\n");
+      free(child_pids);
+      free(array);
+      return 1;
+    }
+  } else if (!with_files) {
     // Создаем pipes для всех процессов
     for (int i = 0; i < pnum; i++) {
       if (pipe(pipes[i]) == -1) {
@@ -161,8 +332,8 @@ int main(int argc, char **argv) {
     }
   }
 
-  struct timeval start_time;
-  gettimeofday(&start_time, NULL);
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
 
   // Устанавливаем будильник, если задан таймаут
   if (timeout > 0) {
@@ -178,25 +349,31 @@ int main(int argc, char **argv) {
       if (child_pid == 0) {
         // child process
         
-        // Вычисляем границы для этого процесса
-        int chunk_size = array_size / pnum;
-        int start = i * chunk_size;
-        int end = (i == pnum - 1) ? array_size : (i + 1) * chunk_size;
+        // Вычисляем границы для этого процесса тем же разбиением,
+        // что и у редукций в пуле потоков
+        size_t start, end;
+        ReduceSplit(0, array_size, MinMaxReduceOps.grain, pnum, i, &start, &end);
         
-        printf("Child process %d (PID: %d) processing elements %d to %d\n", 
+        printf("Child process %d (PID: %d) processing elements %zu to %zu\n", 
                i, getpid(), start, end);
         
         // Ищем min/max в своей части массива
-        struct MinMax local_min_max = GetMinMax(array, start, end);
+        struct MinMax local_min_max;
+        MinMaxReduceOps.init(&local_min_max, array);
+        MinMaxReduceOps.accumulate(&local_min_max, start, end, array);
         
         printf("Child process %d found min: %d, max: %d\n", 
                i, local_min_max.min, local_min_max.max);
         
-        if (with_files) {
+        if (with_shm) {
+          // Запись в свой слот разделяемой памяти
+          ShmResultsPut(shm, i, local_min_max);
+        } else if (with_files) {
           // use files here
           FILE* file = fopen(filenames[i], "w");
           if (file != NULL) {
-            fprintf(file, "%d %d", local_min_max.min, local_min_max.max);
+            fprintf(file, "%d %d %zu %zu", local_min_max.min, local_min_max.max,
+                    local_min_max.argmin, local_min_max.argmax);
             fclose(file);
           } else {
             printf("Child %d: Failed to open file\n", i);
@@ -204,8 +381,8 @@ int main(int argc, char **argv) {
         } else {
           // use pipe here
           close(pipes[i][0]); // закрываем чтение в потомке
-          write(pipes[i][1], &local_min_max.min, sizeof(local_min_max.min));
-          write(pipes[i][1], &local_min_max.max, sizeof(local_min_max.max));
+          // Структура короче PIPE_BUF, поэтому пишется целиком за раз
+          write(pipes[i][1], &local_min_max, sizeof(local_min_max));
           close(pipes[i][1]);
         }
         free(array);
@@ -231,35 +408,39 @@ int main(int argc, char **argv) {
   
   printf("Parent process waiting for children...\n");
   
+  if (with_shm) {
+    // Результаты собираются из памяти: родитель спит на futex, пока все
+    // потомки не запишут слоты, не сработает таймаут или не завершатся
+    // все потомки. Потомок, погибший до записи результата, не увеличит
+    // счетчик слотов, поэтому завершившиеся потомки собираются прямо здесь
+    // через waitpid(WNOHANG). SIGCHLD только будит родителя раньше, а
+    // таймаут futex не дает пропустить потомка, если сигнал склеился.
+    while (active_child_processes > 0 && ShmResultsWait(shm, 100) < pnum &&
+           !timed_out) {
+      while ((finished_pid = waitpid(-1, &child_status, WNOHANG)) > 0) {
+        active_child_processes -= 1;
+        if (ReapChild(finished_pid, child_status)) {
+          timeout_occurred = 1;
+        }
+      }
+    }
+  }
+
   while (active_child_processes > 0) {
-    // Используем неблокирующий waitpid с WNOHANG
-    finished_pid = waitpid(-1, &child_status, WNOHANG);
+    // Блокирующий waitpid: родитель спит, пока какой-нибудь потомок не
+    // завершится. При таймауте обработчик SIGALRM убивает потомков, и
+    // waitpid возвращается с их статусами.
+    finished_pid = waitpid(-1, &child_status, 0);
     
     if (finished_pid > 0) {
         // Найден завершившийся процесс
         active_child_processes -= 1;
-        
-        // Убираем PID из массива
-        for (int i = 0; i < pnum; i++) {
-            if (child_pids[i] == finished_pid) {
-                child_pids[i] = 0;
-                break;
-            }
-        }
-        
-        if (WIFSIGNALED(child_status)) {
-            printf("Child process %d was terminated by signal %d\n", 
-                   finished_pid, WTERMSIG(child_status));
-            if (WTERMSIG(child_status) == SIGKILL) {
-                timeout_occurred = 1;
-            }
-        } else if (WIFEXITED(child_status)) {
-            printf("Child process %d exited normally with status %d\n", 
-                   finished_pid, WEXITSTATUS(child_status));
+        if (ReapChild(finished_pid, child_status)) {
+            timeout_occurred = 1;
         }
-    } else if (finished_pid == 0) {
-        // Дочерние процессы еще работают, ждем немного
-        usleep(100000); // 100ms
+    } else if (errno == EINTR) {
+        // Прерван сигналом (например, SIGALRM) - ждем дальше
+        continue;
     } else {
         // Ошибка
         if (errno != ECHILD) {
@@ -275,21 +456,24 @@ int main(int argc, char **argv) {
   }
 
   struct MinMax min_max;
-  min_max.min = INT_MAX;
-  min_max.max = INT_MIN;
+  MinMaxReduceOps.init(&min_max, array);
 
   // Собираем результаты от всех процессов
   int results_collected = 0;
   for (int i = 0; i < pnum; i++) {
-    int min = INT_MAX;
-    int max = INT_MIN;
+    struct MinMax part;
     int result_available = 1;
 
-    if (with_files) {
+    if (with_shm) {
+      if (!ShmResultsGet(shm, i, &part)) {
+        result_available = 0;
+      }
+    } else if (with_files) {
       // read from files
       FILE* file = fopen(filenames[i], "r");
       if (file != NULL) {
-        if (fscanf(file, "%d %d", &min, &max) != 2) {
+        if (fscanf(file, "%d %d %zu %zu", &part.min, &part.max,
+                   &part.argmin, &part.argmax) != 4) {
             result_available = 0;
         }
         fclose(file);
@@ -301,39 +485,35 @@ int main(int argc, char **argv) {
     } else {
       // read from pipes
       close(pipes[i][1]); // закрываем запись в родителе
-      if (read(pipes[i][0], &min, sizeof(min)) != sizeof(min)) {
-          result_available = 0;
-      }
-      if (read(pipes[i][0], &max, sizeof(max)) != sizeof(max)) {
+      if (read(pipes[i][0], &part, sizeof(part)) != sizeof(part)) {
           result_available = 0;
       }
       close(pipes[i][0]);
     }
 
     if (result_available) {
-        if (min < min_max.min) min_max.min = min;
-        if (max > min_max.max) min_max.max = max;
+        MinMaxReduceOps.combine(&min_max, &part, array);
         results_collected++;
     } else {
         printf("No results from process %d (may have been terminated)\n", i);
     }
   }
 
-  struct timeval finish_time;
-  gettimeofday(&finish_time, NULL);
+  struct timespec finish_time;
+  clock_gettime(CLOCK_MONOTONIC, &finish_time);
 
   double elapsed_time = (finish_time.tv_sec - start_time.tv_sec) * 1000.0;
-  elapsed_time += (finish_time.tv_usec - start_time.tv_usec) / 1000.0;
+  elapsed_time += (finish_time.tv_nsec - start_time.tv_nsec) / 1e6;
 
   free(array);
   free(child_pids);
 
-  printf("\n=== RESULTS ===\n");
-  printf("Min: %d\n", min_max.min);
-  printf("Max: %d\n", min_max.max);
-  printf("Results collected from %d out of %d processes\n", results_collected, pnum);
-  printf("Elapsed time: %fms\n", elapsed_time);
-  printf("Used method: %s\n", with_files ? "files" : "pipes");
+  if (shm != NULL) {
+    ShmResultsDestroy(shm);
+  }
+
+  PrintResults(min_max, results_collected, pnum, gen_time, parallel_gen,
+               elapsed_time, with_shm ? "shm" : with_files ? "files" : "pipes");
   if (timeout > 0) {
       printf("Timeout: %d seconds\n", timeout);
       if (timeout_occurred) {
@@ -0,0 +1,72 @@
+#define _GNU_SOURCE
+
+#include "shm_results.h"
+
+#include <linux/futex.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_LINE_SIZE 64
+
+struct ShmSlot {
+  struct MinMax min_max;
+  int ready;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct ShmResults {
+  int done;  // число готовых слотов, слово futex
+  int slots;
+  size_t size;
+  struct ShmSlot slot[];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Область общая для разных процессов, поэтому futex без FUTEX_PRIVATE_FLAG
+static long Futex(int *addr, int op, int value, const struct timespec *timeout) {
+  return syscall(SYS_futex, addr, op, value, timeout, NULL, 0);
+}
+
+struct ShmResults *ShmResultsCreate(int slots) {
+  size_t size = sizeof(struct ShmResults) + sizeof(struct ShmSlot) * slots;
+  struct ShmResults *results = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (results == MAP_FAILED)
+    return NULL;
+
+  // Анонимная память уже обнулена: done = 0, все слоты не готовы
+  results->slots = slots;
+  results->size = size;
+  return results;
+}
+
+void ShmResultsDestroy(struct ShmResults *results) {
+  munmap(results, results->size);
+}
+
+void ShmResultsPut(struct ShmResults *results, int slot, struct MinMax min_max) {
+  results->slot[slot].min_max = min_max;
+  __atomic_store_n(&results->slot[slot].ready, 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&results->done, 1, __ATOMIC_SEQ_CST);
+  Futex(&results->done, FUTEX_WAKE, 1, NULL);
+}
+
+int ShmResultsWait(struct ShmResults *results, int timeout_ms) {
+  int done = __atomic_load_n(&results->done, __ATOMIC_ACQUIRE);
+  if (done >= results->slots)
+    return done;
+
+  // FUTEX_WAIT заснёт, только если счётчик всё ещё равен done, поэтому
+  // пробуждение между проверкой и ожиданием не теряется
+  struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+  Futex(&results->done, FUTEX_WAIT, done, &timeout);
+  return __atomic_load_n(&results->done, __ATOMIC_ACQUIRE);
+}
+
+bool ShmResultsGet(struct ShmResults *results, int slot, struct MinMax *min_max) {
+  if (!__atomic_load_n(&results->slot[slot].ready, __ATOMIC_ACQUIRE))
+    return false;
+  *min_max = results->slot[slot].min_max;
+  return true;
+}
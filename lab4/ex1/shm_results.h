@@ -0,0 +1,34 @@
+#ifndef SHM_RESULTS_H
+#define SHM_RESULTS_H
+
+#include <stdbool.h>
+
+#include "find_min_max.h"
+
+// Канал результатов через разделяемую память для режима --by_shm.
+//
+// Одна анонимная область MAP_SHARED создаётся до fork и наследуется
+// потомками. У каждого потомка своя кэш-линия со слотом результата,
+// поэтому записи разных потомков не мешают друг другу. Счётчик
+// готовых слотов служит словом futex: потомок увеличивает его и будит
+// родителя, родитель спит на нём, пока не соберутся все результаты.
+// Сбор результатов - чтение памяти, без системных вызовов на каждого
+// потомка и без файлов.
+
+struct ShmResults;
+
+// NULL при ошибке mmap
+struct ShmResults *ShmResultsCreate(int slots);
+void ShmResultsDestroy(struct ShmResults *results);
+
+// Запись результата потомком и пробуждение родителя
+void ShmResultsPut(struct ShmResults *results, int slot, struct MinMax min_max);
+
+// Ожидание новых результатов не дольше timeout_ms; возвращает число
+// заполненных слотов. Может вернуться раньше из-за сигнала.
+int ShmResultsWait(struct ShmResults *results, int timeout_ms);
+
+// false, если потомок не успел записать результат
+bool ShmResultsGet(struct ShmResults *results, int slot, struct MinMax *min_max);
+
+#endif
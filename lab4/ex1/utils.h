@@ -1,6 +1,12 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+// Элементы массива вычисляются по seed и индексу (счётчику), поэтому
+// массив не зависит от числа потоков, которыми он заполнялся
 void GenerateArray(int *array, unsigned int array_size, unsigned int seed);
 
-#endif
\ No newline at end of file
+// То же самое, threads_num потоков заполняют свои части массива
+void GenerateArrayParallel(int *array, unsigned int array_size, unsigned int seed,
+                           int threads_num);
+
+#endif
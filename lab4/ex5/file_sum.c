@@ -0,0 +1,299 @@
+#define _GNU_SOURCE
+
+#include "file_sum.h"
+#include "sum_utils.h"
+#include "reduce.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Часть файла на одну задачу в режиме mmap: достаточно мелко для
+// перехвата работы и достаточно крупно для упреждающего чтения ядра
+#define MMAP_CHUNK_BYTES (16u << 20)
+
+// Буфер потока в режиме read, одна задача - один буфер
+#define READ_CHUNK_BYTES (4u << 20)
+
+// Ядро суммирования int32 возвращает long long: без переполнения
+// проходит не больше 2^32 чисел, берем с запасом
+#define KERNEL_MAX_INTS (1L << 30)
+
+typedef struct {
+    const char* data;  // отображение файла или NULL в режиме read
+    int fd;
+    ElemType type;
+    size_t chunk;      // элементов в задаче
+    size_t count;
+} FileSumContext;
+
+// Аккумулятор потока; в режиме read в нем же живет буфер потока,
+// он освобождается при сведении результатов
+typedef struct {
+    __int128 sum;
+    char* buffer;
+    int error;
+} FileSumAcc;
+
+static __int128 sum_int32(const int* values, size_t count) {
+    SumKernel kernel = current_sum_kernel();
+    __int128 sum = 0;
+    while (count > 0) {
+        long n = count > KERNEL_MAX_INTS ? KERNEL_MAX_INTS : (long)count;
+        sum += kernel(values, n);
+        values += n;
+        count -= n;
+    }
+    return sum;
+}
+
+static __int128 sum_int64(const int64_t* values, size_t count) {
+    // Старшие (со знаком) и младшие (без знака) 32 бита копятся отдельно в
+    // 64-битных переменных, чтобы цикл векторизовался; на 2^30 числах
+    // ни одна из сумм не переполняется
+    __int128 sum = 0;
+    while (count > 0) {
+        size_t n = count > (size_t)KERNEL_MAX_INTS ? (size_t)KERNEL_MAX_INTS : count;
+        int64_t high = 0;
+        uint64_t low = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t v = (uint64_t)values[i];
+            high += (int32_t)(v >> 32);
+            low += (uint32_t)v;
+        }
+        sum += ((__int128)high << 32) + low;
+        values += n;
+        count -= n;
+    }
+    return sum;
+}
+
+static __int128 sum_values(const char* data, ElemType type, size_t count) {
+    if (type == ELEM_INT32)
+        return sum_int32((const int*)data, count);
+    return sum_int64((const int64_t*)data, count);
+}
+
+static void file_sum_init(void* acc, void* ctx) {
+    (void)ctx;
+    memset(acc, 0, sizeof(FileSumAcc));
+}
+
+static void file_sum_combine(void* acc, const void* other, void* ctx) {
+    (void)ctx;
+    FileSumAcc* total = acc;
+    FileSumAcc* part = (FileSumAcc*)other;
+    total->sum += part->sum;
+    if (part->error != 0)
+        total->error = part->error;
+    free(part->buffer);
+    part->buffer = NULL;
+}
+
+static void mmap_accumulate(void* acc, size_t begin, size_t end, void* ctx) {
+    FileSumContext* file = ctx;
+    size_t size = elem_size(file->type);
+    ((FileSumAcc*)acc)->sum += sum_values(file->data + begin * size, file->type,
+                                          end - begin);
+}
+
+static void read_accumulate(void* acc, size_t begin, size_t end, void* ctx) {
+    FileSumContext* file = ctx;
+    FileSumAcc* state = acc;
+    size_t size = elem_size(file->type);
+    if (state->error != 0)
+        return;
+
+    if (state->buffer == NULL) {
+        state->buffer = aligned_alloc(CACHE_LINE_SIZE, READ_CHUNK_BYTES);
+        if (state->buffer == NULL) {
+            state->error = ENOMEM;
+            return;
+        }
+    }
+
+    // Следующая часть блока этого потока читается ядром, пока считаем
+    // текущую
+    off_t next = (off_t)(end * size);
+    if (end < file->count)
+        posix_fadvise(file->fd, next, (off_t)(file->chunk * size), POSIX_FADV_WILLNEED);
+
+    size_t bytes = (end - begin) * size;
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = pread(file->fd, state->buffer + done, bytes - done,
+                          (off_t)(begin * size + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            state->error = n < 0 ? errno : EIO;
+            return;
+        }
+        done += (size_t)n;
+    }
+
+    state->sum += sum_values(state->buffer, file->type, end - begin);
+}
+
+int parse_elem_type(const char* name, ElemType* type) {
+    if (strcmp(name, "int32") == 0)
+        *type = ELEM_INT32;
+    else if (strcmp(name, "int64") == 0)
+        *type = ELEM_INT64;
+    else
+        return -1;
+    return 0;
+}
+
+int parse_io_mode(const char* name, IoMode* mode) {
+    if (strcmp(name, "auto") == 0)
+        *mode = IO_AUTO;
+    else if (strcmp(name, "mmap") == 0)
+        *mode = IO_MMAP;
+    else if (strcmp(name, "read") == 0)
+        *mode = IO_READ;
+    else
+        return -1;
+    return 0;
+}
+
+const char* elem_type_name(ElemType type) {
+    return type == ELEM_INT32 ? "int32" : "int64";
+}
+
+const char* io_mode_name(IoMode mode) {
+    switch (mode) {
+        case IO_MMAP:
+            return "mmap";
+        case IO_READ:
+            return "read";
+        default:
+            return "auto";
+    }
+}
+
+size_t elem_size(ElemType type) {
+    return type == ELEM_INT32 ? sizeof(int32_t) : sizeof(int64_t);
+}
+
+// Файлы больше половины физической памяти читаются через read: иначе
+// отображение вытесняет из кэша все остальное
+static IoMode choose_io_mode(off_t file_size) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0)
+        return IO_MMAP;
+    return (double)file_size > (double)pages * page_size / 2 ? IO_READ : IO_MMAP;
+}
+
+int file_sum(const char* path, ElemType type, IoMode mode, int threads_num,
+             FileSumResult* result) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    size_t size = elem_size(type);
+    FileSumContext ctx = {NULL, fd, type, 0, (size_t)st.st_size / size};
+    result->sum = 0;
+    result->count = ctx.count;
+    result->io = mode == IO_AUTO ? choose_io_mode(st.st_size) : mode;
+    if (ctx.count == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* map = MAP_FAILED;
+    if (result->io == IO_MMAP) {
+        map = mmap(NULL, ctx.count * size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            // Ошибки советов не критичны: huge pages для файлов есть не везде
+            madvise(map, ctx.count * size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            madvise(map, ctx.count * size, MADV_HUGEPAGE);
+#endif
+            ctx.data = map;
+        } else if (mode == IO_MMAP) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        } else {
+            result->io = IO_READ;
+        }
+    }
+    if (result->io == IO_READ)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t grain = CACHE_LINE_SIZE / size;
+    if (ctx.data != NULL) {
+        ctx.chunk = ReduceChunkSize(ctx.count, threads_num, grain);
+        if (ctx.chunk > MMAP_CHUNK_BYTES / size)
+            ctx.chunk = MMAP_CHUNK_BYTES / size;
+    } else {
+        ctx.chunk = READ_CHUNK_BYTES / size;
+    }
+
+    struct ReduceOps ops = {
+        sizeof(FileSumAcc), grain, file_sum_init,
+        ctx.data != NULL ? mmap_accumulate : read_accumulate, file_sum_combine
+    };
+    FileSumAcc total;
+    int error = 0;
+    if (!ReduceRun(get_sum_pool(threads_num), &ops, &ctx, 0, ctx.count, ctx.chunk,
+                   &total))
+        error = ENOMEM;
+    else
+        error = total.error;
+
+    if (map != MAP_FAILED)
+        munmap(map, ctx.count * size);
+    close(fd);
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    result->sum = total.sum;
+    return 0;
+}
+
+int write_array_file(const char* path, const int* array, size_t array_size) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+    size_t written = fwrite(array, sizeof(int), array_size, file);
+    if (fclose(file) != 0 || written != array_size)
+        return -1;
+    return 0;
+}
+
+void format_int128(__int128 value, char* buf, size_t len) {
+    char digits[48];
+    int n = 0;
+    unsigned __int128 magnitude = value < 0 ? -(unsigned __int128)value
+                                            : (unsigned __int128)value;
+    do {
+        digits[n++] = (char)('0' + (int)(magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    size_t pos = 0;
+    if (value < 0 && pos + 1 < len)
+        buf[pos++] = '-';
+    while (n > 0 && pos + 1 < len)
+        buf[pos++] = digits[--n];
+    buf[pos] = '\0';
+}
@@ -0,0 +1,47 @@
+#ifndef FILE_SUM_H
+#define FILE_SUM_H
+
+#include <stddef.h>
+
+// Суммирование двоичного файла с числами int32 или int64 (порядок байт
+// машины). Размеры 64-битные; сумма копится в 128 битах, поэтому не
+// переполняется и на файлах в сотни гигабайт.
+
+typedef enum {
+    ELEM_INT32,
+    ELEM_INT64
+} ElemType;
+
+typedef enum {
+    IO_AUTO,  // mmap, если файл помещается в память, иначе read
+    IO_MMAP,  // отображение файла, MADV_SEQUENTIAL
+    IO_READ   // pread в буферы потоков с упреждающим чтением следующей части
+} IoMode;
+
+typedef struct {
+    __int128 sum;
+    size_t count;   // число элементов; неполный хвост файла отбрасывается
+    IoMode io;      // фактически использованный режим
+} FileSumResult;
+
+// Разбор имен "int32"/"int64" и "auto"/"mmap"/"read"; -1 при ошибке
+int parse_elem_type(const char* name, ElemType* type);
+int parse_io_mode(const char* name, IoMode* mode);
+
+const char* elem_type_name(ElemType type);
+const char* io_mode_name(IoMode mode);
+
+size_t elem_size(ElemType type);
+
+// Параллельная сумма файла в пуле get_sum_pool(threads_num).
+// 0 при успехе, -1 при ошибке ввода-вывода (errno сохраняется).
+int file_sum(const char* path, ElemType type, IoMode mode, int threads_num,
+             FileSumResult* result);
+
+// Запись массива int в файл, чтобы получить входные данные из seed
+int write_array_file(const char* path, const int* array, size_t array_size);
+
+// Десятичная запись 128-битного числа
+void format_int128(__int128 value, char* buf, size_t len);
+
+#endif
@@ -1,17 +1,65 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
-#include <sys/time.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "utils.h"
 #include "sum_utils.h"
+#include "file_sum.h"
+
+// Монотонные часы: не скачут при коррекции системного времени
+static double elapsed_ms(const struct timespec *start, const struct timespec *finish) {
+    return (finish->tv_sec - start->tv_sec) * 1000.0 +
+           (finish->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Сумма двоичного файла вместо сгенерированного массива
+static int run_file_sum(const char *path, ElemType type, IoMode io, int threads_num) {
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    FileSumResult result;
+    if (file_sum(path, type, io, threads_num, &result) != 0) {
+        printf("Failed to sum %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    struct timespec finish_time;
+    clock_gettime(CLOCK_MONOTONIC, &finish_time);
+    double elapsed_time = elapsed_ms(&start_time, &finish_time);
+
+    char total[48];
+    format_int128(result.sum, total, sizeof(total));
+
+    printf("\n=== PARALLEL FILE SUM RESULTS ===\n");
+    printf("File: %s\n", path);
+    printf("Threads number: %d\n", threads_num);
+    printf("Element type: %s\n", elem_type_name(type));
+    printf("Elements: %zu\n", result.count);
+    printf("I/O mode: %s\n", io_mode_name(result.io));
+    printf("Total sum: %s\n", total);
+    printf("Elapsed time: %.3f ms\n", elapsed_time);
+    printf("Sum kernel: %s\n", sum_kernel_name());
+    printf("Throughput: %.2f GB/s\n",
+           elem_size(type) * (double)result.count / (elapsed_time * 1e6));
+    return 0;
+}
 
 int main(int argc, char **argv) {
     int threads_num = -1;
     int seed = -1;
-    int array_size = -1;
+    size_t array_size = 0;
+    const char *kernel = NULL;
+    int parallel_gen = 0;
+    const char *input_file = NULL;
+    const char *output_file = NULL;
+    ElemType elem_type = ELEM_INT32;
+    IoMode io_mode = IO_AUTO;
 
     // Разбор аргументов командной строки
     while (1) {
@@ -19,11 +67,17 @@ int main(int argc, char **argv) {
             {"threads_num", required_argument, 0, 't'},
             {"seed", required_argument, 0, 's'},
             {"array_size", required_argument, 0, 'a'},
+            {"kernel", required_argument, 0, 'k'},
+            {"parallel_gen", no_argument, 0, 'g'},
+            {"file", required_argument, 0, 'f'},
+            {"type", required_argument, 0, 'y'},
+            {"io", required_argument, 0, 'i'},
+            {"write_file", required_argument, 0, 'w'},
             {0, 0, 0, 0}
         };
 
         int option_index = 0;
-        int c = getopt_long(argc, argv, "t:s:a:", options, &option_index);
+        int c = getopt_long(argc, argv, "t:s:a:k:gf:y:i:w:", options, &option_index);
 
         if (c == -1) break;
 
@@ -42,13 +96,40 @@ int main(int argc, char **argv) {
                     return 1;
                 }
                 break;
-            case 'a':
-                array_size = atoi(optarg);
-                if (array_size <= 0) {
+            case 'a': {
+                char *end = NULL;
+                errno = 0;
+                array_size = strtoull(optarg, &end, 10);
+                if (errno != 0 || *end != '\0' || optarg[0] == '-' || array_size == 0) {
                     printf("array_size must be a positive number\n");
                     return 1;
                 }
                 break;
+            }
+            case 'k':
+                kernel = optarg;
+                break;
+            case 'g':
+                parallel_gen = 1;
+                break;
+            case 'f':
+                input_file = optarg;
+                break;
+            case 'y':
+                if (parse_elem_type(optarg, &elem_type) != 0) {
+                    printf("type must be int32 or int64\n");
+                    return 1;
+                }
+                break;
+            case 'i':
+                if (parse_io_mode(optarg, &io_mode) != 0) {
+                    printf("io must be auto, mmap or read\n");
+                    return 1;
+                }
+                break;
+            case 'w':
+                output_file = optarg;
+                break;
             case '?':
                 break;
             default:
@@ -56,52 +137,87 @@ int main(int argc, char **argv) {
         }
     }
 
-    if (threads_num == -1 || seed == -1 || array_size == -1) {
-        printf("Usage: %s --threads_num \"num\" --seed \"num\" --array_size \"num\"\n", argv[0]);
+    if (threads_num == -1 || (input_file == NULL && (seed == -1 || array_size == 0))) {
+        printf("Usage: %s --threads_num \"num\" --seed \"num\" --array_size \"num\" "
+               "[--kernel scalar|sse4|avx2|avx512] [--parallel_gen] "
+               "[--write_file \"path\"]\n", argv[0]);
+        printf("       %s --threads_num \"num\" --file \"path\" "
+               "[--type int32|int64] [--io auto|mmap|read] [--kernel ...]\n", argv[0]);
+        return 1;
+    }
+
+    // Ядро суммирования выбирается один раз по возможностям процессора
+    if (select_sum_kernel(kernel) != 0) {
+        printf("Kernel %s is unknown or not supported by this CPU\n", kernel);
         return 1;
     }
 
-    // Выделяем память под массив
-    int *array = malloc(sizeof(int) * array_size);
+    if (input_file != NULL) {
+        int status = run_file_sum(input_file, elem_type, io_mode, threads_num);
+        sum_pool_shutdown();
+        return status;
+    }
+
+    // Выделяем память под массив; страницы касаются потоки,
+    // которые затем будут считать свою часть
+    int *array = allocate_array_first_touch(array_size, threads_num);
     if (array == NULL) {
         printf("Memory allocation failed\n");
         return 1;
     }
 
-    // Генерируем массив (не входит в замер времени)
-    printf("Generating array with size %d...\n", array_size);
-    GenerateArray(array, array_size, seed);
+    // Генерируем массив (замеряется отдельно от подсчета суммы)
+    printf("Generating array with size %zu...\n", array_size);
+    struct timespec gen_start;
+    clock_gettime(CLOCK_MONOTONIC, &gen_start);
+    if (parallel_gen) {
+        GenerateArrayParallel(array, array_size, seed, threads_num);
+    } else {
+        GenerateArray(array, array_size, seed);
+    }
+    struct timespec gen_finish;
+    clock_gettime(CLOCK_MONOTONIC, &gen_finish);
+    double gen_time = elapsed_ms(&gen_start, &gen_finish);
+
+    // Сгенерированный массив можно сохранить как входной файл для --file
+    if (output_file != NULL && write_array_file(output_file, array, array_size) != 0) {
+        printf("Failed to write %s: %s\n", output_file, strerror(errno));
+        free(array);
+        return 1;
+    }
 
     // Замер времени начала вычислений
-    struct timeval start_time;
-    gettimeofday(&start_time, NULL);
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
 
     // Параллельный подсчет суммы
     long long total_sum = parallel_sum(array, array_size, threads_num);
 
     // Замер времени окончания вычислений
-    struct timeval finish_time;
-    gettimeofday(&finish_time, NULL);
+    struct timespec finish_time;
+    clock_gettime(CLOCK_MONOTONIC, &finish_time);
 
     // Вычисляем время выполнения
-    double elapsed_time = (finish_time.tv_sec - start_time.tv_sec) * 1000.0;
-    elapsed_time += (finish_time.tv_usec - start_time.tv_usec) / 1000.0;
+    double elapsed_time = elapsed_ms(&start_time, &finish_time);
 
     // Выводим результаты
     printf("\n=== PARALLEL SUM RESULTS ===\n");
     printf("Threads number: %d\n", threads_num);
-    printf("Array size: %d\n", array_size);
+    printf("Array size: %zu\n", array_size);
     printf("Total sum: %lld\n", total_sum);
+    printf("Generation time: %.3f ms (%s)\n", gen_time,
+           parallel_gen ? "parallel" : "serial");
     printf("Elapsed time: %.3f ms\n", elapsed_time);
+    printf("Sum kernel: %s\n", sum_kernel_name());
+    printf("Throughput: %.2f GB/s\n",
+           sizeof(int) * (double)array_size / (elapsed_time * 1e6));
 
-    // Проверка последовательным подсчетом (для верификации)
-    long long sequential_sum = 0;
-    for (int i = 0; i < array_size; i++) {
-        sequential_sum += array[i];
-    }
+    // Проверка последовательным подсчетом эталонным ядром
+    long long sequential_sum = sum_ints_scalar(array, array_size);
     printf("Sequential sum: %lld\n", sequential_sum);
     printf("Results match: %s\n", (total_sum == sequential_sum) ? "YES" : "NO");
 
+    sum_pool_shutdown();
     free(array);
     return 0;
 }
\ No newline at end of file
@@ -1,45 +1,247 @@
 #include "sum_utils.h"
+#include "reduce.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-void* calculate_partial_sum(void* arg) {
-    ThreadData* data = (ThreadData*)arg;
-    data->partial_sum = 0;
-    
-    for (int i = data->start; i < data->end; i++) {
-        data->partial_sum += data->array[i];
-    }
-    
-    return NULL;
-}
-
-long long parallel_sum(int* array, int array_size, int threads_num) {
-    pthread_t threads[threads_num];
-    ThreadData thread_data[threads_num];
-    
-    int chunk_size = array_size / threads_num;
-    
-    // Создаем потоки для подсчета частичных сумм
-    for (int i = 0; i < threads_num; i++) {
-        thread_data[i].array = array;
-        thread_data[i].start = i * chunk_size;
-        thread_data[i].end = (i == threads_num - 1) ? array_size : (i + 1) * chunk_size;
-        
-        if (pthread_create(&threads[i], NULL, calculate_partial_sum, &thread_data[i]) != 0) {
-            perror("Failed to create thread");
-            exit(1);
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUM_X86 1
+#endif
+
+// Числа int в одной кэш-линии: границы частей выравниваются по ним
+#define INTS_PER_LINE (CACHE_LINE_SIZE / (int)sizeof(int))
+
+long long sum_ints_scalar(const int* array, long count) {
+    long long sum = 0;
+    for (long i = 0; i < count; i++) {
+        sum += array[i];
+    }
+    return sum;
+}
+
+#ifdef SUM_X86
+
+// Векторные ядра расширяют int до 64 бит (pmovsxdq) и складывают в
+// несколько независимых аккумуляторов, чтобы сложения не ждали друг друга
+
+__attribute__((target("sse4.1")))
+long long sum_ints_sse4(const int* array, long count) {
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128(), acc3 = _mm_setzero_si128();
+    long i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(array + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(array + i + 4));
+        acc0 = _mm_add_epi64(acc0, _mm_cvtepi32_epi64(a));
+        acc1 = _mm_add_epi64(acc1, _mm_cvtepi32_epi64(_mm_srli_si128(a, 8)));
+        acc2 = _mm_add_epi64(acc2, _mm_cvtepi32_epi64(b));
+        acc3 = _mm_add_epi64(acc3, _mm_cvtepi32_epi64(_mm_srli_si128(b, 8)));
+    }
+
+    __m128i acc = _mm_add_epi64(_mm_add_epi64(acc0, acc1), _mm_add_epi64(acc2, acc3));
+    long long lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1] + sum_ints_scalar(array + i, count - i);
+}
+
+__attribute__((target("avx2")))
+long long sum_ints_avx2(const int* array, long count) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+    long i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(array + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(array + i + 8));
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(a)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(a, 1)));
+        acc2 = _mm256_add_epi64(acc2, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(b)));
+        acc3 = _mm256_add_epi64(acc3, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(b, 1)));
+    }
+
+    __m256i acc = _mm256_add_epi64(_mm256_add_epi64(acc0, acc1),
+                                   _mm256_add_epi64(acc2, acc3));
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           sum_ints_scalar(array + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+long long sum_ints_avx512(const int* array, long count) {
+    __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+    __m512i acc2 = _mm512_setzero_si512(), acc3 = _mm512_setzero_si512();
+    long i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m512i a = _mm512_loadu_si512(array + i);
+        __m512i b = _mm512_loadu_si512(array + i + 16);
+        acc0 = _mm512_add_epi64(acc0, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(a)));
+        acc1 = _mm512_add_epi64(acc1, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(a, 1)));
+        acc2 = _mm512_add_epi64(acc2, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(b)));
+        acc3 = _mm512_add_epi64(acc3, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(b, 1)));
+    }
+
+    __m512i acc = _mm512_add_epi64(_mm512_add_epi64(acc0, acc1),
+                                   _mm512_add_epi64(acc2, acc3));
+    return _mm512_reduce_add_epi64(acc) + sum_ints_scalar(array + i, count - i);
+}
+
+#else
+
+long long sum_ints_sse4(const int* array, long count) {
+    return sum_ints_scalar(array, count);
+}
+
+long long sum_ints_avx2(const int* array, long count) {
+    return sum_ints_scalar(array, count);
+}
+
+long long sum_ints_avx512(const int* array, long count) {
+    return sum_ints_scalar(array, count);
+}
+
+#endif
+
+static const struct {
+    const char* name;
+    const char* feature;  // для __builtin_cpu_supports, NULL - всегда доступно
+    SumKernel kernel;
+} sum_kernels[] = {
+    {"avx512", "avx512f", sum_ints_avx512},
+    {"avx2", "avx2", sum_ints_avx2},
+    {"sse4", "sse4.1", sum_ints_sse4},
+    {"scalar", NULL, sum_ints_scalar},
+};
+
+#define SUM_KERNELS_NUM ((int)(sizeof(sum_kernels) / sizeof(sum_kernels[0])))
+
+// Выбранное ядро; по умолчанию эталонное до вызова select_sum_kernel
+static int sum_kernel_index = SUM_KERNELS_NUM - 1;
+
+static int kernel_supported(int index) {
+    const char* feature = sum_kernels[index].feature;
+    if (feature == NULL)
+        return 1;
+#ifdef SUM_X86
+    // __builtin_cpu_supports требует константу, поэтому перебираем явно
+    if (strcmp(feature, "avx512f") == 0)
+        return __builtin_cpu_supports("avx512f");
+    if (strcmp(feature, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(feature, "sse4.1") == 0)
+        return __builtin_cpu_supports("sse4.1");
+#endif
+    return 0;
+}
+
+int select_sum_kernel(const char* name) {
+    for (int i = 0; i < SUM_KERNELS_NUM; i++) {
+        if (name != NULL && strcmp(name, sum_kernels[i].name) != 0)
+            continue;
+        if (!kernel_supported(i)) {
+            if (name != NULL)
+                return -1;
+            continue;
         }
+        sum_kernel_index = i;
+        return 0;
     }
-    
-    // Ждем завершения всех потоков и суммируем результаты
-    long long total_sum = 0;
-    for (int i = 0; i < threads_num; i++) {
-        if (pthread_join(threads[i], NULL) != 0) {
-            perror("Failed to join thread");
+    return -1;
+}
+
+const char* sum_kernel_name(void) {
+    return sum_kernels[sum_kernel_index].name;
+}
+
+SumKernel current_sum_kernel(void) {
+    return sum_kernels[sum_kernel_index].kernel;
+}
+
+// Пул живет между вызовами: первое касание и подсчет суммы выполняются
+// одними и теми же привязанными к процессорам потоками
+static struct WorkPool* sum_pool = NULL;
+
+struct WorkPool* get_sum_pool(int threads_num) {
+    if (sum_pool != NULL && WorkPoolThreads(sum_pool) != threads_num)
+        sum_pool_shutdown();
+    if (sum_pool == NULL) {
+        sum_pool = WorkPoolCreate(threads_num, true);
+        if (sum_pool == NULL) {
+            perror("Failed to create thread pool");
             exit(1);
         }
-        total_sum += thread_data[i].partial_sum;
     }
-    
+    return sum_pool;
+}
+
+void sum_pool_shutdown(void) {
+    if (sum_pool != NULL) {
+        WorkPoolDestroy(sum_pool);
+        sum_pool = NULL;
+    }
+}
+
+static void sum_init(void* acc, void* ctx) {
+    (void)ctx;
+    *(long long*)acc = 0;
+}
+
+// Накопление в регистрах ядра, запись в аккумулятор потока один раз на часть
+static void sum_accumulate(void* acc, size_t begin, size_t end, void* ctx) {
+    const int* array = ctx;
+    *(long long*)acc += current_sum_kernel()(array + begin, (long)(end - begin));
+}
+
+static void sum_combine(void* acc, const void* other, void* ctx) {
+    (void)ctx;
+    *(long long*)acc += *(const long long*)other;
+}
+
+static void touch_pages(void* acc, size_t begin, size_t end, void* ctx) {
+    (void)acc;
+    memset((int*)ctx + begin, 0, sizeof(int) * (end - begin));
+}
+
+// Границы частей выровнены по кэш-линиям, чтобы соседние части не делили
+// линию. Касание и суммирование идут без перехвата (ReduceRunPinned):
+// перехваченную часть трогал бы один поток, а суммировал другой, и её
+// страницы оказались бы на чужом узле NUMA. Поток i в обоих проходах
+// получает один и тот же блок частей.
+static const struct ReduceOps sum_ops = {
+    sizeof(long long), INTS_PER_LINE, sum_init, sum_accumulate, sum_combine
+};
+
+static const struct ReduceOps touch_ops = {
+    0, INTS_PER_LINE, NULL, touch_pages, NULL
+};
+
+long long parallel_sum(int* array, size_t array_size, int threads_num) {
+    long long total_sum = 0;
+    if (!ReduceRunPinned(get_sum_pool(threads_num), &sum_ops, array, 0,
+                         array_size, 0, &total_sum)) {
+        perror("Parallel sum failed");
+        exit(1);
+    }
     return total_sum;
-}
\ No newline at end of file
+}
+
+int* allocate_array_first_touch(size_t array_size, int threads_num) {
+    long page = sysconf(_SC_PAGESIZE);
+    if (page < CACHE_LINE_SIZE)
+        page = CACHE_LINE_SIZE;
+
+    // Размер aligned_alloc должен быть кратен выравниванию
+    size_t bytes = sizeof(int) * array_size;
+    bytes = (bytes + page - 1) / page * page;
+    int* array = aligned_alloc(page, bytes);
+    if (array == NULL)
+        return NULL;
+
+    if (!ReduceRunPinned(get_sum_pool(threads_num), &touch_ops, array, 0,
+                         array_size, 0, NULL)) {
+        free(array);
+        return NULL;
+    }
+    return array;
+}
@@ -1,20 +1,47 @@
 #ifndef SUM_UTILS_H
 #define SUM_UTILS_H
 
-#include <pthread.h>
+#include <stddef.h>
 
-// Структура для передачи данных в поток
-typedef struct {
-    int* array;
-    int start;
-    int end;
-    long long partial_sum;
-} ThreadData;
+#define CACHE_LINE_SIZE 64
 
-// Функция для подсчета частичной суммы (будет использоваться в потоках)
-void* calculate_partial_sum(void* arg);
+struct WorkPool;
 
-// Функция для параллельного подсчета суммы массива
-long long parallel_sum(int* array, int array_size, int threads_num);
+// Ядро суммирования части массива
+typedef long long (*SumKernel)(const int* array, long count);
 
-#endif
\ No newline at end of file
+// Доступные ядра; scalar - эталонная реализация
+long long sum_ints_scalar(const int* array, long count);
+long long sum_ints_sse4(const int* array, long count);
+long long sum_ints_avx2(const int* array, long count);
+long long sum_ints_avx512(const int* array, long count);
+
+// Выбор ядра по имени ("scalar", "sse4", "avx2", "avx512") или, при
+// name == NULL, самого широкого из поддерживаемых процессором.
+// Возвращает 0 при успехе, -1 если ядро неизвестно или не поддерживается.
+int select_sum_kernel(const char* name);
+
+// Имя выбранного ядра
+const char* sum_kernel_name(void);
+
+// Выбранное ядро
+SumKernel current_sum_kernel(void);
+
+// Функция для параллельного подсчета суммы массива. Сумма считается
+// редукцией из lib/reduce.h в пуле из threads_num потоков; пул создается
+// при первом вызове и переиспользуется до sum_pool_shutdown. Части не
+// перехватываются, чтобы совпадать с allocate_array_first_touch.
+long long parallel_sum(int* array, size_t array_size, int threads_num);
+
+// Выделение памяти под массив с первым касанием страниц теми же потоками
+// пула и теми же частями, что потом будут считать сумму: на NUMA-машинах
+// каждая часть массива окажется в памяти узла своего потока
+int* allocate_array_first_touch(size_t array_size, int threads_num);
+
+// Пул из threads_num потоков, общий для всех редукций программы
+struct WorkPool* get_sum_pool(int threads_num);
+
+// Остановка потоков пула
+void sum_pool_shutdown(void);
+
+#endif
@@ -1,9 +1,67 @@
 #include "utils.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
-void GenerateArray(int *array, unsigned int array_size, unsigned int seed) {
-    srand(seed);
-    for (unsigned int i = 0; i < array_size; i++) {
-        array[i] = rand() % 1000; // Ограничим числа для удобства проверки
+// Генератор SplitMix64 от счётчика: i-й элемент не зависит от остальных
+static inline uint64_t SplitMix64(unsigned int seed, uint64_t i) {
+    uint64_t z = ((uint64_t)seed << 32 ^ seed) + (i + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void GenerateRange(int *array, size_t begin, size_t end,
+                          unsigned int seed) {
+    for (size_t i = begin; i < end; i++) {
+        array[i] = (int)(SplitMix64(seed, i) % 1000); // Ограничим числа для удобства проверки
+    }
+}
+
+void GenerateArray(int *array, size_t array_size, unsigned int seed) {
+    GenerateRange(array, 0, array_size, seed);
+}
+
+struct GenerateTask {
+    int *array;
+    size_t begin;
+    size_t end;
+    unsigned int seed;
+};
+
+static void *GenerateThread(void *arg) {
+    struct GenerateTask *task = (struct GenerateTask *)arg;
+    GenerateRange(task->array, task->begin, task->end, task->seed);
+    return NULL;
+}
+
+void GenerateArrayParallel(int *array, size_t array_size, unsigned int seed,
+                           int threads_num) {
+    if (threads_num <= 1) {
+        GenerateArray(array, array_size, seed);
+        return;
+    }
+
+    pthread_t threads[threads_num];
+    struct GenerateTask tasks[threads_num];
+    size_t chunk_size = array_size / threads_num;
+
+    for (int i = 0; i < threads_num; i++) {
+        tasks[i].array = array;
+        tasks[i].begin = i * chunk_size;
+        tasks[i].end = (i == threads_num - 1) ? array_size : (i + 1) * chunk_size;
+        tasks[i].seed = seed;
+        if (pthread_create(&threads[i], NULL, GenerateThread, &tasks[i]) != 0) {
+            // Оставшиеся части заполняем в текущем потоке
+            GenerateRange(array, tasks[i].begin, array_size, seed);
+            threads_num = i;
+            break;
+        }
+    }
+
+    for (int i = 0; i < threads_num; i++) {
+        pthread_join(threads[i], NULL);
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,14 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-void GenerateArray(int *array, unsigned int array_size, unsigned int seed);
+#include <stddef.h>
 
-#endif
\ No newline at end of file
+// Элементы массива вычисляются по seed и индексу (счётчику), поэтому
+// массив не зависит от числа потоков, которыми он заполнялся
+void GenerateArray(int *array, size_t array_size, unsigned int seed);
+
+// То же самое, threads_num потоков заполняют свои части массива
+void GenerateArrayParallel(int *array, size_t array_size, unsigned int seed,
+                           int threads_num);
+
+#endif
@@ -1,102 +1,81 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
 #include <getopt.h>
 #include <string.h>
+#include <time.h>
 
-// Глобальный мьютекс для синхронизации доступа к общему результату
-pthread_mutex_t result_mutex = PTHREAD_MUTEX_INITIALIZER;
+#include "reduce.h"
 
-// Структура для передачи данных в поток
+// Произведение по модулю как редукция из lib/reduce.h: каждый поток пула
+// копит произведение своих частей в собственном аккумуляторе, частичные
+// результаты сводятся один раз после пакета, без общего мьютекса
 typedef struct {
-    int start;
-    int end;
     long long mod;
-    long long partial_result;
-    long long* total_result;  // Указатель на общий результат
-} ThreadData;
+} FactorialContext;
 
-// Функция для вычисления частичного факториала
-void* calculate_partial_factorial(void* arg) {
-    ThreadData* data = (ThreadData*)arg;
-    data->partial_result = 1;
-    
-    // Вычисляем частичный результат
-    for (int i = data->start; i <= data->end; i++) {
-        data->partial_result = (data->partial_result * i) % data->mod;
+// Умножение по модулю через 128-битное промежуточное произведение:
+// для mod > 2^32 произведение двух остатков не помещается в 64 бита
+static long long mul_mod(long long a, long long b, long long mod) {
+    return (long long)((unsigned __int128)a * (unsigned __int128)b % mod);
+}
+
+static void factorial_init(void* acc, void* ctx) {
+    (void)ctx;
+    *(long long*)acc = 1;
+}
+
+// Часть [begin, end) - индексы чисел, число i равно индексу
+static void factorial_accumulate(void* acc, size_t begin, size_t end, void* ctx) {
+    long long mod = ((FactorialContext*)ctx)->mod;
+    long long result = *(long long*)acc;
+    for (size_t i = begin; i < end; i++) {
+        result = mul_mod(result, (long long)i, mod);
     }
-    
-    printf("Thread: factorial from %d to %d mod %lld = %lld\n", 
-           data->start, data->end, data->mod, data->partial_result);
-    
-    // СИНХРОНИЗАЦИЯ: Блокируем мьютекс для обновления общего результата
-    pthread_mutex_lock(&result_mutex);
-    
-    // Обновляем общий результат
-    *data->total_result = (*data->total_result * data->partial_result) % data->mod;
-    printf("Thread: updated total result to %lld\n", *data->total_result);
-    
-    // СИНХРОНИЗАЦИЯ: Разблокируем мьютекс
-    pthread_mutex_unlock(&result_mutex);
-    
-    return NULL;
+    *(long long*)acc = result;
+}
+
+static void factorial_combine(void* acc, const void* other, void* ctx) {
+    long long mod = ((FactorialContext*)ctx)->mod;
+    *(long long*)acc = mul_mod(*(long long*)acc, *(const long long*)other, mod);
 }
 
+static const struct ReduceOps factorial_ops = {
+    sizeof(long long), 1, factorial_init, factorial_accumulate, factorial_combine
+};
+
 // Функция для параллельного вычисления факториала
 long long parallel_factorial(int k, int threads_num, long long mod) {
-    if (k <= 1) return 1;
-    
-    pthread_t threads[threads_num];
-    ThreadData thread_data[threads_num];
-    
-    // Общий результат, защищаемый мьютексом
-    long long total_result = 1;
-    
-    // Распределяем числа между потоками
-    int numbers_per_thread = k / threads_num;
-    int remainder = k % threads_num;
+    if (k <= 1) return 1 % mod;
     
-    int current_start = 1;
-    
-    // Создаем потоки
-    for (int i = 0; i < threads_num; i++) {
-        int numbers_count = numbers_per_thread;
-        if (i < remainder) {
-            numbers_count++;
-        }
-        
-        thread_data[i].start = current_start;
-        thread_data[i].end = current_start + numbers_count - 1;
-        thread_data[i].mod = mod;
-        thread_data[i].total_result = &total_result;  // Передаем указатель на общий результат
-        
-        printf("Thread %d: numbers from %d to %d\n", 
-               i, thread_data[i].start, thread_data[i].end);
-        
-        if (pthread_create(&threads[i], NULL, calculate_partial_factorial, &thread_data[i]) != 0) {
-            perror("Failed to create thread");
-            exit(1);
-        }
-        
-        current_start += numbers_count;
+    struct WorkPool* pool = WorkPoolCreate(threads_num, false);
+    if (pool == NULL) {
+        perror("Failed to create thread pool");
+        exit(1);
     }
     
-    // Ждем завершения всех потоков
-    for (int i = 0; i < threads_num; i++) {
-        if (pthread_join(threads[i], NULL) != 0) {
-            perror("Failed to join thread");
-            exit(1);
-        }
+    FactorialContext ctx = {mod};
+    size_t chunk = ReduceChunkSize((size_t)k - 1, threads_num, 1);
+    printf("Pool: %d threads, numbers 2..%d in chunks of %zu\n",
+           threads_num, k, chunk);
+    
+    long long result = 1;
+    if (!ReduceRun(pool, &factorial_ops, &ctx, 2, (size_t)k + 1, chunk, &result)) {
+        perror("Parallel factorial failed");
+        exit(1);
     }
     
-    return total_result;
+    printf("Chunks taken over by other threads: %zu\n", WorkPoolStolen(pool));
+    WorkPoolDestroy(pool);
+    return result;
 }
 
 // Функция для проверки (последовательное вычисление)
 long long sequential_factorial(int k, long long mod) {
-    long long result = 1;
+    long long result = 1 % mod;
     for (int i = 2; i <= k; i++) {
-        result = (result * i) % mod;
+        result = mul_mod(result, i, mod);
     }
     return result;
 }
@@ -153,14 +132,19 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    printf("=== PARALLEL FACTORIAL COMPUTATION WITH MUTEX ===\n");
+    printf("=== PARALLEL FACTORIAL COMPUTATION ===\n");
     printf("k = %d\n", k);
     printf("Threads number = %d\n", threads_num);
     printf("Modulus = %lld\n", mod);
     printf("\n");
     
     // Параллельное вычисление
+    struct timespec start_time, finish_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
     long long parallel_result = parallel_factorial(k, threads_num, mod);
+    clock_gettime(CLOCK_MONOTONIC, &finish_time);
+    double elapsed_time = (finish_time.tv_sec - start_time.tv_sec) * 1000.0 +
+                          (finish_time.tv_nsec - start_time.tv_nsec) / 1e6;
     
     // Последовательное вычисление для проверки
     long long sequential_result = sequential_factorial(k, mod);
@@ -171,9 +155,7 @@ int main(int argc, char *argv[]) {
     printf("Sequential result: %d! mod %lld = %lld\n", k, mod, sequential_result);
     printf("Results match: %s\n", 
            (parallel_result == sequential_result) ? "YES" : "NO");
-    
-    // Уничтожаем глобальный мьютекс
-    pthread_mutex_destroy(&result_mutex);
+    printf("Elapsed time: %.3f ms\n", elapsed_time);
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "mod_arith.h"
+
+#define NUMBERS (1u << 24)
+
+static double NowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Скорость ядер ModRangeProduct в одном потоке, чисел в секунду
+int main(void) {
+    const uint64_t moduli[] = {
+        1000000007ULL,           // нечётный < 2^32: векторные ядра
+        2305843009213693951ULL,  // 2^61 - 1: Монтгомери в обычных регистрах
+        1000000000000000000ULL   // 10^18, чётный: Барретт
+    };
+    const int moduli_num = sizeof(moduli) / sizeof(moduli[0]);
+    const enum ModKernel kernels[] = {
+        MOD_KERNEL_SCALAR, MOD_KERNEL_LANES, MOD_KERNEL_AVX2, MOD_KERNEL_AVX512
+    };
+    const int kernels_num = sizeof(kernels) / sizeof(kernels[0]);
+
+    printf("Best kernel on this CPU: %s\n", ModKernelName(ModBestKernel()));
+    printf("%-22s %-8s %16s %10s\n", "mod", "kernel", "numbers/s", "speedup");
+
+    for (int m = 0; m < moduli_num; m++) {
+        struct ModContext ctx;
+        ModContextInit(&ctx, moduli[m]);
+
+        double scalar_rate = 0;
+        uint64_t expected = 0;
+        for (int k = 0; k < kernels_num; k++) {
+            if (!ModKernelSupported(kernels[k])) {
+                printf("%-22llu %-8s %16s\n", (unsigned long long)moduli[m],
+                       ModKernelName(kernels[k]), "unsupported");
+                continue;
+            }
+
+            double start = NowSeconds();
+            uint64_t result = ModRangeProductKernel(&ctx, 1, NUMBERS, kernels[k]);
+            double rate = NUMBERS / (NowSeconds() - start);
+
+            if (k == 0) {
+                scalar_rate = rate;
+                expected = result;
+            } else if (result != expected) {
+                fprintf(stderr, "Mismatch for mod %llu, kernel %s\n",
+                        (unsigned long long)moduli[m], ModKernelName(kernels[k]));
+                return 1;
+            }
+
+            printf("%-22llu %-8s %16.0f %9.2fx\n", (unsigned long long)moduli[m],
+                   ModKernelName(kernels[k]), rate, rate / scalar_rate);
+        }
+    }
+
+    return 0;
+}
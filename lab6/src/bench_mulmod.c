@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+
+#define ITERATIONS (1u << 20)
+
+// Прежняя реализация MultModulo (сложение с удвоением), оставлена для сравнения
+static uint64_t MultModuloBitSerial(uint64_t a, uint64_t b, uint64_t mod) {
+    uint64_t result = 0;
+    a = a % mod;
+
+    while (b > 0) {
+        if (b % 2 == 1)
+            result = (result + a) % mod;
+        a = (a * 2) % mod;
+        b /= 2;
+    }
+
+    return result % mod;
+}
+
+static double NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t NextRandom(uint64_t *state) {
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+int main(void) {
+    const uint64_t moduli[] = {
+        1000003ULL,                 // ~2^20, нечётный
+        1000000007ULL,              // ~2^30, нечётный
+        4294967296ULL + 2,          // ~2^32, чётный
+        2305843009213693951ULL,     // 2^61 - 1
+        1000000000000000000ULL,     // 10^18, чётный
+        18446744073709551557ULL     // наибольшее 64-битное простое
+    };
+    const int moduli_num = sizeof(moduli) / sizeof(moduli[0]);
+
+    uint64_t *operands = malloc(sizeof(uint64_t) * ITERATIONS);
+    if (!operands) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    printf("%-22s %-10s %12s %12s %12s %12s\n", "mod", "kind", "bitserial",
+           "u128 %", "ModMul", "RangeProd");
+
+    for (int m = 0; m < moduli_num; m++) {
+        uint64_t mod = moduli[m];
+        struct ModContext ctx;
+        ModContextInit(&ctx, mod);
+
+        uint64_t state = 88172645463325252ULL;
+        for (uint32_t i = 0; i < ITERATIONS; i++)
+            operands[i] = NextRandom(&state) % mod;
+
+        // Цепочка зависимых умножений, как в Factorial()
+        double start = NowNs();
+        uint64_t acc_old = 1;
+        for (uint32_t i = 0; i < ITERATIONS; i++)
+            acc_old = MultModuloBitSerial(acc_old, operands[i], mod);
+        double old_ns = (NowNs() - start) / ITERATIONS;
+
+        start = NowNs();
+        uint64_t acc_u128 = 1;
+        for (uint32_t i = 0; i < ITERATIONS; i++)
+            acc_u128 = MultModulo(acc_u128, operands[i], mod);
+        double u128_ns = (NowNs() - start) / ITERATIONS;
+
+        start = NowNs();
+        uint64_t acc_new = 1;
+        for (uint32_t i = 0; i < ITERATIONS; i++)
+            acc_new = ModMul(&ctx, acc_new, operands[i]);
+        double new_ns = (NowNs() - start) / ITERATIONS;
+
+        start = NowNs();
+        uint64_t range = ModRangeProduct(&ctx, mod / 2, mod / 2 + ITERATIONS - 1);
+        double range_ns = (NowNs() - start) / ITERATIONS;
+
+        if (acc_u128 != acc_new) {
+            fprintf(stderr, "Mismatch for mod %llu: %llu %llu\n",
+                    (unsigned long long)mod, (unsigned long long)acc_u128,
+                    (unsigned long long)acc_new);
+            free(operands);
+            return 1;
+        }
+
+        // При mod >= 2^63 удвоение a * 2 в старой версии переполняется
+        printf("%-22llu %-10s %9.2f ns %9.2f ns %9.2f ns %9.2f ns  (%llu)%s\n",
+               (unsigned long long)mod,
+               ctx.kind == MOD_KIND_MONTGOMERY ? "montgomery" : "barrett",
+               old_ns, u128_ns, new_ns, range_ns, (unsigned long long)range,
+               acc_old != acc_new ? "  bitserial overflow" : "");
+    }
+
+    free(operands);
+    return 0;
+}
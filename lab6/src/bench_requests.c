@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "common.h"
+
+// Нагрузочный тест: много маленьких запросов по одному соединению,
+// результат в запросах в секунду
+int main(int argc, char **argv) {
+    char server_str[255] = "127.0.0.1:20001";
+    uint64_t requests = 10000;
+    uint64_t range = 8;
+    uint64_t mod = 1000000007ULL;
+
+    while (true) {
+        static struct option options[] = {
+            {"server", required_argument, 0, 0},
+            {"requests", required_argument, 0, 0},
+            {"range", required_argument, 0, 0},
+            {"mod", required_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "", options, &option_index);
+
+        if (c == -1)
+            break;
+        if (c != 0) {
+            fprintf(stderr, "Usage: %s [--server ip:port] [--requests N] "
+                    "[--range N] [--mod N]\n", argv[0]);
+            return 1;
+        }
+
+        bool ok = true;
+        switch (option_index) {
+            case 0:
+                strncpy(server_str, optarg, sizeof(server_str) - 1);
+                break;
+            case 1:
+                ok = ConvertStringToUI64(optarg, &requests) && requests > 0;
+                break;
+            case 2:
+                ok = ConvertStringToUI64(optarg, &range) && range > 0;
+                break;
+            case 3:
+                ok = ConvertStringToUI64(optarg, &mod) && mod > 0;
+                break;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid value: %s\n", optarg);
+            return 1;
+        }
+    }
+
+    char *colon = strchr(server_str, ':');
+    if (!colon) {
+        fprintf(stderr, "Invalid server format (should be ip:port): %s\n", server_str);
+        return 1;
+    }
+    *colon = '\0';
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(atoi(colon + 1));
+    if (inet_pton(AF_INET, server_str, &server_addr.sin_addr) <= 0) {
+        fprintf(stderr, "Bad address: %s\n", server_str);
+        return 1;
+    }
+
+    int sck = socket(AF_INET, SOCK_STREAM, 0);
+    if (sck < 0 ||
+        connect(sck, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        fprintf(stderr, "Connection failed to %s:%s\n", server_str, colon + 1);
+        return 1;
+    }
+
+    struct timespec start, finish;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint64_t i = 0; i < requests; i++) {
+        uint64_t task[3] = {1 + i % 1000, i % 1000 + range, mod};
+        uint64_t answer;
+        if (send(sck, task, sizeof(task), 0) != sizeof(task) ||
+            recv(sck, &answer, sizeof(answer), MSG_WAITALL) != sizeof(answer)) {
+            fprintf(stderr, "Request %llu failed\n", (unsigned long long)i);
+            close(sck);
+            return 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    close(sck);
+
+    double elapsed = (finish.tv_sec - start.tv_sec) +
+                     (finish.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%llu requests of %llu numbers: %.3f s, %.0f requests/s\n",
+           (unsigned long long)requests, (unsigned long long)range, elapsed,
+           requests / elapsed);
+    return 0;
+}
@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,63 +13,180 @@
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include "pthread.h"
-#include "common.h" // для структуры Server и MultModulo
-
-// Конвертация строки в uint64_t
-bool ConvertStringToUI64(const char *str, uint64_t *val) {
-    char *end = NULL;
-    unsigned long long i = strtoull(str, &end, 10);
-    if (errno == ERANGE) {
-        fprintf(stderr, "Out of uint64_t range: %s\n", str);
-        return false;
-    }
-    if (errno != 0)
-        return false;
-    *val = i;
-    return true;
-}
+#include "common.h" // для структуры Server, ConvertStringToUI64 и ModContext
+#include "protocol.h"
+#include "work_queue.h"
+
+// Параметры выдачи участков
+struct ScheduleOptions {
+    uint64_t min_chunk;  // размер первого участка и нижняя граница
+    uint64_t chunk_ms;   // желаемое время счёта одного участка
+    int window;          // сколько участков держать в работе на соединение
+    bool speculate;      // дублировать долгие участки на свободные серверы
+    int timeout_sec;     // ожидание ответа, после которого сервер считается упавшим
+    int retries;         // попыток переподключения подряд без успешных участков
+};
 
 // Структура для передачи аргументов в поток
 struct ThreadArgs {
     struct Server server;
-    uint64_t begin;
-    uint64_t end;
+    struct WorkQueue* queue;
     uint64_t mod;
-    uint64_t* result;
-    int* success_flag;
+    const struct ScheduleOptions* schedule;
+
+    // Статистика, заполняется потоком
+    uint64_t chunks_done;
+    uint64_t numbers_done;
+    double rate;  // чисел в секунду по последним участкам
+    int failures;
+    int success_flag;
+
+    // Текущее соединение, чтобы главный поток мог прервать ожидание ответа
+    pthread_mutex_t sck_mutex;
+    int sck;
 };
 
-// Функция, выполняемая в потоке
-void* ProcessServer(void* thread_args) {
-    struct ThreadArgs* args = (struct ThreadArgs*)thread_args;
-    
-    // Создаём сокет
+// Участок, отправленный серверу и ещё не посчитанный
+struct InFlightRange {
+    size_t id;
+    struct WorkRange range;
+    double sent_at;
+};
+
+static double NowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool SendRange(int sck, size_t id, const struct WorkRange *range,
+                      uint64_t mod) {
+    char frame[PROTOCOL_HEADER_SIZE + RANGE_ITEM_SIZE];
+    struct FrameHeader header = {PROTOCOL_VERSION, FRAME_REQUEST, RANGE_ITEM_SIZE, 1};
+    struct RangeItem item = {id, range->begin, range->end, mod};
+    EncodeHeader(frame, &header);
+    EncodeRangeItem(frame + PROTOCOL_HEADER_SIZE, &item);
+    return SendAll(sck, frame, sizeof(frame));
+}
+
+// Приём одного кадра ответа, false при ошибке соединения или формата
+static bool ReceiveResults(int sck, char *payload, struct FrameHeader *header) {
+    char header_buf[PROTOCOL_HEADER_SIZE];
+    return RecvAll(sck, header_buf, sizeof(header_buf)) &&
+           DecodeHeader(header_buf, header) && header->type == FRAME_RESPONSE &&
+           RecvAll(sck, payload, header->length);
+}
+
+// Обслуживание одного сервера: пока в очереди есть работа, держим в
+// соединении до window участков, размер каждого подбираем по измеренной
+// скорости сервера. При ошибке незавершённые участки возвращаются в
+// очередь. true, если вся работа посчитана.
+static bool ServeConnection(int sck, struct ThreadArgs *args) {
+    const struct ScheduleOptions *schedule = args->schedule;
+    struct InFlightRange in_flight[schedule->window];
+    int in_flight_num = 0;
+    double last_done = 0;
+    char *payload = malloc(PROTOCOL_MAX_ITEMS * RESULT_ITEM_SIZE);
+    if (!payload)
+        return false;
+
+    bool ok = true;
+    while (ok) {
+        while (in_flight_num < schedule->window) {
+            struct InFlightRange *slot = &in_flight[in_flight_num];
+            uint64_t want = WorkChunkSize(args->rate, schedule->chunk_ms,
+                                          schedule->min_chunk);
+            // Без своих участков ждём, пока другие серверы закончат или
+            // вернут работу
+            bool idle = in_flight_num == 0;
+            if (!WorkQueueTake(args->queue, want, idle, schedule->speculate,
+                               &slot->id, &slot->range))
+                break;
+            slot->sent_at = NowSeconds();
+            in_flight_num++;
+            if (!SendRange(sck, slot->id, &slot->range, args->mod)) {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok || in_flight_num == 0)
+            break;
+
+        struct FrameHeader header;
+        if (!ReceiveResults(sck, payload, &header)) {
+            ok = false;
+            break;
+        }
+
+        for (uint32_t i = 0; i < header.count && ok; i++) {
+            struct ResultItem item;
+            DecodeResultItem(payload + i * RESULT_ITEM_SIZE, &item);
+
+            int pos = 0;
+            while (pos < in_flight_num && in_flight[pos].id != item.id)
+                pos++;
+            if (pos == in_flight_num)
+                continue;  // ответ на неизвестный участок
+            if (item.status != RESULT_OK) {
+                ok = false;
+                break;
+            }
+
+            struct InFlightRange done = in_flight[pos];
+            in_flight[pos] = in_flight[--in_flight_num];
+            WorkQueueComplete(args->queue, done.id, item.result);
+
+            // Сервер считал участок с момента отправки или с окончания
+            // предыдущего, если тот ещё был в работе
+            double now = NowSeconds();
+            double start = done.sent_at > last_done ? done.sent_at : last_done;
+            double elapsed = now - start > 1e-6 ? now - start : 1e-6;
+            double numbers = (double)(done.range.end - done.range.begin) + 1;
+            double rate = numbers / elapsed;
+            args->rate = args->rate > 0 ? (args->rate + rate) / 2 : rate;
+            last_done = now;
+
+            args->chunks_done++;
+            args->numbers_done += done.range.end - done.range.begin + 1;
+        }
+    }
+
+    for (int i = 0; i < in_flight_num; i++)
+        WorkQueueFail(args->queue, in_flight[i].id);
+
+    free(payload);
+    return ok;
+}
+
+// Подключение к серверу, -1 при ошибке
+static int ConnectServer(const struct ThreadArgs *args) {
     struct hostent *hostname = gethostbyname(args->server.ip);
     if (hostname == NULL) {
         fprintf(stderr, "gethostbyname failed with %s\n", args->server.ip);
-        *(args->success_flag) = 0;
-        return NULL;
+        return -1;
     }
 
     struct sockaddr_in server_addr;
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(args->server.port);
-    server_addr.sin_addr.s_addr = *((unsigned long *)hostname->h_addr);
+    memcpy(&server_addr.sin_addr.s_addr, hostname->h_addr_list[0],
+           sizeof(server_addr.sin_addr.s_addr));
 
     int sck = socket(AF_INET, SOCK_STREAM, 0);
     if (sck < 0) {
         fprintf(stderr, "Socket creation failed for %s:%d\n", 
                 args->server.ip, args->server.port);
-        *(args->success_flag) = 0;
-        return NULL;
+        return -1;
     }
 
-    // Устанавливаем таймаут на подключение (5 секунд)
+    // Сервер, не ответивший за timeout_sec, считается упавшим
     struct timeval timeout;
-    timeout.tv_sec = 5;
+    timeout.tv_sec = args->schedule->timeout_sec;
     timeout.tv_usec = 0;
     setsockopt(sck, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
     setsockopt(sck, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
@@ -76,51 +195,70 @@ void* ProcessServer(void* thread_args) {
         fprintf(stderr, "Connection failed to %s:%d\n", 
                 args->server.ip, args->server.port);
         close(sck);
-        *(args->success_flag) = 0;
-        return NULL;
+        return -1;
     }
+    return sck;
+}
 
-    // Подготавливаем задачу для сервера
-    char task[sizeof(uint64_t) * 3];
-    memcpy(task, &(args->begin), sizeof(uint64_t));
-    memcpy(task + sizeof(uint64_t), &(args->end), sizeof(uint64_t));
-    memcpy(task + 2 * sizeof(uint64_t), &(args->mod), sizeof(uint64_t));
+static void SetSocket(struct ThreadArgs *args, int sck) {
+    pthread_mutex_lock(&args->sck_mutex);
+    if (sck < 0 && args->sck >= 0)
+        close(args->sck);
+    args->sck = sck;
+    pthread_mutex_unlock(&args->sck_mutex);
+}
 
-    // Отправляем задачу
-    if (send(sck, task, sizeof(task), 0) < 0) {
-        fprintf(stderr, "Send failed to %s:%d\n", 
-                args->server.ip, args->server.port);
-        close(sck);
-        *(args->success_flag) = 0;
-        return NULL;
-    }
+// Функция, выполняемая в потоке: работаем с сервером, пока вся работа
+// не посчитана, переподключаясь после ошибок с растущей задержкой
+void* ProcessServer(void* thread_args) {
+    struct ThreadArgs* args = (struct ThreadArgs*)thread_args;
+    args->success_flag = 0;
 
-    // Получаем ответ
-    char response[sizeof(uint64_t)];
-    if (recv(sck, response, sizeof(response), 0) < 0) {
-        fprintf(stderr, "Receive failed from %s:%d\n", 
-                args->server.ip, args->server.port);
-        close(sck);
-        *(args->success_flag) = 0;
-        return NULL;
-    }
+    int attempt = 0;
+    long backoff_ms = 100;
+    while (!WorkQueueFinished(args->queue)) {
+        uint64_t chunks_before = args->chunks_done;
+        int sck = ConnectServer(args);
+        if (sck >= 0) {
+            SetSocket(args, sck);
+            bool finished = ServeConnection(sck, args);
+            SetSocket(args, -1);
+            // Ожидание могло быть прервано, когда дубликат участка
+            // посчитал другой сервер
+            if (finished || WorkQueueFinished(args->queue))
+                break;
+        }
+        args->failures++;
 
-    // Извлекаем результат
-    uint64_t answer = 0;
-    memcpy(&answer, response, sizeof(uint64_t));
-    *(args->result) = answer;
-    *(args->success_flag) = 1;
+        // Успешные участки с прошлой ошибки сбрасывают задержку
+        if (args->chunks_done > chunks_before) {
+            attempt = 0;
+            backoff_ms = 100;
+        }
+        if (++attempt > args->schedule->retries) {
+            fprintf(stderr, "Giving up on server %s:%d after %d attempts\n",
+                    args->server.ip, args->server.port, attempt);
+            WorkQueueLeave(args->queue);
+            return NULL;
+        }
 
-    printf("Server %s:%d returned: %llu (range %llu..%llu)\n", 
-           args->server.ip, args->server.port, answer, args->begin, args->end);
+        fprintf(stderr, "Server %s:%d failed, retry %d in %ld ms\n",
+                args->server.ip, args->server.port, attempt, backoff_ms);
+        struct timespec delay = {backoff_ms / 1000, (backoff_ms % 1000) * 1000000};
+        nanosleep(&delay, NULL);
+        if (backoff_ms < 5000)
+            backoff_ms *= 2;
+    }
 
-    close(sck);
+    args->success_flag = 1;
+    WorkQueueLeave(args->queue);
     return NULL;
 }
 
 int main(int argc, char **argv) {
     uint64_t k = -1;
     uint64_t mod = -1;
+    struct ScheduleOptions schedule = {1024, 100, 2, false, 5, 5};
     char servers_file_path[255] = {'\0'};
 
     // Обработка аргументов командной строки
@@ -131,6 +269,12 @@ int main(int argc, char **argv) {
             {"k", required_argument, 0, 0},
             {"mod", required_argument, 0, 0},
             {"servers", required_argument, 0, 0},
+            {"min_chunk", required_argument, 0, 0},
+            {"chunk_ms", required_argument, 0, 0},
+            {"window", required_argument, 0, 0},
+            {"speculate", no_argument, 0, 0},
+            {"timeout", required_argument, 0, 0},
+            {"retries", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -159,6 +303,44 @@ int main(int argc, char **argv) {
                 strncpy(servers_file_path, optarg, sizeof(servers_file_path) - 1);
                 servers_file_path[sizeof(servers_file_path) - 1] = '\0';
                 break;
+            case 3:
+                if (!ConvertStringToUI64(optarg, &schedule.min_chunk) ||
+                    schedule.min_chunk == 0) {
+                    fprintf(stderr, "Invalid min_chunk value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 4:
+                if (!ConvertStringToUI64(optarg, &schedule.chunk_ms) ||
+                    schedule.chunk_ms == 0) {
+                    fprintf(stderr, "Invalid chunk_ms value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 5:
+                schedule.window = atoi(optarg);
+                if (schedule.window <= 0 || schedule.window > PROTOCOL_MAX_ITEMS) {
+                    fprintf(stderr, "Invalid window value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 6:
+                schedule.speculate = true;
+                break;
+            case 7:
+                schedule.timeout_sec = atoi(optarg);
+                if (schedule.timeout_sec <= 0) {
+                    fprintf(stderr, "Invalid timeout value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 8:
+                schedule.retries = atoi(optarg);
+                if (schedule.retries < 0) {
+                    fprintf(stderr, "Invalid retries value: %s\n", optarg);
+                    return 1;
+                }
+                break;
             default:
                 printf("Index %d is out of options\n", option_index);
             }
@@ -174,13 +356,21 @@ int main(int argc, char **argv) {
 
     // Проверяем, что все обязательные аргументы установлены
     if (k == -1 || mod == -1 || !strlen(servers_file_path)) {
-        fprintf(stderr, "Usage: %s --k <number> --mod <modulus> --servers <file>\n",
-                argv[0]);
+        fprintf(stderr, "Usage: %s --k <number> --mod <modulus> --servers <file> "
+                "[--min_chunk <numbers>] [--chunk_ms <ms>] [--window <parts>] "
+                "[--speculate] [--timeout <sec>] [--retries <n>]\n", argv[0]);
         fprintf(stderr, "Example: %s --k 1000 --mod 1000000007 --servers servers.txt\n",
                 argv[0]);
         return 1;
     }
 
+    // Контекст для объединения частичных произведений
+    struct ModContext ctx;
+    if (!ModContextInit(&ctx, mod)) {
+        fprintf(stderr, "Modulus must be positive\n");
+        return 1;
+    }
+
     // Выводим информацию о вычислении
     printf("Computing %llu! mod %llu\n", k, mod);
 
@@ -262,82 +452,87 @@ int main(int argc, char **argv) {
         }
     }
     
-    // Распределяем работу между серверами
-    uint64_t range_size = k / servers_num;
-    uint64_t remainder = k % servers_num;
-    
-    // Подготавливаем данные для потоков
+    // Серверы забирают участки из общей очереди по мере готовности
+    struct WorkQueue queue;
+    if (!WorkQueueInit(&queue, 1, k, &ctx, servers_num)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(servers);
+        return 1;
+    }
+
     pthread_t threads[servers_num];
     struct ThreadArgs thread_args[servers_num];
-    uint64_t results[servers_num];
-    int success_flags[servers_num];
+    bool started[servers_num];
     
-    // Инициализируем флаги
-    for (int i = 0; i < servers_num; i++) {
-        success_flags[i] = 0;
-        results[i] = 1;  // Нейтральный элемент для умножения
-    }
-    
-    uint64_t current = 1;
-    printf("\nDistributing work:\n");
+    printf("\nDistributing work dynamically (first part %llu numbers, "
+           "target %llu ms per part)\n",
+           (unsigned long long)schedule.min_chunk,
+           (unsigned long long)schedule.chunk_ms);
     for (int i = 0; i < servers_num; i++) {
+        memset(&thread_args[i], 0, sizeof(thread_args[i]));
         thread_args[i].server = servers[i];
-        thread_args[i].begin = current;
-        thread_args[i].end = current + range_size - 1;
-        
-        // Распределяем остаток
-        if (remainder > 0) {
-            thread_args[i].end++;
-            remainder--;
-        }
-        
+        thread_args[i].queue = &queue;
         thread_args[i].mod = mod;
-        thread_args[i].result = &results[i];
-        thread_args[i].success_flag = &success_flags[i];
-        
-        printf("Server %d (%s:%d): %llu..%llu\n", 
-               i, servers[i].ip, servers[i].port, 
-               thread_args[i].begin, thread_args[i].end);
+        thread_args[i].schedule = &schedule;
+        thread_args[i].sck = -1;
+        pthread_mutex_init(&thread_args[i].sck_mutex, NULL);
         
         // Создаём поток
-        if (pthread_create(&threads[i], NULL, ProcessServer, &thread_args[i])) {
+        started[i] = pthread_create(&threads[i], NULL, ProcessServer,
+                                    &thread_args[i]) == 0;
+        if (!started[i]) {
             fprintf(stderr, "Error creating thread for server %s:%d\n", 
                     servers[i].ip, servers[i].port);
-            success_flags[i] = 0;
+            WorkQueueLeave(&queue);
         }
-        
-        current = thread_args[i].end + 1;
     }
     
     // Ждём завершения всех потоков
     printf("\nWaiting for results...\n");
+    WorkQueueWait(&queue);
+
+    // Соединения, всё ещё ждущие уже посчитанные участки, больше не нужны
     for (int i = 0; i < servers_num; i++) {
-        pthread_join(threads[i], NULL);
+        pthread_mutex_lock(&thread_args[i].sck_mutex);
+        if (thread_args[i].sck >= 0)
+            shutdown(thread_args[i].sck, SHUT_RDWR);
+        pthread_mutex_unlock(&thread_args[i].sck_mutex);
     }
-    
-    // Объединяем результаты
-    uint64_t total = 1;
+
     int failed_servers = 0;
     for (int i = 0; i < servers_num; i++) {
-        if (success_flags[i]) {
-            total = MultModulo(total, results[i], mod);
-        } else {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        pthread_mutex_destroy(&thread_args[i].sck_mutex);
+
+        printf("Server %d (%s:%d): %llu parts, %llu numbers, %.0f numbers/s, "
+               "%d failures\n",
+               i, servers[i].ip, servers[i].port,
+               (unsigned long long)thread_args[i].chunks_done,
+               (unsigned long long)thread_args[i].numbers_done,
+               thread_args[i].rate, thread_args[i].failures);
+        if (!thread_args[i].success_flag) {
             fprintf(stderr, "Warning: Server %s:%d failed or timed out\n", 
                     servers[i].ip, servers[i].port);
             failed_servers++;
         }
     }
+
+    uint64_t total = queue.product;
+    uint64_t covered = queue.covered;
+    WorkQueueDestroy(&queue);
     
-    // Проверяем, все ли серверы ответили
+    // Результат выводим, только если посчитаны все числа
     if (failed_servers > 0) {
         fprintf(stderr, "\nWarning: %d out of %d servers failed\n", 
                 failed_servers, servers_num);
-        if (failed_servers == servers_num) {
-            fprintf(stderr, "Error: All servers failed!\n");
-            free(servers);
-            return 1;
-        }
-        printf("Computing with available results...\n");
+    }
+    if (covered < k) {
+        fprintf(stderr, "Error: %llu of %llu numbers were not computed, "
+                "no result\n", (unsigned long long)(k - covered),
+                (unsigned long long)k);
+        free(servers);
+        return 1;
     }
     
     printf("\n================================\n");
@@ -3,19 +3,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-// Умножение по модулю (быстрый алгоритм)
+// Умножение по модулю через 128-битное промежуточное произведение.
+// Для серий умножений по одному модулю используйте ModContext.
 uint64_t MultModulo(uint64_t a, uint64_t b, uint64_t mod) {
-    uint64_t result = 0;
-    a = a % mod;
-    
-    while (b > 0) {
-        if (b % 2 == 1)
-            result = (result + a) % mod;
-        a = (a * 2) % mod;
-        b /= 2;
-    }
-    
-    return result % mod;
+    return (uint64_t)((unsigned __int128)a * b % mod);
 }
 
 // Конвертация строки в uint64_t
@@ -4,11 +4,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "mod_arith.h"
+
 // Общая структура для вычислений факториала
 struct FactorialArgs {
     uint64_t begin;
     uint64_t end;
     uint64_t mod;
+    const struct ModContext *ctx;  // предвычисленный контекст для mod
 };
 
 // Общая структура для сервера
@@ -0,0 +1,470 @@
+#include "factorial.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned __int128 u128;
+
+// Во сколько прямых умножений обходится одна единица sqrt(n) в SQRT
+#define SQRT_COST_FACTOR 1024
+
+// Простые вида c * 2^NTT_MAX_LOG + 1 для свёртки через NTT
+#define NTT_MAX_LOG 32
+#define NTT_PRIMES_NUM 3
+
+struct NttPrime {
+    struct ModContext ctx;
+    uint64_t root;  // первообразный корень
+};
+
+static struct NttPrime ntt_primes[NTT_PRIMES_NUM];
+static pthread_once_t ntt_primes_once = PTHREAD_ONCE_INIT;
+
+const char *FactorialEngineName(enum FactorialEngine engine) {
+    switch (engine) {
+        case FACTORIAL_ENGINE_LINEAR:
+            return "linear";
+        case FACTORIAL_ENGINE_ZERO:
+            return "zero";
+        case FACTORIAL_ENGINE_WILSON:
+            return "wilson";
+        case FACTORIAL_ENGINE_SQRT:
+            return "sqrt";
+    }
+    return "unknown";
+}
+
+static uint64_t ISqrt(uint64_t n) {
+    uint64_t r = (uint64_t)sqrt((double)n);
+    while (r > 0 && r * r > n)
+        r--;
+    while ((r + 1) * (r + 1) <= n)
+        r++;
+    return r;
+}
+
+// Стоимость n! mod p через SQRT с учётом отражения n -> p - 1 - n
+static uint64_t SqrtCost(uint64_t n, uint64_t p) {
+    uint64_t m = n < p - 1 - n ? n : p - 1 - n;
+    return SQRT_COST_FACTOR * ISqrt(m);
+}
+
+// Содержит ли [begin, end] число, кратное mod
+static bool RangeHitsMultiple(uint64_t begin, uint64_t end, uint64_t mod) {
+    return begin == 0 || end / mod != (begin - 1) / mod;
+}
+
+enum FactorialEngine FactorialSelectEngine(const struct FactorialArgs *args) {
+    uint64_t p = args->mod;
+
+    if (p == 1 || RangeHitsMultiple(args->begin, args->end, p))
+        return FACTORIAL_ENGINE_ZERO;
+
+    uint64_t length = args->end - args->begin + 1;
+    if (length < FACTORIAL_FAST_THRESHOLD || !ModIsPrime(p))
+        return FACTORIAL_ENGINE_LINEAR;
+
+    // Кратных p в диапазоне нет, значит он лежит внутри одного блока
+    // [q * p + 1, q * p + p - 1] и по модулю совпадает с [r1, r2]
+    uint64_t r1 = args->begin % p;
+    uint64_t r2 = args->end % p;
+
+    // По теореме Вильсона [1, r1 - 1] * [r1, r2] * [r2 + 1, p - 1] = -1
+    uint64_t wilson_cost = (r1 - 1) + (p - 1 - r2);
+    uint64_t sqrt_cost = SqrtCost(r2, p) + SqrtCost(r1 - 1, p);
+
+    if (length <= wilson_cost && length <= sqrt_cost)
+        return FACTORIAL_ENGINE_LINEAR;
+    if (wilson_cost <= sqrt_cost)
+        return FACTORIAL_ENGINE_WILSON;
+    return FACTORIAL_ENGINE_SQRT;
+}
+
+// ---------- Свёртка по произвольному 64-битному модулю ----------
+
+static void FindNttPrimes(void) {
+    int found = 0;
+    for (uint64_t c = (1ULL << (62 - NTT_MAX_LOG)) - 1; found < NTT_PRIMES_NUM; c--) {
+        uint64_t q = (c << NTT_MAX_LOG) + 1;
+        if (!ModIsPrime(q))
+            continue;
+
+        // Простые делители q - 1 = c * 2^NTT_MAX_LOG
+        uint64_t factors[64];
+        int factors_num = 0;
+        factors[factors_num++] = 2;
+        uint64_t rest = c;
+        for (uint64_t f = 2; f * f <= rest; f++) {
+            if (rest % f == 0) {
+                if (f != 2)
+                    factors[factors_num++] = f;
+                while (rest % f == 0)
+                    rest /= f;
+            }
+        }
+        if (rest > 2)
+            factors[factors_num++] = rest;
+
+        struct NttPrime *np = &ntt_primes[found];
+        ModContextInit(&np->ctx, q);
+
+        for (uint64_t g = 3;; g++) {
+            bool primitive = true;
+            for (int i = 0; i < factors_num && primitive; i++)
+                primitive = ModPow(&np->ctx, g, (q - 1) / factors[i]) != 1;
+            if (primitive) {
+                np->root = g;
+                break;
+            }
+        }
+        found++;
+    }
+}
+
+// Преобразование на месте, значения в форме Монтгомери
+static void Ntt(const struct NttPrime *np, uint64_t *a, size_t n,
+                uint64_t *roots, bool invert) {
+    const struct ModContext *ctx = &np->ctx;
+    uint64_t q = ctx->mod;
+
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            uint64_t tmp = a[i];
+            a[i] = a[j];
+            a[j] = tmp;
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        uint64_t w = ModPow(ctx, np->root, (q - 1) / len);
+        if (invert)
+            w = ModInversePrime(ctx, w);
+
+        size_t half = len / 2;
+        uint64_t w_m = ModToMontgomery(ctx, w);
+        roots[0] = ModToMontgomery(ctx, 1);
+        for (size_t j = 1; j < half; j++)
+            roots[j] = ModMontgomeryReduce(ctx, (u128)roots[j - 1] * w_m);
+
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t j = 0; j < half; j++) {
+                uint64_t u = a[i + j];
+                uint64_t v = ModMontgomeryReduce(ctx, (u128)a[i + j + half] * roots[j]);
+                uint64_t sum = u + v;
+                a[i + j] = sum >= q ? sum - q : sum;
+                a[i + j + half] = u >= v ? u - v : u + q - v;
+            }
+        }
+    }
+
+    if (invert) {
+        uint64_t n_inv = ModToMontgomery(ctx, ModInversePrime(ctx, n % q));
+        for (size_t i = 0; i < n; i++)
+            a[i] = ModMontgomeryReduce(ctx, (u128)a[i] * n_inv);
+    }
+}
+
+static void NttLoad(const struct NttPrime *np, uint64_t *dst, const uint64_t *src,
+                    size_t count, size_t n) {
+    for (size_t i = 0; i < count; i++)
+        dst[i] = ModToMontgomery(&np->ctx, src[i]);
+    memset(dst + count, 0, (n - count) * sizeof(uint64_t));
+}
+
+// Восстановление значения по трём остаткам (алгоритм Гарнера) и его
+// приведение по модулю ctx->mod. Точное значение меньше m1 * m2 * m3.
+struct GarnerConstants {
+    uint64_t m1_inv_m2;     // m1^-1 mod m2
+    uint64_t m12_inv_m3;    // (m1 * m2)^-1 mod m3
+    uint64_t m1_mod_m3;
+    uint64_t m1_mod_p;
+    uint64_t m12_mod_p;
+};
+
+static void GarnerInit(const struct ModContext *ctx, struct GarnerConstants *gc) {
+    const struct ModContext *c2 = &ntt_primes[1].ctx;
+    const struct ModContext *c3 = &ntt_primes[2].ctx;
+    uint64_t m1 = ntt_primes[0].ctx.mod, m2 = c2->mod;
+
+    gc->m1_inv_m2 = ModInversePrime(c2, m1 % m2);
+    gc->m1_mod_m3 = m1 % c3->mod;
+    gc->m12_inv_m3 = ModInversePrime(c3, ModMul(c3, gc->m1_mod_m3, m2 % c3->mod));
+    gc->m1_mod_p = m1 % ctx->mod;
+    gc->m12_mod_p = ModMul(ctx, gc->m1_mod_p, m2);
+}
+
+static uint64_t Garner(const struct ModContext *ctx, const struct GarnerConstants *gc,
+                       uint64_t r1, uint64_t r2, uint64_t r3) {
+    const struct ModContext *c2 = &ntt_primes[1].ctx;
+    const struct ModContext *c3 = &ntt_primes[2].ctx;
+    uint64_t m2 = c2->mod, m3 = c3->mod;
+
+    uint64_t r1_m2 = r1 % m2;
+    uint64_t t2 = ModMul(c2, r2 >= r1_m2 ? r2 - r1_m2 : r2 + m2 - r1_m2, gc->m1_inv_m2);
+
+    // r1 + m1 * t2 по модулю m3
+    uint64_t x12 = (r1 % m3 + ModMul(c3, gc->m1_mod_m3, t2 % m3)) % m3;
+    uint64_t t3 = ModMul(c3, r3 >= x12 ? r3 - x12 : r3 + m3 - x12, gc->m12_inv_m3);
+
+    uint64_t res = r1 % ctx->mod;
+    res = (uint64_t)(((u128)res + ModMul(ctx, gc->m1_mod_p, t2)) % ctx->mod);
+    res = (uint64_t)(((u128)res + ModMul(ctx, gc->m12_mod_p, t3)) % ctx->mod);
+    return res;
+}
+
+// ---------- n! mod p за O(sqrt(n) log n) ----------
+//
+// Пусть v = floor(sqrt(n)) и g_d(x) = (v x + 1)(v x + 2)...(v x + d).
+// Тогда n! = g_v(0) g_v(1) ... g_v(v - 1) * (v^2 + 1) ... n.
+// Храним значения g_d в точках 0..d и удваиваем d, используя
+// g_2d(x) = g_d(x) g_d(x + d / v). Значения многочлена в сдвинутых
+// точках получаются из интерполяции Лагранжа одной свёрткой.
+
+struct SqrtState {
+    const struct ModContext *ctx;
+    struct GarnerConstants gc;
+    uint64_t *fact;      // i!, i = 0..v + 1
+    uint64_t *inv_fact;  // (i!)^-1
+    uint64_t *roots;     // таблица корней для Ntt
+    uint64_t *f_ntt[NTT_PRIMES_NUM];
+    uint64_t *g_ntt[NTT_PRIMES_NUM];
+    uint64_t *w;         // узлы m - d + t и обратные к ним
+    uint64_t *w_inv;
+    uint64_t *conv;
+};
+
+// По значениям h(0..d) многочлена степени d вычисляет h(m + k), k = 0..d,
+// для каждого из shifts_num сдвигов. Требуется m + j != 0 mod p при |j| <= d.
+static void ShiftPoints(struct SqrtState *st, const uint64_t *h, uint64_t d,
+                        const uint64_t *shifts, uint64_t **outs, int shifts_num) {
+    const struct ModContext *ctx = st->ctx;
+    uint64_t p = ctx->mod;
+
+    size_t n = 1;
+    while (n < 2 * d + 2)
+        n <<= 1;
+
+    // f_i = h(i) / (i! (d - i)! (-1)^(d - i))
+    for (uint64_t i = 0; i <= d; i++) {
+        uint64_t f = ModMul(ctx, h[i], ModMul(ctx, st->inv_fact[i], st->inv_fact[d - i]));
+        st->conv[i] = ((d - i) & 1) && f ? p - f : f;
+    }
+    for (int k = 0; k < NTT_PRIMES_NUM; k++) {
+        NttLoad(&ntt_primes[k], st->f_ntt[k], st->conv, d + 1, n);
+        Ntt(&ntt_primes[k], st->f_ntt[k], n, st->roots, false);
+    }
+
+    for (int s = 0; s < shifts_num; s++) {
+        uint64_t m = shifts[s];
+
+        // w_t = m - d + t, t = 0..2d, и обратные к ним одной инверсией
+        uint64_t base = m >= d ? m - d : m + (p - d);
+        uint64_t prefix = 1;
+        for (uint64_t t = 0; t <= 2 * d; t++) {
+            st->w[t] = (uint64_t)(((u128)base + t) % p);
+            st->w_inv[t] = prefix;
+            prefix = ModMul(ctx, prefix, st->w[t]);
+        }
+        uint64_t inv = ModInversePrime(ctx, prefix);
+        for (uint64_t t = 2 * d + 1; t-- > 0;) {
+            st->w_inv[t] = ModMul(ctx, st->w_inv[t], inv);
+            inv = ModMul(ctx, inv, st->w[t]);
+        }
+
+        for (int k = 0; k < NTT_PRIMES_NUM; k++) {
+            const struct NttPrime *np = &ntt_primes[k];
+            NttLoad(np, st->g_ntt[k], st->w_inv, 2 * d + 1, n);
+            Ntt(np, st->g_ntt[k], n, st->roots, false);
+            for (size_t i = 0; i < n; i++)
+                st->g_ntt[k][i] = ModMontgomeryReduce(&np->ctx,
+                    (u128)st->g_ntt[k][i] * st->f_ntt[k][i]);
+            Ntt(np, st->g_ntt[k], n, st->roots, true);
+            for (size_t i = d; i <= 2 * d; i++)
+                st->g_ntt[k][i] = ModFromMontgomery(&np->ctx, st->g_ntt[k][i]);
+        }
+
+        // h(m + k) = (m + k)(m + k - 1)...(m + k - d) * sum_i f_i / (m + k - i)
+        uint64_t prod = 1;
+        for (uint64_t t = 0; t <= d; t++)
+            prod = ModMul(ctx, prod, st->w[t]);
+        for (uint64_t k = 0; k <= d; k++) {
+            uint64_t sum = Garner(ctx, &st->gc, st->g_ntt[0][k + d],
+                                  st->g_ntt[1][k + d], st->g_ntt[2][k + d]);
+            outs[s][k] = ModMul(ctx, prod, sum);
+            if (k < d)
+                prod = ModMul(ctx, ModMul(ctx, prod, st->w[k + d + 1]), st->w_inv[k]);
+        }
+    }
+}
+
+static void SqrtStateFree(struct SqrtState *st) {
+    free(st->fact);
+    free(st->inv_fact);
+    free(st->roots);
+    for (int k = 0; k < NTT_PRIMES_NUM; k++) {
+        free(st->f_ntt[k]);
+        free(st->g_ntt[k]);
+    }
+    free(st->w);
+    free(st->w_inv);
+    free(st->conv);
+}
+
+// n! mod p для простого p и n < p
+static bool FactorialSqrt(const struct ModContext *ctx, uint64_t n, uint64_t *result) {
+    uint64_t p = ctx->mod;
+
+    if (n < FACTORIAL_FAST_THRESHOLD) {
+        *result = ModRangeProduct(ctx, 1, n);
+        return true;
+    }
+
+    pthread_once(&ntt_primes_once, FindNttPrimes);
+
+    uint64_t v = ISqrt(n);
+    size_t n_max = 1;
+    while (n_max < v + 2)
+        n_max <<= 1;
+    n_max *= 2;
+
+    struct SqrtState st;
+    memset(&st, 0, sizeof(st));
+    st.ctx = ctx;
+    GarnerInit(ctx, &st.gc);
+
+    bool ok = true;
+    st.fact = malloc(sizeof(uint64_t) * (v + 2));
+    st.inv_fact = malloc(sizeof(uint64_t) * (v + 2));
+    st.roots = malloc(sizeof(uint64_t) * n_max);
+    st.w = malloc(sizeof(uint64_t) * (2 * v + 2));
+    st.w_inv = malloc(sizeof(uint64_t) * (2 * v + 2));
+    st.conv = malloc(sizeof(uint64_t) * (v + 2));
+    ok = st.fact && st.inv_fact && st.roots && st.w && st.w_inv && st.conv;
+    for (int k = 0; k < NTT_PRIMES_NUM && ok; k++) {
+        st.f_ntt[k] = malloc(sizeof(uint64_t) * n_max);
+        st.g_ntt[k] = malloc(sizeof(uint64_t) * n_max);
+        ok = st.f_ntt[k] && st.g_ntt[k];
+    }
+
+    // Значения g_d в точках 0..2d + 1 и g_d(d / v + 0..2d + 1)
+    uint64_t *h = malloc(sizeof(uint64_t) * (2 * v + 4));
+    uint64_t *a = malloc(sizeof(uint64_t) * (2 * v + 4));
+    ok = ok && h && a;
+
+    if (!ok) {
+        free(h);
+        free(a);
+        SqrtStateFree(&st);
+        return false;
+    }
+
+    st.fact[0] = 1;
+    for (uint64_t i = 1; i <= v + 1; i++)
+        st.fact[i] = ModMul(ctx, st.fact[i - 1], i);
+    st.inv_fact[v + 1] = ModInversePrime(ctx, st.fact[v + 1]);
+    for (uint64_t i = v + 1; i > 0; i--)
+        st.inv_fact[i - 1] = ModMul(ctx, st.inv_fact[i], i);
+
+    uint64_t v_inv = ModInversePrime(ctx, v);
+
+    // g_1(x) = v x + 1
+    uint64_t d = 1;
+    h[0] = 1;
+    h[1] = (v + 1) % p;
+
+    int top_bit = 63 - __builtin_clzll(v);
+    for (int bit = top_bit - 1; bit >= 0; bit--) {
+        // Удвоение d -> 2d
+        uint64_t shift_a = ModMul(ctx, d, v_inv);
+        uint64_t shifts[3] = {d + 1, shift_a, (uint64_t)(((u128)shift_a + d + 1) % p)};
+        uint64_t *outs[3] = {h + d + 1, a, a + d + 1};
+        ShiftPoints(&st, h, d, shifts, outs, 3);
+
+        for (uint64_t i = 0; i <= 2 * d; i++)
+            h[i] = ModMul(ctx, h[i], a[i]);
+        d *= 2;
+
+        // Добавление множителя d -> d + 1
+        if ((v >> bit) & 1) {
+            for (uint64_t i = 0; i <= d; i++)
+                h[i] = ModMul(ctx, h[i], (uint64_t)(((u128)v * i + d + 1) % p));
+            uint64_t first = (uint64_t)(((u128)v * (d + 1) + 1) % p);
+            h[d + 1] = ModRangeProduct(ctx, first, first + d);
+            d++;
+        }
+    }
+
+    uint64_t ans = 1;
+    for (uint64_t i = 0; i < v; i++)
+        ans = ModMul(ctx, ans, h[i]);
+    ans = ModMul(ctx, ans, ModRangeProduct(ctx, v * v + 1, n));
+
+    free(h);
+    free(a);
+    SqrtStateFree(&st);
+
+    *result = ans;
+    return true;
+}
+
+// n! mod p для простого p и n < p с отражением по теореме Вильсона:
+// n! * (-1)^(p - 1 - n) * (p - 1 - n)! = -1
+static bool FactorialReflected(const struct ModContext *ctx, uint64_t n,
+                               uint64_t *result) {
+    uint64_t p = ctx->mod;
+    uint64_t m = p - 1 - n;
+
+    if (n <= m)
+        return FactorialSqrt(ctx, n, result);
+
+    uint64_t fm;
+    if (!FactorialSqrt(ctx, m, &fm))
+        return false;
+
+    // n! = -1 / ((-1)^m * m!) = (-1)^(m + 1) / m!
+    uint64_t inv = ModInversePrime(ctx, fm);
+    *result = (m & 1) ? inv : (inv ? p - inv : 0);
+    return true;
+}
+
+bool FactorialFast(const struct FactorialArgs *args,
+                   enum FactorialEngine engine, uint64_t *result) {
+    const struct ModContext *ctx = args->ctx;
+    uint64_t p = args->mod;
+
+    if (engine == FACTORIAL_ENGINE_ZERO) {
+        *result = 0;
+        return true;
+    }
+
+    uint64_t r1 = args->begin % p;
+    uint64_t r2 = args->end % p;
+
+    if (engine == FACTORIAL_ENGINE_WILSON) {
+        // [r1, r2] = -1 / ([1, r1 - 1] * (-1)^(p - 1 - r2) * [1, p - 1 - r2])
+        uint64_t tail = p - 1 - r2;
+        uint64_t rest = ModMul(ctx, ModRangeProduct(ctx, 1, r1 - 1),
+                               ModRangeProduct(ctx, 1, tail));
+        uint64_t inv = ModInversePrime(ctx, rest);
+        *result = (tail & 1) ? inv : (inv ? p - inv : 0);
+        return true;
+    }
+
+    if (engine == FACTORIAL_ENGINE_SQRT) {
+        uint64_t f_end, f_begin;
+        if (!FactorialReflected(ctx, r2, &f_end) ||
+            !FactorialReflected(ctx, r1 - 1, &f_begin))
+            return false;
+        *result = ModMul(ctx, f_end, ModInversePrime(ctx, f_begin));
+        return true;
+    }
+
+    *result = ModRangeProduct(ctx, args->begin, args->end);
+    return true;
+}
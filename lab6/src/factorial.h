@@ -0,0 +1,31 @@
+#ifndef FACTORIAL_H
+#define FACTORIAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Способ вычисления произведения [begin, end] по модулю
+enum FactorialEngine {
+    FACTORIAL_ENGINE_LINEAR,  // прямое произведение, делится между потоками
+    FACTORIAL_ENGINE_ZERO,    // диапазон содержит число, кратное mod
+    FACTORIAL_ENGINE_WILSON,  // простой mod: через дополнение до (p-1)! = -1
+    FACTORIAL_ENGINE_SQRT     // простой mod: O(sqrt(p) log p) сдвигом точек
+};
+
+// Диапазоны короче этого порога всегда считаются напрямую
+#define FACTORIAL_FAST_THRESHOLD (1u << 16)
+
+// Название способа для журнала сервера
+const char *FactorialEngineName(enum FactorialEngine engine);
+
+// Выбор самого дешёвого способа для запроса (begin <= end)
+enum FactorialEngine FactorialSelectEngine(const struct FactorialArgs *args);
+
+// Вычисление способами ZERO, WILSON и SQRT.
+// false, если не хватило памяти: тогда нужно считать напрямую.
+bool FactorialFast(const struct FactorialArgs *args,
+                   enum FactorialEngine engine, uint64_t *result);
+
+#endif // FACTORIAL_H
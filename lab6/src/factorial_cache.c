@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+
+#include "factorial_cache.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "FCTC"
+#define CACHE_VERSION 1
+#define CACHE_PROBES 16
+#define BLOCK_SIZE ((uint64_t)1 << FACTORIAL_CACHE_BLOCK_SHIFT)
+
+struct FactorialCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t entries_num;
+    uint64_t block_shift;
+    uint64_t reserved;
+};
+
+// Запись, оборванная при падении сервера, не пройдёт проверку
+static uint64_t EntryCheck(uint64_t mod, uint64_t block, uint64_t value) {
+    uint64_t h = mod * 0x9E3779B97F4A7C15ULL ^ block * 0xC2B2AE3D27D4EB4FULL ^ value;
+    h ^= h >> 29;
+    return h | 1;
+}
+
+static size_t EntryHash(uint64_t mod, uint64_t block) {
+    uint64_t h = mod * 0xFF51AFD7ED558CCDULL + block * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h ^ (h >> 32));
+}
+
+static bool HeaderValid(const struct FactorialCacheHeader *header, size_t entries_num) {
+    return memcmp(header->magic, CACHE_MAGIC, 4) == 0 &&
+           header->version == CACHE_VERSION &&
+           header->entries_num == entries_num &&
+           header->block_shift == FACTORIAL_CACHE_BLOCK_SHIFT;
+}
+
+bool FactorialCacheOpen(struct FactorialCache *cache, const char *path,
+                        size_t entries_num) {
+    size_t size = 1;
+    while (size < entries_num)
+        size <<= 1;
+
+    cache->entries_num = size;
+    cache->map_size = sizeof(struct FactorialCacheHeader) +
+                      size * sizeof(struct FactorialCacheEntry);
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+
+    void *map;
+    if (path) {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            perror("open cache file");
+            return false;
+        }
+
+        struct stat st;
+        bool fresh = fstat(fd, &st) < 0 || (size_t)st.st_size != cache->map_size;
+        if (fresh && (ftruncate(fd, 0) < 0 || ftruncate(fd, cache->map_size) < 0)) {
+            perror("resize cache file");
+            close(fd);
+            return false;
+        }
+
+        map = mmap(NULL, cache->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        map = mmap(NULL, cache->map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (map == MAP_FAILED) {
+        perror("mmap cache");
+        return false;
+    }
+
+    cache->header = map;
+    cache->entries = (struct FactorialCacheEntry *)(cache->header + 1);
+    if (!HeaderValid(cache->header, size)) {
+        memset(map, 0, cache->map_size);
+        memcpy(cache->header->magic, CACHE_MAGIC, 4);
+        cache->header->version = CACHE_VERSION;
+        cache->header->entries_num = size;
+        cache->header->block_shift = FACTORIAL_CACHE_BLOCK_SHIFT;
+    }
+
+    pthread_mutex_init(&cache->mutex, NULL);
+    return true;
+}
+
+void FactorialCacheClose(struct FactorialCache *cache) {
+    msync(cache->header, cache->map_size, MS_SYNC);
+    munmap(cache->header, cache->map_size);
+    pthread_mutex_destroy(&cache->mutex);
+}
+
+static bool CacheLookup(struct FactorialCache *cache, uint64_t mod, uint64_t block,
+                        uint64_t *value) {
+    size_t mask = cache->entries_num - 1;
+    size_t pos = EntryHash(mod, block) & mask;
+    bool found = false;
+
+    pthread_mutex_lock(&cache->mutex);
+    for (int i = 0; i < CACHE_PROBES; i++) {
+        const struct FactorialCacheEntry *entry = &cache->entries[(pos + i) & mask];
+        if (entry->check == 0)
+            break;
+        if (entry->mod == mod && entry->block == block &&
+            entry->check == EntryCheck(mod, block, entry->value)) {
+            *value = entry->value;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return found;
+}
+
+static void CacheStore(struct FactorialCache *cache, uint64_t mod, uint64_t block,
+                       uint64_t value) {
+    size_t mask = cache->entries_num - 1;
+    size_t pos = EntryHash(mod, block) & mask;
+
+    pthread_mutex_lock(&cache->mutex);
+    // Свободная запись или та же самая; если цепочка занята - вытесняем первую
+    struct FactorialCacheEntry *target = &cache->entries[pos];
+    for (int i = 0; i < CACHE_PROBES; i++) {
+        struct FactorialCacheEntry *entry = &cache->entries[(pos + i) & mask];
+        if (entry->check == 0 || (entry->mod == mod && entry->block == block)) {
+            target = entry;
+            break;
+        }
+    }
+    target->check = 0;
+    target->mod = mod;
+    target->block = block;
+    target->value = value;
+    target->check = EntryCheck(mod, block, value);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+uint64_t FactorialCacheRangeProduct(struct FactorialCache *cache,
+                                    const struct ModContext *ctx,
+                                    uint64_t begin, uint64_t end) {
+    uint64_t result = 1 % ctx->mod;
+    uint64_t i = begin;
+
+    while (i <= end) {
+        uint64_t block = i >> FACTORIAL_CACHE_BLOCK_SHIFT;
+        uint64_t block_begin = block << FACTORIAL_CACHE_BLOCK_SHIFT;
+        uint64_t block_end = block_begin + (BLOCK_SIZE - 1);
+        uint64_t part_end = block_end < end ? block_end : end;
+
+        uint64_t value;
+        if (i == block_begin && part_end == block_end) {
+            if (CacheLookup(cache, ctx->mod, block, &value)) {
+                atomic_fetch_add(&cache->hits, 1);
+            } else {
+                atomic_fetch_add(&cache->misses, 1);
+                value = ModRangeProduct(ctx, block_begin, block_end);
+                CacheStore(cache, ctx->mod, block, value);
+            }
+        } else {
+            value = ModRangeProduct(ctx, i, part_end);
+        }
+        result = ModMul(ctx, result, value);
+
+        if (part_end == end)
+            break;
+        i = part_end + 1;
+    }
+
+    return result;
+}
+
+void FactorialCacheStats(struct FactorialCache *cache, uint64_t *hits,
+                         uint64_t *misses) {
+    *hits = atomic_load(&cache->hits);
+    *misses = atomic_load(&cache->misses);
+}
@@ -0,0 +1,56 @@
+#ifndef FACTORIAL_CACHE_H
+#define FACTORIAL_CACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mod_arith.h"
+
+// Кэш произведений блоков [j * 2^20, (j + 1) * 2^20 - 1] по модулю.
+//
+// Запрос [begin, end] перемножает готовые блоки из кэша и считает
+// напрямую только неполные блоки по краям. Записи хранятся в открытой
+// хэш-таблице с ключом (mod, j); если задан файл, таблица отображается
+// в него через mmap и переживает перезапуск сервера.
+
+#define FACTORIAL_CACHE_BLOCK_SHIFT 20
+#define FACTORIAL_CACHE_DEFAULT_ENTRIES (1u << 16)
+
+struct FactorialCacheEntry {
+    uint64_t mod;
+    uint64_t block;
+    uint64_t value;
+    uint64_t check;  // контрольная сумма, 0 - пустая запись
+};
+
+struct FactorialCacheHeader;
+
+struct FactorialCache {
+    pthread_mutex_t mutex;
+    struct FactorialCacheHeader *header;
+    struct FactorialCacheEntry *entries;
+    size_t entries_num;  // степень двойки
+    size_t map_size;
+
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+};
+
+// Открытие кэша на entries_num записей. path == NULL - только в памяти.
+// Существующий файл с другим числом записей создаётся заново.
+bool FactorialCacheOpen(struct FactorialCache *cache, const char *path,
+                        size_t entries_num);
+void FactorialCacheClose(struct FactorialCache *cache);
+
+// Произведение [begin, end] по модулю ctx->mod с использованием кэша
+uint64_t FactorialCacheRangeProduct(struct FactorialCache *cache,
+                                    const struct ModContext *ctx,
+                                    uint64_t begin, uint64_t end);
+
+void FactorialCacheStats(struct FactorialCache *cache, uint64_t *hits,
+                         uint64_t *misses);
+
+#endif // FACTORIAL_CACHE_H
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "log.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_CAPACITY 4096
+#define LOG_LINE_SIZE 256
+
+struct LogLine {
+    enum LogLevel level;
+    char text[LOG_LINE_SIZE];
+};
+
+static struct {
+    bool running;
+    bool stopping;
+    enum LogLevel level;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+
+    struct LogLine lines[LOG_CAPACITY];  // кольцевой буфер
+    size_t head;
+    size_t count;
+
+    // Корзина токенов для INFO и DEBUG
+    uint32_t rate;
+    double tokens;
+    double refilled_at;
+
+    atomic_uint_fast64_t dropped;
+} g_log = {
+    .level = LOG_INFO,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+};
+
+static double NowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static FILE *LevelStream(enum LogLevel level) {
+    return level <= LOG_WARN ? stderr : stdout;
+}
+
+static void *LogThread(void *arg) {
+    (void)arg;
+    static struct LogLine batch[LOG_CAPACITY];
+
+    pthread_mutex_lock(&g_log.mutex);
+    while (true) {
+        while (g_log.count == 0 && !g_log.stopping)
+            pthread_cond_wait(&g_log.not_empty, &g_log.mutex);
+        if (g_log.count == 0)
+            break;
+
+        // Забираем всё накопленное и пишем без блокировки
+        size_t n = 0;
+        while (g_log.count > 0) {
+            batch[n++] = g_log.lines[g_log.head];
+            g_log.head = (g_log.head + 1) % LOG_CAPACITY;
+            g_log.count--;
+        }
+        pthread_mutex_unlock(&g_log.mutex);
+
+        for (size_t i = 0; i < n; i++)
+            fputs(batch[i].text, LevelStream(batch[i].level));
+        fflush(stdout);
+        fflush(stderr);
+
+        pthread_mutex_lock(&g_log.mutex);
+    }
+    pthread_mutex_unlock(&g_log.mutex);
+    return NULL;
+}
+
+bool LogInit(enum LogLevel level, uint32_t rate_per_sec) {
+    pthread_mutex_lock(&g_log.mutex);
+    g_log.level = level;
+    g_log.rate = rate_per_sec;
+    g_log.tokens = rate_per_sec;
+    g_log.refilled_at = NowSeconds();
+    g_log.stopping = false;
+    pthread_mutex_unlock(&g_log.mutex);
+
+    if (pthread_create(&g_log.thread, NULL, LogThread, NULL))
+        return false;
+    g_log.running = true;
+    return true;
+}
+
+void LogShutdown(void) {
+    if (!g_log.running)
+        return;
+
+    pthread_mutex_lock(&g_log.mutex);
+    g_log.stopping = true;
+    pthread_cond_signal(&g_log.not_empty);
+    pthread_mutex_unlock(&g_log.mutex);
+
+    pthread_join(g_log.thread, NULL);
+    g_log.running = false;
+}
+
+bool LogParseLevel(const char *name, enum LogLevel *level) {
+    static const char *names[] = {"error", "warn", "info", "debug"};
+    for (int i = 0; i <= LOG_DEBUG; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *level = (enum LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LogEnabled(enum LogLevel level) {
+    return level <= g_log.level;
+}
+
+// Вызывается под мьютексом
+static bool TakeToken(enum LogLevel level) {
+    if (level <= LOG_WARN || g_log.rate == 0)
+        return true;
+
+    double now = NowSeconds();
+    g_log.tokens += (now - g_log.refilled_at) * g_log.rate;
+    if (g_log.tokens > g_log.rate)
+        g_log.tokens = g_log.rate;
+    g_log.refilled_at = now;
+
+    if (g_log.tokens < 1)
+        return false;
+    g_log.tokens -= 1;
+    return true;
+}
+
+void LogMessage(enum LogLevel level, const char *format, ...) {
+    if (!LogEnabled(level))
+        return;
+
+    char text[LOG_LINE_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (!g_log.running) {
+        fputs(text, LevelStream(level));
+        return;
+    }
+
+    pthread_mutex_lock(&g_log.mutex);
+    if (g_log.count == LOG_CAPACITY || !TakeToken(level)) {
+        pthread_mutex_unlock(&g_log.mutex);
+        atomic_fetch_add_explicit(&g_log.dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    struct LogLine *line = &g_log.lines[(g_log.head + g_log.count) % LOG_CAPACITY];
+    line->level = level;
+    memcpy(line->text, text, sizeof(text));
+    g_log.count++;
+    pthread_cond_signal(&g_log.not_empty);
+    pthread_mutex_unlock(&g_log.mutex);
+}
+
+uint64_t LogDropped(void) {
+    return atomic_load_explicit(&g_log.dropped, memory_order_relaxed);
+}
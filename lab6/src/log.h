@@ -0,0 +1,39 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Асинхронный журнал с уровнями.
+//
+// Сообщения складываются в кольцевой буфер и выводятся отдельным потоком,
+// поэтому вызывающий поток не ждёт записи в stdout. Сообщения INFO и
+// DEBUG ограничены по частоте; сообщения, не поместившиеся в буфер или
+// превысившие лимит, отбрасываются и учитываются в счётчике.
+
+enum LogLevel {
+    LOG_ERROR,  // stderr, не ограничиваются по частоте
+    LOG_WARN,   // stderr
+    LOG_INFO,   // stdout
+    LOG_DEBUG   // stdout
+};
+
+// Запуск потока журнала. rate_per_sec - лимит сообщений INFO и DEBUG в
+// секунду, 0 - без лимита. До вызова сообщения выводятся синхронно.
+bool LogInit(enum LogLevel level, uint32_t rate_per_sec);
+
+// Вывод оставшихся сообщений и остановка потока
+void LogShutdown(void);
+
+// Разбор названия уровня ("error", "warn", "info", "debug")
+bool LogParseLevel(const char *name, enum LogLevel *level);
+
+bool LogEnabled(enum LogLevel level);
+
+void LogMessage(enum LogLevel level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Сколько сообщений отброшено
+uint64_t LogDropped(void);
+
+#endif // LOG_H
@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+
+#include "metrics.h"
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define METRICS_MAX_THREADS 256
+
+// Ячейка одного потока; выравнивание исключает ложное разделение
+struct MetricsSlot {
+    _Alignas(64) atomic_uint_fast64_t counters[METRIC_COUNTERS_NUM];
+    atomic_uint_fast64_t latency[LATENCY_BUCKETS];
+    atomic_uint_fast64_t latency_sum;
+};
+
+static struct MetricsSlot g_slots[METRICS_MAX_THREADS];
+static atomic_int g_slots_used;
+
+// Потоки сверх METRICS_MAX_THREADS делят последнюю ячейку
+static _Thread_local struct MetricsSlot *t_slot;
+
+static struct MetricsSlot *ThreadSlot(void) {
+    if (!t_slot) {
+        int index = atomic_fetch_add(&g_slots_used, 1);
+        if (index >= METRICS_MAX_THREADS)
+            index = METRICS_MAX_THREADS - 1;
+        t_slot = &g_slots[index];
+    }
+    return t_slot;
+}
+
+static int SlotsUsed(void) {
+    int used = atomic_load(&g_slots_used);
+    return used < METRICS_MAX_THREADS ? used : METRICS_MAX_THREADS;
+}
+
+void MetricsAdd(enum MetricCounter counter, uint64_t value) {
+    atomic_fetch_add_explicit(&ThreadSlot()->counters[counter], value,
+                              memory_order_relaxed);
+}
+
+static int LatencyBucket(uint64_t usec) {
+    if (usec < (1u << LATENCY_SUB_BITS))
+        return (int)usec;
+    int exp = 63 - __builtin_clzll(usec);
+    int sub = (int)(usec >> (exp - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1);
+    return ((exp - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+}
+
+// Нижняя граница значений корзины
+static uint64_t LatencyBucketValue(int bucket) {
+    if (bucket < (1 << LATENCY_SUB_BITS))
+        return (uint64_t)bucket;
+    int exp = (bucket >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+    uint64_t sub = bucket & ((1 << LATENCY_SUB_BITS) - 1);
+    return (((uint64_t)1 << LATENCY_SUB_BITS) + sub) << (exp - LATENCY_SUB_BITS);
+}
+
+void MetricsObserveLatency(uint64_t usec) {
+    struct MetricsSlot *slot = ThreadSlot();
+    atomic_fetch_add_explicit(&slot->latency[LatencyBucket(usec)], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&slot->latency_sum, usec, memory_order_relaxed);
+}
+
+uint64_t MetricsSum(enum MetricCounter counter) {
+    uint64_t sum = 0;
+    for (int i = 0; i < SlotsUsed(); i++)
+        sum += atomic_load_explicit(&g_slots[i].counters[counter], memory_order_relaxed);
+    return sum;
+}
+
+void MetricsLatencySnapshot(struct LatencyHistogram *histogram) {
+    memset(histogram, 0, sizeof(*histogram));
+    for (int i = 0; i < SlotsUsed(); i++) {
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            uint64_t count = atomic_load_explicit(&g_slots[i].latency[b],
+                                                  memory_order_relaxed);
+            histogram->counts[b] += count;
+            histogram->total += count;
+        }
+        histogram->sum += atomic_load_explicit(&g_slots[i].latency_sum,
+                                               memory_order_relaxed);
+    }
+}
+
+uint64_t LatencyQuantile(const struct LatencyHistogram *histogram, double q) {
+    if (histogram->total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(q * (double)(histogram->total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += histogram->counts[b];
+        if (seen >= rank)
+            return LatencyBucketValue(b);
+    }
+    return LatencyBucketValue(LATENCY_BUCKETS - 1);
+}
+
+struct MetricsHttp {
+    int fd;
+    MetricsRenderFunc render;
+    void *arg;
+};
+
+// Любой запрос получает страницу метрик, соединение сразу закрывается
+static void *MetricsThread(void *arg) {
+    struct MetricsHttp *http = (struct MetricsHttp *)arg;
+
+    while (true) {
+        int client = accept(http->fd, NULL, NULL);
+        if (client < 0)
+            continue;
+
+        struct timeval timeout = {1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        char request[1024];
+        if (recv(client, request, sizeof(request), 0) <= 0) {
+            close(client);
+            continue;
+        }
+
+        char *body = NULL;
+        size_t body_len = 0;
+        FILE *out = open_memstream(&body, &body_len);
+        if (!out) {
+            close(client);
+            continue;
+        }
+        http->render(out, http->arg);
+        fclose(out);
+
+        char header[160];
+        int header_len = snprintf(header, sizeof(header),
+                                  "HTTP/1.0 200 OK\r\n"
+                                  "Content-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %zu\r\n\r\n", body_len);
+        send(client, header, header_len, MSG_NOSIGNAL);
+        send(client, body, body_len, MSG_NOSIGNAL);
+        free(body);
+        close(client);
+    }
+
+    return NULL;
+}
+
+bool MetricsServe(int port, MetricsRenderFunc render, void *arg) {
+    struct MetricsHttp *http = malloc(sizeof(struct MetricsHttp));
+    if (!http)
+        return false;
+
+    http->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (http->fd < 0) {
+        free(http);
+        return false;
+    }
+    http->render = render;
+    http->arg = arg;
+
+    int opt_val = 1;
+    setsockopt(http->fd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    pthread_t thread;
+    if (bind(http->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(http->fd, 16) < 0 ||
+        pthread_create(&thread, NULL, MetricsThread, http)) {
+        close(http->fd);
+        free(http);
+        return false;
+    }
+
+    pthread_detach(thread);
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Счётчики сервера без блокировок.
+//
+// Каждый поток при первом обращении получает свою ячейку и пишет только
+// в неё, поэтому потоки не делят кэш-линии и не ждут друг друга.
+// Значения суммируются по всем ячейкам при чтении.
+
+enum MetricCounter {
+    METRIC_REQUESTS,          // принятые диапазоны
+    METRIC_BAD_REQUESTS,      // отклонённые диапазоны и кадры
+    METRIC_NUMBERS,           // перемноженные числа
+    METRIC_BYTES_IN,
+    METRIC_BYTES_OUT,
+    METRIC_CONNECTIONS,       // принятые соединения
+    METRIC_ENGINE_LINEAR,     // завершённые запросы по способам вычисления
+    METRIC_ENGINE_ZERO,
+    METRIC_ENGINE_WILSON,
+    METRIC_ENGINE_SQRT,
+    METRIC_COUNTERS_NUM
+};
+
+// Гистограмма задержек в микросекундах в духе HDR: 16 поддиапазонов на
+// каждую степень двойки, относительная погрешность не больше 1/16
+#define LATENCY_SUB_BITS 4
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+struct LatencyHistogram {
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total;
+    uint64_t sum;  // микросекунды
+};
+
+void MetricsAdd(enum MetricCounter counter, uint64_t value);
+void MetricsObserveLatency(uint64_t usec);
+
+uint64_t MetricsSum(enum MetricCounter counter);
+void MetricsLatencySnapshot(struct LatencyHistogram *histogram);
+
+// Значение, не меньше которого доля q наблюдений (0 <= q <= 1)
+uint64_t LatencyQuantile(const struct LatencyHistogram *histogram, double q);
+
+// Вывод текущих значений в формате Prometheus
+typedef void (*MetricsRenderFunc)(FILE *out, void *arg);
+
+// Запуск потока, отвечающего на HTTP-запросы на 127.0.0.1:port
+// выводом render; false, если порт занять не удалось
+bool MetricsServe(int port, MetricsRenderFunc render, void *arg);
+
+#endif // METRICS_H
@@ -0,0 +1,384 @@
+#include "mod_arith.h"
+
+#include <stddef.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+typedef unsigned __int128 u128;
+
+// Редукция Барретта: x mod m для любого 128-битного x
+static inline uint64_t BarrettReduce(const struct ModContext *ctx, u128 x) {
+    uint64_t x0 = (uint64_t)x, x1 = (uint64_t)(x >> 64);
+    uint64_t u0 = (uint64_t)ctx->mu, u1 = (uint64_t)(ctx->mu >> 64);
+
+    // Старшие 128 бит произведения x * mu
+    u128 p00 = (u128)x0 * u0;
+    u128 p01 = (u128)x0 * u1;
+    u128 p10 = (u128)x1 * u0;
+    u128 p11 = (u128)x1 * u1;
+    u128 mid = (p00 >> 64) + (uint64_t)p01 + (uint64_t)p10;
+    u128 q = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+
+    // Оценка частного занижена не более чем на 2
+    u128 r = x - q * ctx->mod;
+    while (r >= ctx->mod)
+        r -= ctx->mod;
+    return (uint64_t)r;
+}
+
+bool ModContextInit(struct ModContext *ctx, uint64_t mod) {
+    if (mod == 0)
+        return false;
+
+    ctx->mod = mod;
+    ctx->inv = 0;
+    ctx->r2 = 0;
+    ctx->mu = 0;
+
+    if (mod == 1) {
+        ctx->kind = MOD_KIND_TRIVIAL;
+    } else if (mod & 1) {
+        ctx->kind = MOD_KIND_MONTGOMERY;
+
+        // Метод Ньютона: каждая итерация удваивает число верных бит
+        uint64_t inv = mod;
+        for (int i = 0; i < 5; i++)
+            inv *= 2 - mod * inv;
+        ctx->inv = inv;
+
+        // 2^128 mod m = ((2^128 - 1) mod m + 1) mod m
+        ctx->r2 = (uint64_t)(((u128)-1 % mod + 1) % mod);
+    } else {
+        ctx->kind = MOD_KIND_BARRETT;
+        ctx->mu = (u128)-1 / mod;
+    }
+
+    return true;
+}
+
+uint64_t ModMul(const struct ModContext *ctx, uint64_t a, uint64_t b) {
+    switch (ctx->kind) {
+        case MOD_KIND_MONTGOMERY:
+            if (a >= ctx->mod)
+                a %= ctx->mod;
+            // REDC(REDC(a * b) * R^2) = a * b
+            return ModMontgomeryReduce(ctx,
+                (u128)ModMontgomeryReduce(ctx, (u128)a * b) * ctx->r2);
+        case MOD_KIND_BARRETT:
+            return BarrettReduce(ctx, (u128)a * b);
+        default:
+            return 0;
+    }
+}
+
+uint64_t ModPow(const struct ModContext *ctx, uint64_t base, uint64_t exp) {
+    uint64_t result = ModMul(ctx, 1, 1);
+    base = ModMul(ctx, base, 1);
+
+    while (exp > 0) {
+        if (exp & 1)
+            result = ModMul(ctx, result, base);
+        base = ModMul(ctx, base, base);
+        exp >>= 1;
+    }
+
+    return result;
+}
+
+uint64_t ModInversePrime(const struct ModContext *ctx, uint64_t a) {
+    return ModPow(ctx, a, ctx->mod - 2);
+}
+
+bool ModIsPrime(uint64_t n) {
+    if (n < 2)
+        return false;
+
+    static const uint64_t small_primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    for (size_t i = 0; i < sizeof(small_primes) / sizeof(small_primes[0]); i++) {
+        if (n == small_primes[i])
+            return true;
+        if (n % small_primes[i] == 0)
+            return false;
+    }
+
+    struct ModContext ctx;
+    ModContextInit(&ctx, n);
+
+    uint64_t d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+
+    // Этого набора оснований достаточно для всех n < 2^64
+    static const uint64_t bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint64_t a = bases[i] % n;
+        if (a == 0)
+            continue;
+
+        uint64_t x = ModPow(&ctx, a, d);
+        if (x == 1 || x == n - 1)
+            continue;
+
+        bool composite = true;
+        for (int r = 1; r < s; r++) {
+            x = ModMul(&ctx, x, x);
+            if (x == n - 1) {
+                composite = false;
+                break;
+            }
+        }
+        if (composite)
+            return false;
+    }
+
+    return true;
+}
+
+// Одна цепочка зависимых умножений
+static uint64_t RangeProductScalar(const struct ModContext *ctx, uint64_t begin,
+                                   uint64_t end) {
+    uint64_t ans = 1;
+
+    if (ctx->kind == MOD_KIND_MONTGOMERY) {
+        // Множители не переводятся в форму Монтгомери: каждая редукция
+        // добавляет лишний множитель 2^-64, который снимается в конце
+        // одним возведением в степень.
+        uint64_t count = 0;
+        for (uint64_t i = begin;; i++) {
+            ans = ModMontgomeryReduce(ctx, (u128)ans * i);
+            count++;
+            if (i == end)
+                break;
+        }
+
+        uint64_t r = ModMontgomeryReduce(ctx, ctx->r2);  // 2^64 mod m
+        return ModMul(ctx, ans, ModPow(ctx, r, count));
+    }
+
+    for (uint64_t i = begin;; i++) {
+        ans = BarrettReduce(ctx, (u128)ans * i);
+        if (i == end)
+            break;
+    }
+
+    return ans;
+}
+
+// Четыре независимых цепочки: умножения разных цепочек выполняются
+// процессором параллельно, а не ждут друг друга
+static uint64_t RangeProductLanes(const struct ModContext *ctx, uint64_t begin,
+                                  uint64_t end) {
+    uint64_t n = end - begin + 1;
+    if (n < 8)
+        return RangeProductScalar(ctx, begin, end);
+
+    uint64_t a0 = 1, a1 = 1, a2 = 1, a3 = 1;
+    uint64_t i = begin;
+    uint64_t blocks = n / 4;
+
+    if (ctx->kind == MOD_KIND_MONTGOMERY) {
+        for (uint64_t b = 0; b < blocks; b++, i += 4) {
+            a0 = ModMontgomeryReduce(ctx, (u128)a0 * i);
+            a1 = ModMontgomeryReduce(ctx, (u128)a1 * (i + 1));
+            a2 = ModMontgomeryReduce(ctx, (u128)a2 * (i + 2));
+            a3 = ModMontgomeryReduce(ctx, (u128)a3 * (i + 3));
+        }
+        for (uint64_t b = blocks * 4; b < n; b++, i++)
+            a0 = ModMontgomeryReduce(ctx, (u128)a0 * i);
+
+        // n редукций в цепочках и 3 при объединении
+        uint64_t ans = ModMontgomeryReduce(ctx,
+            (u128)ModMontgomeryReduce(ctx, (u128)a0 * a1) *
+            ModMontgomeryReduce(ctx, (u128)a2 * a3));
+        uint64_t r = ModMontgomeryReduce(ctx, ctx->r2);  // 2^64 mod m
+        return ModMul(ctx, ans, ModPow(ctx, r, n + 3));
+    }
+
+    for (uint64_t b = 0; b < blocks; b++, i += 4) {
+        a0 = BarrettReduce(ctx, (u128)a0 * i);
+        a1 = BarrettReduce(ctx, (u128)a1 * (i + 1));
+        a2 = BarrettReduce(ctx, (u128)a2 * (i + 2));
+        a3 = BarrettReduce(ctx, (u128)a3 * (i + 3));
+    }
+    for (uint64_t b = blocks * 4; b < n; b++, i++)
+        a0 = BarrettReduce(ctx, (u128)a0 * i);
+
+    return ModMul(ctx, ModMul(ctx, a0, a1), ModMul(ctx, a2, a3));
+}
+
+#if defined(__x86_64__)
+
+// Векторные ядра используют редукцию Монтгомери с R = 2^32 в 64-битных
+// ячейках: acc < m < 2^32 и i < 2^32, поэтому acc * i < m * 2^32 и
+// результат редукции снова меньше m. Каждая редукция добавляет множитель
+// 2^-32, их число известно заранее и снимается в конце.
+
+__attribute__((target("avx2")))
+static inline __m256i RedcAvx2(__m256i t, __m256i inv, __m256i mod) {
+    __m256i q = _mm256_mul_epu32(t, inv);  // младшие 32 бита t * m^-1
+    __m256i qm = _mm256_mul_epu32(q, mod);
+    __m256i r = _mm256_sub_epi64(_mm256_srli_epi64(t, 32), _mm256_srli_epi64(qm, 32));
+    __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), r);
+    return _mm256_add_epi64(r, _mm256_and_si256(negative, mod));
+}
+
+// Перемножение blocks * 8 чисел, начиная с begin; в lanes 8 результатов
+__attribute__((target("avx2")))
+static void LanesAvx2(uint64_t mod, uint64_t inv, uint64_t begin, uint64_t blocks,
+                      uint64_t lanes[8]) {
+    __m256i vmod = _mm256_set1_epi64x((long long)mod);
+    __m256i vinv = _mm256_set1_epi64x((long long)inv);
+    __m256i step = _mm256_set1_epi64x(8);
+    __m256i acc0 = _mm256_set1_epi64x(1);
+    __m256i acc1 = acc0;
+    __m256i i0 = _mm256_setr_epi64x(begin, begin + 1, begin + 2, begin + 3);
+    __m256i i1 = _mm256_add_epi64(i0, _mm256_set1_epi64x(4));
+
+    for (uint64_t b = 0; b < blocks; b++) {
+        acc0 = RedcAvx2(_mm256_mul_epu32(acc0, i0), vinv, vmod);
+        acc1 = RedcAvx2(_mm256_mul_epu32(acc1, i1), vinv, vmod);
+        i0 = _mm256_add_epi64(i0, step);
+        i1 = _mm256_add_epi64(i1, step);
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, acc0);
+    _mm256_storeu_si256((__m256i *)(lanes + 4), acc1);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i RedcAvx512(__m512i t, __m512i inv, __m512i mod) {
+    __m512i q = _mm512_mul_epu32(t, inv);
+    __m512i qm = _mm512_mul_epu32(q, mod);
+    __m512i r = _mm512_sub_epi64(_mm512_srli_epi64(t, 32), _mm512_srli_epi64(qm, 32));
+    __mmask8 negative = _mm512_cmplt_epi64_mask(r, _mm512_setzero_si512());
+    return _mm512_mask_add_epi64(r, negative, r, mod);
+}
+
+// Перемножение blocks * 16 чисел, начиная с begin; в lanes 16 результатов
+__attribute__((target("avx512f")))
+static void LanesAvx512(uint64_t mod, uint64_t inv, uint64_t begin, uint64_t blocks,
+                        uint64_t lanes[16]) {
+    __m512i vmod = _mm512_set1_epi64((long long)mod);
+    __m512i vinv = _mm512_set1_epi64((long long)inv);
+    __m512i step = _mm512_set1_epi64(16);
+    __m512i acc0 = _mm512_set1_epi64(1);
+    __m512i acc1 = acc0;
+    __m512i i0 = _mm512_add_epi64(_mm512_set1_epi64((long long)begin),
+                                  _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7));
+    __m512i i1 = _mm512_add_epi64(i0, _mm512_set1_epi64(8));
+
+    for (uint64_t b = 0; b < blocks; b++) {
+        acc0 = RedcAvx512(_mm512_mul_epu32(acc0, i0), vinv, vmod);
+        acc1 = RedcAvx512(_mm512_mul_epu32(acc1, i1), vinv, vmod);
+        i0 = _mm512_add_epi64(i0, step);
+        i1 = _mm512_add_epi64(i1, step);
+    }
+
+    _mm512_storeu_si512(lanes, acc0);
+    _mm512_storeu_si512(lanes + 8, acc1);
+}
+
+// Общая часть векторных ядер: полные блоки векторно, остаток ядром LANES
+static uint64_t RangeProductVector(const struct ModContext *ctx, uint64_t begin,
+                                   uint64_t end, enum ModKernel kernel) {
+    int width = kernel == MOD_KERNEL_AVX512 ? 16 : 8;
+    uint64_t blocks = (end - begin + 1) / width;
+    if (blocks == 0)
+        return RangeProductLanes(ctx, begin, end);
+
+    uint64_t lanes[16];
+    if (kernel == MOD_KERNEL_AVX512)
+        LanesAvx512(ctx->mod, ctx->inv & UINT32_MAX, begin, blocks, lanes);
+    else
+        LanesAvx2(ctx->mod, ctx->inv & UINT32_MAX, begin, blocks, lanes);
+
+    uint64_t ans = 1;
+    for (int i = 0; i < width; i++)
+        ans = ModMul(ctx, ans, lanes[i]);
+
+    // Снимаем множитель 2^-32 каждой из blocks * width редукций
+    uint64_t r32 = ((uint64_t)1 << 32) % ctx->mod;
+    ans = ModMul(ctx, ans, ModPow(ctx, r32, blocks * width));
+
+    uint64_t rest = begin + blocks * width;
+    if (rest <= end)
+        ans = ModMul(ctx, ans, RangeProductLanes(ctx, rest, end));
+    return ans;
+}
+
+#endif // __x86_64__
+
+const char *ModKernelName(enum ModKernel kernel) {
+    switch (kernel) {
+        case MOD_KERNEL_SCALAR: return "scalar";
+        case MOD_KERNEL_LANES: return "lanes";
+        case MOD_KERNEL_AVX2: return "avx2";
+        case MOD_KERNEL_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+bool ModKernelSupported(enum ModKernel kernel) {
+    switch (kernel) {
+        case MOD_KERNEL_SCALAR:
+        case MOD_KERNEL_LANES:
+            return true;
+#if defined(__x86_64__)
+        case MOD_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case MOD_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+enum ModKernel ModBestKernel(void) {
+    // Проверка процессора один раз; гонка безвредна, результат одинаков
+    static int best = -1;
+    if (best < 0) {
+        if (ModKernelSupported(MOD_KERNEL_AVX512))
+            best = MOD_KERNEL_AVX512;
+        else if (ModKernelSupported(MOD_KERNEL_AVX2))
+            best = MOD_KERNEL_AVX2;
+        else
+            best = MOD_KERNEL_LANES;
+    }
+    return (enum ModKernel)best;
+}
+
+uint64_t ModRangeProductKernel(const struct ModContext *ctx, uint64_t begin,
+                               uint64_t end, enum ModKernel kernel) {
+    if (ctx->kind == MOD_KIND_TRIVIAL)
+        return 0;
+    if (begin > end)
+        return 1;
+    if (begin == 0)
+        return 0;
+
+    switch (kernel) {
+        case MOD_KERNEL_SCALAR:
+            return RangeProductScalar(ctx, begin, end);
+#if defined(__x86_64__)
+        case MOD_KERNEL_AVX2:
+        case MOD_KERNEL_AVX512:
+            if (ctx->kind == MOD_KIND_MONTGOMERY && ctx->mod <= UINT32_MAX &&
+                end <= UINT32_MAX && ModKernelSupported(kernel))
+                return RangeProductVector(ctx, begin, end, kernel);
+            return RangeProductLanes(ctx, begin, end);
+#endif
+        default:
+            return RangeProductLanes(ctx, begin, end);
+    }
+}
+
+uint64_t ModRangeProduct(const struct ModContext *ctx, uint64_t begin,
+                         uint64_t end) {
+    return ModRangeProductKernel(ctx, begin, end, ModBestKernel());
+}
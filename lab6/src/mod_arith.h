@@ -0,0 +1,93 @@
+#ifndef MOD_ARITH_H
+#define MOD_ARITH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Способ редукции, выбранный для конкретного модуля
+enum ModKind {
+    MOD_KIND_TRIVIAL,     // mod == 1, любой результат равен 0
+    MOD_KIND_MONTGOMERY,  // нечётный модуль
+    MOD_KIND_BARRETT      // чётный модуль
+};
+
+// Предвычисленный контекст модульной арифметики.
+// Создаётся один раз на запрос и затем только читается,
+// поэтому его можно разделять между потоками.
+struct ModContext {
+    uint64_t mod;
+    enum ModKind kind;
+    uint64_t inv;          // mod^-1 mod 2^64 (Монтгомери)
+    uint64_t r2;           // 2^128 mod mod (Монтгомери)
+    unsigned __int128 mu;  // floor((2^128 - 1) / mod) (Барретт)
+};
+
+// Редукция Монтгомери: t * 2^-64 mod m, требуется нечётный m и t < m * 2^64
+static inline uint64_t ModMontgomeryReduce(const struct ModContext *ctx,
+                                           unsigned __int128 t) {
+    uint64_t t_lo = (uint64_t)t;
+    uint64_t t_hi = (uint64_t)(t >> 64);
+    uint64_t q = t_lo * ctx->inv;
+    uint64_t h = (uint64_t)(((unsigned __int128)q * ctx->mod) >> 64);
+
+    // Младшие слова t и q * m совпадают, поэтому вычитаем только старшие
+    uint64_t res = t_hi - h;
+    if (t_hi < h)
+        res += ctx->mod;
+    return res;
+}
+
+// Перевод в форму Монтгомери (x * 2^64 mod m) и обратно
+static inline uint64_t ModToMontgomery(const struct ModContext *ctx,
+                                       uint64_t x) {
+    return ModMontgomeryReduce(ctx, (unsigned __int128)(x % ctx->mod) * ctx->r2);
+}
+
+static inline uint64_t ModFromMontgomery(const struct ModContext *ctx,
+                                         uint64_t x) {
+    return ModMontgomeryReduce(ctx, x);
+}
+
+// Инициализация контекста, false при mod == 0
+bool ModContextInit(struct ModContext *ctx, uint64_t mod);
+
+// a * b mod ctx->mod для обычных (не Монтгомери) чисел
+uint64_t ModMul(const struct ModContext *ctx, uint64_t a, uint64_t b);
+
+// base^exp mod ctx->mod
+uint64_t ModPow(const struct ModContext *ctx, uint64_t base, uint64_t exp);
+
+// Обратный элемент по простому модулю (малая теорема Ферма)
+uint64_t ModInversePrime(const struct ModContext *ctx, uint64_t a);
+
+// Детерминированный тест Миллера-Рабина для 64-битных чисел
+bool ModIsPrime(uint64_t n);
+
+// Ядро перемножения диапазона
+enum ModKernel {
+    MOD_KERNEL_SCALAR,  // одна цепочка зависимых умножений
+    MOD_KERNEL_LANES,   // 4 независимых произведения в обычных регистрах
+    MOD_KERNEL_AVX2,    // 8 произведений в регистрах AVX2
+    MOD_KERNEL_AVX512   // 16 произведений в регистрах AVX-512
+};
+
+const char *ModKernelName(enum ModKernel kernel);
+
+// Поддерживает ли процессор ядро
+bool ModKernelSupported(enum ModKernel kernel);
+
+// Самое быстрое ядро, доступное на этом процессоре
+enum ModKernel ModBestKernel(void);
+
+// Произведение begin * (begin + 1) * ... * end mod ctx->mod заданным ядром.
+// Векторные ядра работают с нечётными mod < 2^32 и числами < 2^32,
+// остальные диапазоны и части диапазонов считаются ядром LANES.
+uint64_t ModRangeProductKernel(const struct ModContext *ctx, uint64_t begin,
+                               uint64_t end, enum ModKernel kernel);
+
+// Произведение begin * (begin + 1) * ... * end mod ctx->mod
+// лучшим доступным ядром
+uint64_t ModRangeProduct(const struct ModContext *ctx, uint64_t begin,
+                         uint64_t end);
+
+#endif // MOD_ARITH_H
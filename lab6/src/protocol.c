@@ -0,0 +1,122 @@
+#include "protocol.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+static void PutU32(char *buf, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        buf[i] = (char)(value >> (8 * i));
+}
+
+static void PutU64(char *buf, uint64_t value) {
+    for (int i = 0; i < 8; i++)
+        buf[i] = (char)(value >> (8 * i));
+}
+
+static uint32_t GetU32(const char *buf) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)(unsigned char)buf[i] << (8 * i);
+    return value;
+}
+
+static uint64_t GetU64(const char *buf) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= (uint64_t)(unsigned char)buf[i] << (8 * i);
+    return value;
+}
+
+bool ProtocolHasMagic(const char *buf) {
+    return memcmp(buf, PROTOCOL_MAGIC, 4) == 0;
+}
+
+void EncodeHeader(char *buf, const struct FrameHeader *header) {
+    memcpy(buf, PROTOCOL_MAGIC, 4);
+    buf[4] = (char)header->version;
+    buf[5] = (char)header->type;
+    buf[6] = 0;
+    buf[7] = 0;
+    PutU32(buf + 8, header->length);
+    PutU32(buf + 12, header->count);
+}
+
+bool DecodeHeader(const char *buf, struct FrameHeader *header) {
+    if (!ProtocolHasMagic(buf))
+        return false;
+
+    header->version = (uint8_t)buf[4];
+    header->type = (uint8_t)buf[5];
+    header->length = GetU32(buf + 8);
+    header->count = GetU32(buf + 12);
+
+    if (header->version != PROTOCOL_VERSION || header->count > PROTOCOL_MAX_ITEMS)
+        return false;
+
+    switch (header->type) {
+        case FRAME_REQUEST:
+            return header->length == header->count * RANGE_ITEM_SIZE;
+        case FRAME_RESPONSE:
+            return header->length == header->count * RESULT_ITEM_SIZE;
+        default:
+            return false;
+    }
+}
+
+void EncodeRangeItem(char *buf, const struct RangeItem *item) {
+    PutU64(buf, item->id);
+    PutU64(buf + 8, item->begin);
+    PutU64(buf + 16, item->end);
+    PutU64(buf + 24, item->mod);
+}
+
+void DecodeRangeItem(const char *buf, struct RangeItem *item) {
+    item->id = GetU64(buf);
+    item->begin = GetU64(buf + 8);
+    item->end = GetU64(buf + 16);
+    item->mod = GetU64(buf + 24);
+}
+
+void EncodeResultItem(char *buf, const struct ResultItem *item) {
+    PutU64(buf, item->id);
+    PutU64(buf + 8, item->result);
+    PutU32(buf + 16, item->status);
+    PutU32(buf + 20, item->engine);
+}
+
+void DecodeResultItem(const char *buf, struct ResultItem *item) {
+    item->id = GetU64(buf);
+    item->result = GetU64(buf + 8);
+    item->status = GetU32(buf + 16);
+    item->engine = GetU32(buf + 20);
+}
+
+bool SendAll(int fd, const void *buf, size_t len) {
+    const char *ptr = buf;
+    while (len > 0) {
+        ssize_t sent = send(fd, ptr, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        ptr += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+bool RecvAll(int fd, void *buf, size_t len) {
+    char *ptr = buf;
+    while (len > 0) {
+        ssize_t received = recv(fd, ptr, len, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        ptr += received;
+        len -= received;
+    }
+    return true;
+}
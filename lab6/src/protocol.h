@@ -0,0 +1,84 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Кадровый протокол между клиентом и сервером.
+//
+// Каждый кадр начинается с 16-байтного заголовка:
+//   0..3   сигнатура "FCTP"
+//   4      версия протокола
+//   5      тип кадра (FrameType)
+//   6..7   зарезервировано, 0
+//   8..11  длина полезной нагрузки в байтах
+//   12..15 число элементов в кадре
+// Все числа передаются в little-endian.
+//
+// Кадр запроса несёт count диапазонов RangeItem, кадр ответа - count
+// результатов ResultItem. Ответы приходят в порядке готовности и
+// сопоставляются с запросами по id, поэтому по одному соединению можно
+// отправлять много диапазонов, не дожидаясь ответов.
+//
+// Если первые байты соединения не совпадают с сигнатурой, сервер
+// работает по старому протоколу: 24 байта {begin, end, mod} на запрос
+// и 8 байт результата в ответ.
+
+#define PROTOCOL_MAGIC "FCTP"
+#define PROTOCOL_VERSION 1
+#define PROTOCOL_HEADER_SIZE 16
+#define PROTOCOL_MAX_ITEMS 4096
+
+#define RANGE_ITEM_SIZE 32
+#define RESULT_ITEM_SIZE 24
+
+enum FrameType {
+    FRAME_REQUEST = 1,
+    FRAME_RESPONSE = 2
+};
+
+enum ResultStatus {
+    RESULT_OK = 0,
+    RESULT_BAD_REQUEST = 1  // например, mod == 0
+};
+
+struct FrameHeader {
+    uint8_t version;
+    uint8_t type;
+    uint32_t length;
+    uint32_t count;
+};
+
+struct RangeItem {
+    uint64_t id;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t mod;
+};
+
+struct ResultItem {
+    uint64_t id;
+    uint64_t result;
+    uint32_t status;  // ResultStatus
+    uint32_t engine;  // FactorialEngine, которым посчитан диапазон
+};
+
+// Начинается ли буфер (не короче 4 байт) с сигнатуры протокола
+bool ProtocolHasMagic(const char *buf);
+
+void EncodeHeader(char *buf, const struct FrameHeader *header);
+
+// false, если сигнатура, версия или размеры кадра некорректны
+bool DecodeHeader(const char *buf, struct FrameHeader *header);
+
+void EncodeRangeItem(char *buf, const struct RangeItem *item);
+void DecodeRangeItem(const char *buf, struct RangeItem *item);
+void EncodeResultItem(char *buf, const struct ResultItem *item);
+void DecodeResultItem(const char *buf, struct ResultItem *item);
+
+// Блокирующие отправка и приём ровно len байт
+bool SendAll(int fd, const void *buf, size_t len);
+bool RecvAll(int fd, void *buf, size_t len);
+
+#endif // PROTOCOL_H
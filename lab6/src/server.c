@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -6,14 +8,29 @@
 #include <unistd.h>
 #include <stdint.h>
 
+#include <errno.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <getopt.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
 #include "pthread.h"
-#include "common.h" // для структуры FactorialArgs и MultModulo
+#include "common.h" // для структуры FactorialArgs и ModContext
+#include "factorial.h"
+#include "factorial_cache.h"
+#include "log.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "thread_pool.h"
+
+#define REQUEST_SIZE (sizeof(uint64_t) * 3)
+#define RESPONSE_SIZE sizeof(uint64_t)
+#define MAX_EVENTS 256
 
 
 // Вычисление частичного факториала для заданного диапазона
@@ -25,23 +42,825 @@ uint64_t Factorial(const struct FactorialArgs *args) {
         return 1;
     }
     
-    for (uint64_t i = args->begin; i <= args->end; i++) {
-        ans = MultModulo(ans, i, args->mod);
-    }
+    ans = ModRangeProduct(args->ctx, args->begin, args->end);
     
     return ans;
 }
 
-// Функция-обёртка для запуска в потоке
-void *ThreadFactorial(void *args) {
-    struct FactorialArgs *fargs = (struct FactorialArgs *)args;
-    uint64_t result = Factorial(fargs);
-    return (void *)(uintptr_t)result;  // Безопасное приведение
+// Растущий буфер байтов соединения
+struct ByteBuffer {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+static bool BufferReserve(struct ByteBuffer *buf, size_t extra) {
+    if (buf->len + extra <= buf->cap)
+        return true;
+
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < buf->len + extra)
+        cap *= 2;
+    char *data = realloc(buf->data, cap);
+    if (!data)
+        return false;
+    buf->data = data;
+    buf->cap = cap;
+    return true;
+}
+
+static void BufferConsume(struct ByteBuffer *buf, size_t bytes) {
+    memmove(buf->data, buf->data + bytes, buf->len - bytes);
+    buf->len -= bytes;
+}
+
+enum ConnectionProtocol {
+    PROTOCOL_UNKNOWN,
+    PROTOCOL_LEGACY,  // 24 байта запроса, 8 байт ответа, строго по очереди
+    PROTOCOL_FRAMED   // кадры protocol.h, ответы в порядке готовности
+};
+
+// Сколько диапазонов одного соединения может считаться одновременно
+#define MAX_IN_FLIGHT 4096
+
+// Состояние клиентского соединения. Поля меняет только поток цикла событий.
+struct Connection {
+    int fd;
+    enum ConnectionProtocol protocol;
+    struct ByteBuffer in;
+    struct ByteBuffer out;
+    size_t out_sent;
+
+    // Готовые результаты, которые ещё не упакованы в кадр ответа
+    struct ResultItem *ready;
+    size_t ready_num;
+    size_t ready_cap;
+
+    int in_flight;               // диапазоны в работе у рабочих потоков
+    bool closed;                 // сокет закрыт, ждём завершения диапазонов
+    bool touched;                // в списке соединений с новыми результатами
+    struct Connection *next;     // в списке закрытых или изменённых
+
+    // Диапазоны, которые ждут места в очереди пула; пока они есть,
+    // соединение не читается
+    struct Request *backlog_head;
+    struct Request *backlog_tail;
+    struct Connection *backlog_next;  // в очереди соединений с отложенными
+};
+
+struct Request;
+
+// Часть запроса, выполняемая одним потоком
+struct FactorialTask {
+    struct FactorialArgs args;
+    struct Request *request;
+    uint64_t result;
+};
+
+// Диапазон в работе: части считают рабочие потоки, последняя из них
+// собирает результат и возвращает запрос циклу событий
+struct Request {
+    struct FactorialServer *server;
+    struct Connection *conn;
+    uint64_t id;
+    struct ModContext ctx;
+    struct FactorialArgs args;
+    enum FactorialEngine engine;
+    struct FactorialTask *tasks;
+    int tasks_num;
+    struct TaskGroup group;
+    uint64_t total;
+    uint64_t received_us;  // время приёма для гистограммы задержек
+    bool failed;           // не все части удалось запустить
+    struct Request *next;  // в списке завершённых или ждущих места в пуле
+};
+
+struct FactorialServer {
+    int tnum;
+    bool use_pool;
+    struct ThreadPool pool;
+
+    bool use_cache;
+    struct FactorialCache cache;  // произведения блоков по 2^20 чисел
+
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;  // eventfd: рабочие потоки будят цикл событий
+
+    pthread_mutex_t done_mutex;
+    struct Request *done_head;
+
+    // Соединения с запросами, для которых не нашлось места в очереди пула.
+    // Цикл событий не ждёт пул: когда завершения освобождают места,
+    // соединения по кругу ставят по одному запросу, и клиент с длинной
+    // очередью диапазонов не задерживает остальных.
+    struct Connection *backlog_head;
+    struct Connection *backlog_tail;
+
+    struct Connection *closed_head;   // освобождаются в конце итерации цикла
+    struct Connection *touched_head;  // получили результаты в этой итерации
+
+    atomic_int active_connections;  // читается потоком метрик
+};
+
+static uint64_t NowMicros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Часть линейного запроса
+static void RunFactorialTask(void *arg) {
+    struct FactorialTask *task = (struct FactorialTask *)arg;
+    struct FactorialServer *server = task->request->server;
+    MetricsAdd(METRIC_NUMBERS, task->args.end - task->args.begin + 1);
+    if (server->use_cache) {
+        task->result = FactorialCacheRangeProduct(&server->cache, task->args.ctx,
+                                                  task->args.begin, task->args.end);
+    } else {
+        task->result = Factorial(&task->args);
+    }
+}
+
+// Весь запрос одним из быстрых способов
+static void RunFastTask(void *arg) {
+    struct FactorialTask *task = (struct FactorialTask *)arg;
+    struct Request *req = task->request;
+    MetricsAdd(METRIC_NUMBERS, task->args.end - task->args.begin + 1);
+    if (!FactorialFast(&task->args, req->engine, &task->result)) {
+        req->engine = FACTORIAL_ENGINE_LINEAR;
+        task->result = Factorial(&task->args);
+    }
+}
+
+// Вызывается в рабочем потоке, завершившем последнюю часть запроса
+static void FinishRequest(void *arg) {
+    struct Request *req = (struct Request *)arg;
+    struct FactorialServer *server = req->server;
+
+    req->total = 1 % req->args.mod;
+    for (int i = 0; i < req->tasks_num; i++)
+        req->total = ModMul(&req->ctx, req->total, req->tasks[i].result);
+
+    MetricsAdd(METRIC_ENGINE_LINEAR + req->engine, 1);
+    MetricsObserveLatency(NowMicros() - req->received_us);
+
+    pthread_mutex_lock(&server->done_mutex);
+    req->next = server->done_head;
+    server->done_head = req;
+    pthread_mutex_unlock(&server->done_mutex);
+
+    uint64_t one = 1;
+    if (write(server->wake_fd, &one, sizeof(one)) < 0)
+        LogMessage(LOG_ERROR, "Can not wake event loop\n");
+}
+
+struct ThreadTask {
+    ThreadPoolFunc func;
+    void *arg;
+    struct TaskGroup *group;
+};
+
+// Функция-обёртка для запуска части запроса в отдельном потоке (--no_pool)
+static void *ThreadTaskMain(void *arg) {
+    struct ThreadTask task = *(struct ThreadTask *)arg;
+    free(arg);
+    task.func(task.arg);
+    TaskGroupFinishOne(task.group);
+    return NULL;
+}
+
+static bool SubmitTask(struct FactorialServer *server, ThreadPoolFunc func,
+                       void *arg, struct TaskGroup *group) {
+    // Место проверено в StartRequest, поэтому постановка не блокирует
+    if (server->use_pool)
+        return ThreadPoolTrySubmit(&server->pool, func, arg, group);
+
+    // Поток на каждую часть запроса, как до появления пула
+    struct ThreadTask *task = malloc(sizeof(struct ThreadTask));
+    if (!task)
+        return false;
+    task->func = func;
+    task->arg = arg;
+    task->group = group;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ThreadTaskMain, task)) {
+        LogMessage(LOG_ERROR, "Error: pthread_create failed!\n");
+        free(task);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+static void FreeRequest(struct Request *req) {
+    TaskGroupDestroy(&req->group);
+    free(req->tasks);
+    free(req);
+}
+
+// Соединение попадает в список тех, чей вывод и ввод разбираются в конце
+// обработки завершённых запросов
+static void TouchConnection(struct FactorialServer *server, struct Connection *conn) {
+    if (!conn->touched) {
+        conn->touched = true;
+        conn->next = server->touched_head;
+        server->touched_head = conn;
+    }
+}
+
+// Результат соединения, который будет отправлен в следующем кадре ответа
+static bool PushResult(struct FactorialServer *server, struct Connection *conn,
+                       const struct ResultItem *item) {
+    if (conn->ready_num == conn->ready_cap) {
+        size_t cap = conn->ready_cap ? conn->ready_cap * 2 : 64;
+        struct ResultItem *ready = realloc(conn->ready, cap * sizeof(struct ResultItem));
+        if (!ready)
+            return false;
+        conn->ready = ready;
+        conn->ready_cap = cap;
+    }
+    conn->ready[conn->ready_num++] = *item;
+    TouchConnection(server, conn);
+    return true;
+}
+
+// Передача всех частей запроса пулу
+static void SubmitRequest(struct FactorialServer *server, struct Request *req) {
+    ThreadPoolFunc func = req->engine == FACTORIAL_ENGINE_LINEAR
+                              ? RunFactorialTask : RunFastTask;
+    for (int i = 0; i < req->tasks_num; i++) {
+        if (!SubmitTask(server, func, &req->tasks[i], &req->group)) {
+            // Оставшиеся части считаются выполненными с результатом 1,
+            // поэтому вместо ответа соединение будет закрыто
+            req->failed = true;
+            for (int j = i; j < req->tasks_num; j++)
+                TaskGroupFinishOne(&req->group);
+            break;
+        }
+    }
+}
+
+// Запрос ставится в пул целиком или не ставится вовсе: частично
+// поставленный запрос не завершится и не разбудит цикл событий, а только
+// завершения освобождают места для отложенных
+static bool PoolHasRoom(struct FactorialServer *server, const struct Request *req) {
+    return !server->use_pool ||
+           ThreadPoolFreeSlots(&server->pool) >= (size_t)req->tasks_num;
+}
+
+static void EnqueueBacklogged(struct FactorialServer *server, struct Connection *conn) {
+    conn->backlog_next = NULL;
+    if (server->backlog_tail)
+        server->backlog_tail->backlog_next = conn;
+    else
+        server->backlog_head = conn;
+    server->backlog_tail = conn;
+}
+
+// Запрос откладывается до освобождения мест в пуле
+static void DeferRequest(struct FactorialServer *server, struct Request *req) {
+    struct Connection *conn = req->conn;
+    if (!conn->backlog_head)
+        EnqueueBacklogged(server, conn);
+    if (conn->backlog_tail)
+        conn->backlog_tail->next = req;
+    else
+        conn->backlog_head = req;
+    conn->backlog_tail = req;
+}
+
+// Постановка отложенных запросов по кругу соединений, пока есть место
+static void DrainBacklog(struct FactorialServer *server) {
+    while (server->backlog_head) {
+        struct Connection *conn = server->backlog_head;
+        struct Request *req = conn->backlog_head;
+        if (!conn->closed && !PoolHasRoom(server, req))
+            break;
+
+        server->backlog_head = conn->backlog_next;
+        if (!server->backlog_head)
+            server->backlog_tail = NULL;
+
+        if (conn->closed) {
+            // Ответы отправлять некуда
+            while (conn->backlog_head) {
+                req = conn->backlog_head;
+                conn->backlog_head = req->next;
+                conn->in_flight--;
+                FreeRequest(req);
+            }
+            conn->backlog_tail = NULL;
+            continue;
+        }
+
+        conn->backlog_head = req->next;
+        req->next = NULL;
+        SubmitRequest(server, req);
+        if (conn->backlog_head) {
+            EnqueueBacklogged(server, conn);
+        } else {
+            // Чтение соединения возобновится при разборе изменённых
+            conn->backlog_tail = NULL;
+            TouchConnection(server, conn);
+        }
+    }
+}
+
+// Передача диапазона рабочим потокам; false при ошибке в запросе
+static bool StartRequest(struct FactorialServer *server, struct Connection *conn,
+                         const struct RangeItem *item) {
+    uint64_t begin = item->begin;
+    uint64_t end = item->end;
+    uint64_t mod = item->mod;
+
+    MetricsAdd(METRIC_REQUESTS, 1);
+    LogMessage(LOG_INFO, "Receive: %llu %llu %llu\n", (unsigned long long)begin,
+               (unsigned long long)end, (unsigned long long)mod);
+
+    struct Request *req = calloc(1, sizeof(struct Request));
+    if (!req) {
+        LogMessage(LOG_ERROR, "Memory allocation failed\n");
+        return false;
+    }
+
+    // Контекст модульной арифметики общий для всех потоков запроса
+    if (!ModContextInit(&req->ctx, mod)) {
+        MetricsAdd(METRIC_BAD_REQUESTS, 1);
+        LogMessage(LOG_WARN, "Client send zero modulus\n");
+        free(req);
+        return false;
+    }
+
+    // Проверяем и корректируем диапазон
+    if (begin > end) {
+        uint64_t temp = begin;
+        begin = end;
+        end = temp;
+    }
+
+    req->server = server;
+    req->conn = conn;
+    req->id = item->id;
+    req->received_us = NowMicros();
+    req->args.begin = begin;
+    req->args.end = end;
+    req->args.mod = mod;
+    req->args.ctx = &req->ctx;
+
+    // Для простых модулей и больших диапазонов есть способы
+    // быстрее прямого перемножения
+    req->engine = FactorialSelectEngine(&req->args);
+
+    // Вычисляем общее количество чисел
+    uint64_t total_numbers = end - begin + 1;
+    
+    // Защита от tnum > total_numbers
+    int actual_tnum = server->tnum;
+    if (req->engine != FACTORIAL_ENGINE_LINEAR) {
+        actual_tnum = 1;
+    }
+    if (actual_tnum > total_numbers) {
+        actual_tnum = total_numbers;
+    }
+    if (actual_tnum == 0) {
+        actual_tnum = 1;
+    }
+
+    req->tasks = calloc(actual_tnum, sizeof(struct FactorialTask));
+    if (!req->tasks) {
+        LogMessage(LOG_ERROR, "Memory allocation failed\n");
+        free(req);
+        return false;
+    }
+    req->tasks_num = actual_tnum;
+    TaskGroupInit(&req->group, actual_tnum);
+    TaskGroupSetCallback(&req->group, FinishRequest, req);
+
+    uint64_t range_size = total_numbers / actual_tnum;
+    uint64_t remainder = total_numbers % actual_tnum;
+
+    conn->in_flight++;
+
+    uint64_t current = begin;
+    for (int i = 0; i < actual_tnum; i++) {
+        struct FactorialArgs *args = &req->tasks[i].args;
+        args->begin = current;
+        args->end = current + range_size - 1;
+        
+        if (remainder > 0) {
+            args->end++;
+            remainder--;
+        }
+        
+        // Гарантируем корректность диапазона
+        if (args->end < args->begin) {
+            args->end = args->begin;
+        }
+        
+        args->mod = mod;
+        args->ctx = &req->ctx;
+        req->tasks[i].request = req;
+        req->tasks[i].result = 1 % mod;
+        
+        LogMessage(LOG_DEBUG, "Thread %d: %llu..%llu mod %llu\n", i,
+                   (unsigned long long)args->begin, (unsigned long long)args->end,
+                   (unsigned long long)args->mod);
+
+        current = args->end + 1;
+    }
+
+    // Очередь пула занята или своей очереди ждут другие: запрос
+    // откладывается, а соединение перестаёт читаться
+    if (server->backlog_head || !PoolHasRoom(server, req))
+        DeferRequest(server, req);
+    else
+        SubmitRequest(server, req);
+    return true;
+}
+
+static void UpdateEvents(struct FactorialServer *server, struct Connection *conn) {
+    if (conn->closed)
+        return;
+
+    // Старый протокол требует ответов по порядку, поэтому следующий запрос
+    // читается только после ответа на предыдущий
+    bool can_read = conn->in_flight < MAX_IN_FLIGHT && !conn->backlog_head &&
+                    !(conn->protocol == PROTOCOL_LEGACY && conn->in_flight > 0);
+
+    struct epoll_event ev;
+    ev.events = (can_read ? EPOLLIN : 0) |
+                (conn->out_sent < conn->out.len ? EPOLLOUT : 0);
+    ev.data.ptr = conn;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+// Закрытие сокета. Память освобождается в конце итерации цикла событий,
+// когда у соединения не останется диапазонов в работе.
+static void CloseConnection(struct FactorialServer *server,
+                            struct Connection *conn) {
+    if (conn->closed)
+        return;
+
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    shutdown(conn->fd, SHUT_RDWR);
+    close(conn->fd);
+    conn->fd = -1;
+    conn->closed = true;
+    atomic_fetch_sub(&server->active_connections, 1);
+
+    if (!conn->touched) {
+        conn->next = server->closed_head;
+        server->closed_head = conn;
+    }
+}
+
+static void FreeConnection(struct Connection *conn) {
+    free(conn->in.data);
+    free(conn->out.data);
+    free(conn->ready);
+    free(conn);
+}
+
+// Отправка накопленных ответов
+static void FlushConnection(struct FactorialServer *server,
+                            struct Connection *conn) {
+    while (conn->out_sent < conn->out.len) {
+        ssize_t sent = send(conn->fd, conn->out.data + conn->out_sent,
+                            conn->out.len - conn->out_sent, MSG_NOSIGNAL);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (sent <= 0) {
+            LogMessage(LOG_WARN, "Can't send data to client\n");
+            CloseConnection(server, conn);
+            return;
+        }
+        conn->out_sent += sent;
+        MetricsAdd(METRIC_BYTES_OUT, sent);
+    }
+
+    if (conn->out_sent == conn->out.len) {
+        conn->out.len = 0;
+        conn->out_sent = 0;
+    }
+    UpdateEvents(server, conn);
+}
+
+// Разбор накопленных запросов; false при нарушении протокола
+static bool ProcessInput(struct FactorialServer *server, struct Connection *conn) {
+    while (!conn->closed && conn->in_flight < MAX_IN_FLIGHT && !conn->backlog_head) {
+        if (conn->protocol == PROTOCOL_UNKNOWN) {
+            if (conn->in.len < 4)
+                return true;
+            conn->protocol = ProtocolHasMagic(conn->in.data) ? PROTOCOL_FRAMED
+                                                             : PROTOCOL_LEGACY;
+        }
+
+        if (conn->protocol == PROTOCOL_LEGACY) {
+            if (conn->in_flight > 0 || conn->in.len < REQUEST_SIZE)
+                return true;
+
+            // Разбираем данные из буфера
+            struct RangeItem item = {0, 0, 0, 0};
+            memcpy(&item.begin, conn->in.data, sizeof(uint64_t));
+            memcpy(&item.end, conn->in.data + sizeof(uint64_t), sizeof(uint64_t));
+            memcpy(&item.mod, conn->in.data + 2 * sizeof(uint64_t), sizeof(uint64_t));
+            BufferConsume(&conn->in, REQUEST_SIZE);
+
+            if (!StartRequest(server, conn, &item))
+                return false;
+            continue;
+        }
+
+        if (conn->in.len < PROTOCOL_HEADER_SIZE)
+            return true;
+
+        struct FrameHeader header;
+        if (!DecodeHeader(conn->in.data, &header) || header.type != FRAME_REQUEST) {
+            MetricsAdd(METRIC_BAD_REQUESTS, 1);
+            LogMessage(LOG_WARN, "Client send wrong data format\n");
+            return false;
+        }
+        if (conn->in.len < PROTOCOL_HEADER_SIZE + header.length)
+            return true;
+
+        for (uint32_t i = 0; i < header.count; i++) {
+            struct RangeItem item;
+            DecodeRangeItem(conn->in.data + PROTOCOL_HEADER_SIZE + i * RANGE_ITEM_SIZE,
+                            &item);
+            if (!StartRequest(server, conn, &item)) {
+                struct ResultItem error = {item.id, 0, RESULT_BAD_REQUEST, 0};
+                if (!PushResult(server, conn, &error))
+                    return false;
+            }
+        }
+        BufferConsume(&conn->in, PROTOCOL_HEADER_SIZE + header.length);
+    }
+
+    return true;
+}
+
+// Чтение запросов из сокета
+static void ReadConnection(struct FactorialServer *server,
+                           struct Connection *conn) {
+    if (!BufferReserve(&conn->in, 65536)) {
+        LogMessage(LOG_ERROR, "Memory allocation failed\n");
+        CloseConnection(server, conn);
+        return;
+    }
+
+    ssize_t read_bytes = recv(conn->fd, conn->in.data + conn->in.len,
+                              conn->in.cap - conn->in.len, 0);
+    if (read_bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if (read_bytes < 0)
+        LogMessage(LOG_WARN, "Client read failed\n");
+    if (read_bytes == 0 && conn->in.len > 0)
+        LogMessage(LOG_WARN, "Client send wrong data format\n");
+    if (read_bytes <= 0) {
+        CloseConnection(server, conn);
+        return;
+    }
+    conn->in.len += read_bytes;
+    MetricsAdd(METRIC_BYTES_IN, read_bytes);
+
+    if (!ProcessInput(server, conn)) {
+        CloseConnection(server, conn);
+        return;
+    }
+    UpdateEvents(server, conn);
+}
+
+static void AcceptConnections(struct FactorialServer *server) {
+    while (true) {
+        int client_fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                LogMessage(LOG_WARN, "Could not establish new connection\n");
+            return;
+        }
+
+        struct Connection *conn = calloc(1, sizeof(struct Connection));
+        if (!conn) {
+            LogMessage(LOG_ERROR, "Memory allocation failed\n");
+            close(client_fd);
+            continue;
+        }
+        conn->fd = client_fd;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            LogMessage(LOG_ERROR, "Could not watch new connection\n");
+            close(client_fd);
+            free(conn);
+            continue;
+        }
+        MetricsAdd(METRIC_CONNECTIONS, 1);
+        atomic_fetch_add(&server->active_connections, 1);
+    }
+}
+
+// Упаковка готовых результатов в ответы и их отправка
+static void FlushTouched(struct FactorialServer *server) {
+    while (server->touched_head) {
+        struct Connection *conn = server->touched_head;
+        server->touched_head = conn->next;
+        conn->touched = false;
+
+        if (conn->closed) {
+            conn->ready_num = 0;
+            conn->next = server->closed_head;
+            server->closed_head = conn;
+            continue;
+        }
+
+        size_t frames = (conn->ready_num + PROTOCOL_MAX_ITEMS - 1) / PROTOCOL_MAX_ITEMS;
+        if (!BufferReserve(&conn->out, frames * PROTOCOL_HEADER_SIZE +
+                                           conn->ready_num * RESULT_ITEM_SIZE)) {
+            LogMessage(LOG_ERROR, "Memory allocation failed\n");
+            CloseConnection(server, conn);
+            continue;
+        }
+
+        for (size_t first = 0; first < conn->ready_num; first += PROTOCOL_MAX_ITEMS) {
+            size_t count = conn->ready_num - first;
+            if (count > PROTOCOL_MAX_ITEMS)
+                count = PROTOCOL_MAX_ITEMS;
+
+            struct FrameHeader header = {PROTOCOL_VERSION, FRAME_RESPONSE,
+                                         (uint32_t)(count * RESULT_ITEM_SIZE),
+                                         (uint32_t)count};
+            EncodeHeader(conn->out.data + conn->out.len, &header);
+            conn->out.len += PROTOCOL_HEADER_SIZE;
+            for (size_t i = 0; i < count; i++) {
+                EncodeResultItem(conn->out.data + conn->out.len, &conn->ready[first + i]);
+                conn->out.len += RESULT_ITEM_SIZE;
+            }
+        }
+        conn->ready_num = 0;
+
+        FlushConnection(server, conn);
+    }
+}
+
+// Ответы на запросы, завершённые рабочими потоками
+static void CompleteRequests(struct FactorialServer *server) {
+    uint64_t counter;
+    if (read(server->wake_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+        LogMessage(LOG_ERROR, "Can not read wake counter\n");
+
+    pthread_mutex_lock(&server->done_mutex);
+    struct Request *req = server->done_head;
+    server->done_head = NULL;
+    pthread_mutex_unlock(&server->done_mutex);
+
+    while (req) {
+        struct Request *next = req->next;
+        struct Connection *conn = req->conn;
+
+        LogMessage(LOG_INFO, "Engine: %s\n", FactorialEngineName(req->engine));
+        LogMessage(LOG_INFO, "Total: %llu\n", (unsigned long long)req->total);
+        if (server->use_cache && LogEnabled(LOG_DEBUG)) {
+            uint64_t hits, misses;
+            FactorialCacheStats(&server->cache, &hits, &misses);
+            LogMessage(LOG_DEBUG, "Cache: %llu hits, %llu misses\n",
+                       (unsigned long long)hits, (unsigned long long)misses);
+        }
+
+        conn->in_flight--;
+        if (conn->closed || req->failed) {
+            CloseConnection(server, conn);
+        } else if (conn->protocol == PROTOCOL_LEGACY) {
+            if (BufferReserve(&conn->out, RESPONSE_SIZE)) {
+                memcpy(conn->out.data + conn->out.len, &req->total, RESPONSE_SIZE);
+                conn->out.len += RESPONSE_SIZE;
+                FlushConnection(server, conn);
+            } else {
+                CloseConnection(server, conn);
+            }
+            // Следующий запрос мог прийти вместе с предыдущим
+            if (!conn->closed && !ProcessInput(server, conn))
+                CloseConnection(server, conn);
+            UpdateEvents(server, conn);
+        } else {
+            struct ResultItem item = {req->id, req->total, RESULT_OK, req->engine};
+            if (!PushResult(server, conn, &item))
+                CloseConnection(server, conn);
+        }
+
+        FreeRequest(req);
+        req = next;
+    }
+
+    // Освободились места в пуле и для новых диапазонов, разбираем накопленное
+    DrainBacklog(server);
+    for (struct Connection *conn = server->touched_head; conn; conn = conn->next) {
+        if (!conn->closed && !ProcessInput(server, conn))
+            CloseConnection(server, conn);
+    }
+    FlushTouched(server);
+}
+
+// Освобождение закрытых соединений без диапазонов в работе
+static void ReleaseClosed(struct FactorialServer *server) {
+    struct Connection **link = &server->closed_head;
+    while (*link) {
+        struct Connection *conn = *link;
+        if (conn->in_flight == 0) {
+            *link = conn->next;
+            FreeConnection(conn);
+        } else {
+            link = &conn->next;
+        }
+    }
+}
+
+static void PrintCounter(FILE *out, const char *name, const char *help,
+                         uint64_t value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name,
+            name, (unsigned long long)value);
+}
+
+static void PrintGauge(FILE *out, const char *name, const char *help,
+                       uint64_t value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %llu\n", name, help, name,
+            name, (unsigned long long)value);
+}
+
+// Страница метрик в формате Prometheus, вызывается потоком метрик
+static void RenderMetrics(FILE *out, void *arg) {
+    struct FactorialServer *server = (struct FactorialServer *)arg;
+
+    PrintCounter(out, "factorial_requests_total", "Ranges received.",
+                 MetricsSum(METRIC_REQUESTS));
+    PrintCounter(out, "factorial_bad_requests_total", "Rejected ranges and frames.",
+                 MetricsSum(METRIC_BAD_REQUESTS));
+    PrintCounter(out, "factorial_numbers_total", "Numbers multiplied.",
+                 MetricsSum(METRIC_NUMBERS));
+    PrintCounter(out, "factorial_received_bytes_total", "Bytes read from clients.",
+                 MetricsSum(METRIC_BYTES_IN));
+    PrintCounter(out, "factorial_sent_bytes_total", "Bytes sent to clients.",
+                 MetricsSum(METRIC_BYTES_OUT));
+    PrintCounter(out, "factorial_connections_total", "Accepted connections.",
+                 MetricsSum(METRIC_CONNECTIONS));
+
+    fprintf(out, "# HELP factorial_completed_total Completed ranges by engine.\n"
+                 "# TYPE factorial_completed_total counter\n");
+    for (int engine = FACTORIAL_ENGINE_LINEAR; engine <= FACTORIAL_ENGINE_SQRT; engine++) {
+        fprintf(out, "factorial_completed_total{engine=\"%s\"} %llu\n",
+                FactorialEngineName(engine),
+                (unsigned long long)MetricsSum(METRIC_ENGINE_LINEAR + engine));
+    }
+
+    PrintGauge(out, "factorial_active_connections", "Open client connections.",
+               (uint64_t)atomic_load(&server->active_connections));
+    PrintGauge(out, "factorial_queue_depth", "Tasks waiting for a worker thread.",
+               server->use_pool ? ThreadPoolQueueDepth(&server->pool) : 0);
+
+    struct LatencyHistogram *latency = malloc(sizeof(struct LatencyHistogram));
+    if (latency) {
+        static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+        MetricsLatencySnapshot(latency);
+        fprintf(out, "# HELP factorial_request_latency_seconds Time from receiving "
+                     "a range to its result.\n"
+                     "# TYPE factorial_request_latency_seconds summary\n");
+        for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+            fprintf(out, "factorial_request_latency_seconds{quantile=\"%g\"} %.6f\n",
+                    quantiles[i], LatencyQuantile(latency, quantiles[i]) / 1e6);
+        }
+        fprintf(out, "factorial_request_latency_seconds_sum %.6f\n"
+                     "factorial_request_latency_seconds_count %llu\n",
+                latency->sum / 1e6, (unsigned long long)latency->total);
+        free(latency);
+    }
+
+    if (server->use_cache) {
+        uint64_t hits, misses;
+        FactorialCacheStats(&server->cache, &hits, &misses);
+        PrintCounter(out, "factorial_cache_hits_total", "Blocks found in the cache.",
+                     hits);
+        PrintCounter(out, "factorial_cache_misses_total", "Blocks computed and cached.",
+                     misses);
+    }
+
+    PrintCounter(out, "factorial_log_dropped_total",
+                 "Log messages dropped by the rate limit or a full buffer.",
+                 LogDropped());
 }
 
 int main(int argc, char **argv) {
     int tnum = -1;
     int port = -1;
+    bool use_pool = true;
+    bool use_cache = false;
+    const char *cache_file = NULL;
+    uint64_t cache_entries = FACTORIAL_CACHE_DEFAULT_ENTRIES;
+    int metrics_port = -1;
+    enum LogLevel log_level = LOG_INFO;
+    uint64_t log_rate = 1000;
 
     // Обработка аргументов командной строки
     while (true) {
@@ -50,6 +869,13 @@ int main(int argc, char **argv) {
         static struct option options[] = {
             {"port", required_argument, 0, 0},
             {"tnum", required_argument, 0, 0},
+            {"no_pool", no_argument, 0, 0},
+            {"cache", no_argument, 0, 0},
+            {"cache_file", required_argument, 0, 0},
+            {"cache_entries", required_argument, 0, 0},
+            {"metrics_port", required_argument, 0, 0},
+            {"log_level", required_argument, 0, 0},
+            {"log_rate", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -68,6 +894,39 @@ int main(int argc, char **argv) {
                     case 1:
                         tnum = atoi(optarg);
                         break;
+                    case 2:
+                        use_pool = false;
+                        break;
+                    case 3:
+                        use_cache = true;
+                        break;
+                    case 4:
+                        use_cache = true;
+                        cache_file = optarg;
+                        break;
+                    case 5:
+                        if (!ConvertStringToUI64(optarg, &cache_entries) ||
+                            cache_entries == 0 || cache_entries > (1ULL << 30)) {
+                            fprintf(stderr, "Invalid cache_entries value: %s\n", optarg);
+                            return 1;
+                        }
+                        break;
+                    case 6:
+                        metrics_port = atoi(optarg);
+                        break;
+                    case 7:
+                        if (!LogParseLevel(optarg, &log_level)) {
+                            fprintf(stderr, "Invalid log_level value: %s\n", optarg);
+                            return 1;
+                        }
+                        break;
+                    case 8:
+                        if (!ConvertStringToUI64(optarg, &log_rate) ||
+                            log_rate > UINT32_MAX) {
+                            fprintf(stderr, "Invalid log_rate value: %s\n", optarg);
+                            return 1;
+                        }
+                        break;
                     default:
                         printf("Index %d is out of options\n", option_index);
                 }
@@ -81,12 +940,33 @@ int main(int argc, char **argv) {
         }
     }
 
-    if (port == -1 || tnum == -1) {
-        fprintf(stderr, "Using: %s --port 20001 --tnum 4\n", argv[0]);
+    if (port == -1 || tnum <= 0) {
+        fprintf(stderr, "Using: %s --port 20001 --tnum 4 [--no_pool] [--cache] "
+                "[--cache_file path] [--cache_entries N] [--metrics_port N] "
+                "[--log_level error|warn|info|debug] [--log_rate N]\n", argv[0]);
         return 1;
     }
 
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct FactorialServer fserver;
+    memset(&fserver, 0, sizeof(fserver));
+    fserver.tnum = tnum;
+    fserver.use_pool = use_pool;
+    pthread_mutex_init(&fserver.done_mutex, NULL);
+
+    // Кэш блоков, при заданном файле сохраняется между запусками
+    fserver.use_cache = use_cache;
+    if (use_cache && !FactorialCacheOpen(&fserver.cache, cache_file, cache_entries)) {
+        fprintf(stderr, "Can not open factorial cache\n");
+        return 1;
+    }
+
+    // Рабочие потоки создаются один раз на всё время работы сервера
+    if (use_pool && !ThreadPoolInit(&fserver.pool, tnum, 1024 + 4 * (size_t)tnum)) {
+        fprintf(stderr, "Can not create thread pool\n");
+        return 1;
+    }
+
+    int server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     if (server_fd < 0) {
         fprintf(stderr, "Can not create server socket!");
         return 1;
@@ -106,130 +986,89 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    err = listen(server_fd, 128);
+    err = listen(server_fd, SOMAXCONN);
     if (err < 0) {
         fprintf(stderr, "Could not listen on socket\n");
         return 1;
     }
 
-    printf("Server listening at %d\n", port);
+    fserver.listen_fd = server_fd;
+    fserver.epoll_fd = epoll_create1(0);
+    fserver.wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (fserver.epoll_fd < 0 || fserver.wake_fd < 0) {
+        fprintf(stderr, "Can not create epoll instance\n");
+        return 1;
+    }
 
-    // Основной цикл обработки клиентских соединений
-    while (true) {
-        struct sockaddr_in client;
-        socklen_t client_len = sizeof(client);
-        int client_fd = accept(server_fd, (struct sockaddr *)&client, &client_len);
+    // Слушающий сокет и eventfd отличаются от соединений указателем на fserver
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &fserver.listen_fd;
+    epoll_ctl(fserver.epoll_fd, EPOLL_CTL_ADD, server_fd, &ev);
+    ev.data.ptr = &fserver.wake_fd;
+    epoll_ctl(fserver.epoll_fd, EPOLL_CTL_ADD, fserver.wake_fd, &ev);
 
-        if (client_fd < 0) {
-            fprintf(stderr, "Could not establish new connection\n");
-            continue;
+    // Журнал пишется отдельным потоком, метрики отдаются на своём порту
+    if (!LogInit(log_level, (uint32_t)log_rate)) {
+        fprintf(stderr, "Can not start logger\n");
+        return 1;
+    }
+    if (metrics_port > 0) {
+        if (!MetricsServe(metrics_port, RenderMetrics, &fserver)) {
+            fprintf(stderr, "Can not serve metrics at %d\n", metrics_port);
+            return 1;
         }
+        LogMessage(LOG_INFO, "Metrics at http://127.0.0.1:%d/metrics\n", metrics_port);
+    }
 
-        // Цикл обработки данных от клиента
-        while (true) {
-            unsigned int buffer_size = sizeof(uint64_t) * 3;
-            char from_client[buffer_size];
-            int read_bytes = recv(client_fd, from_client, buffer_size, 0);
-
-            if (!read_bytes)
-                break;
-            if (read_bytes < 0) {
-                fprintf(stderr, "Client read failed\n");
-                break;
-            }
-            if (read_bytes < buffer_size) {
-                fprintf(stderr, "Client send wrong data format\n");
-                break;
-            }
-
-            // Разбираем данные из буфера
-            uint64_t begin = 0;
-            uint64_t end = 0;
-            uint64_t mod = 0;
-            memcpy(&begin, from_client, sizeof(uint64_t));
-            memcpy(&end, from_client + sizeof(uint64_t), sizeof(uint64_t));
-            memcpy(&mod, from_client + 2 * sizeof(uint64_t), sizeof(uint64_t));
-
-            fprintf(stdout, "Receive: %llu %llu %llu\n", begin, end, mod);
-
-            // Проверяем и корректируем диапазон
-            if (begin > end) {
-                uint64_t temp = begin;
-                begin = end;
-                end = temp;
-            }
-
-            // Вычисляем общее количество чисел
-            uint64_t total_numbers = end - begin + 1;
-            
-            // Защита от tnum > total_numbers
-            int actual_tnum = tnum;
-            if (actual_tnum > total_numbers) {
-                actual_tnum = total_numbers;
-            }
-            if (actual_tnum == 0) {
-                actual_tnum = 1;
-            }
-
-            pthread_t threads[actual_tnum];
-            struct FactorialArgs args[actual_tnum];
+    LogMessage(LOG_INFO, "Server listening at %d\n", port);
 
-            uint64_t range_size = total_numbers / actual_tnum;
-            uint64_t remainder = total_numbers % actual_tnum;
+    // Цикл событий: приём соединений, чтение запросов и отправка ответов
+    struct epoll_event events[MAX_EVENTS];
+    while (true) {
+        int ready = epoll_wait(fserver.epoll_fd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "epoll_wait failed\n");
+            break;
+        }
 
-            uint64_t current = begin;
-            for (int i = 0; i < actual_tnum; i++) {
-                args[i].begin = current;
-                args[i].end = current + range_size - 1;
-                
-                if (remainder > 0) {
-                    args[i].end++;
-                    remainder--;
-                }
-                
-                // Гарантируем корректность диапазона
-                if (args[i].end < args[i].begin) {
-                    args[i].end = args[i].begin;
-                }
-                
-                args[i].mod = mod;
-                
-                fprintf(stdout, "Thread %d: %llu..%llu mod %llu\n", 
-                        i, args[i].begin, args[i].end, args[i].mod);
-                
-                if (pthread_create(&threads[i], NULL, ThreadFactorial, 
-                                  (void *)&args[i])) {
-                    fprintf(stderr, "Error: pthread_create failed!\n");
-                    return 1;
-                }
-                
-                current = args[i].end + 1;
+        for (int i = 0; i < ready; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &fserver.listen_fd) {
+                AcceptConnections(&fserver);
+                continue;
             }
-
-            // Собираем результаты
-            uint64_t total = 1;
-            for (int i = 0; i < actual_tnum; i++) {
-                void *thread_result;
-                pthread_join(threads[i], &thread_result);
-                
-                uint64_t result = (uint64_t)(uintptr_t)thread_result;
-                total = MultModulo(total, result, mod);
+            if (ptr == &fserver.wake_fd) {
+                CompleteRequests(&fserver);
+                continue;
             }
 
-            printf("Total: %llu\n", total);
-
-            char buffer[sizeof(total)];
-            memcpy(buffer, &total, sizeof(total));
-            err = send(client_fd, buffer, sizeof(total), 0);
-            if (err < 0) {
-                fprintf(stderr, "Can't send data to client\n");
-                break;
+            // Соединение могло быть закрыто раньше в этой же итерации
+            struct Connection *conn = (struct Connection *)ptr;
+            uint32_t revents = events[i].events;
+            if (conn->closed)
+                continue;
+            if (revents & (EPOLLERR | EPOLLHUP)) {
+                CloseConnection(&fserver, conn);
+                continue;
             }
+            if (revents & EPOLLOUT)
+                FlushConnection(&fserver, conn);
+            if ((revents & EPOLLIN) && !conn->closed)
+                ReadConnection(&fserver, conn);
         }
 
-        shutdown(client_fd, SHUT_RDWR);
-        close(client_fd);
+        // Ошибки в кадрах запросов дают ответы без участия рабочих потоков
+        FlushTouched(&fserver);
+        ReleaseClosed(&fserver);
     }
 
+    if (use_pool)
+        ThreadPoolDestroy(&fserver.pool);
+    if (use_cache)
+        FactorialCacheClose(&fserver.cache);
+    LogShutdown();
     return 0;
-}
\ No newline at end of file
+}
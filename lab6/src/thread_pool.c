@@ -0,0 +1,162 @@
+#include "thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void TaskGroupInit(struct TaskGroup *group, int pending) {
+    pthread_mutex_init(&group->mutex, NULL);
+    pthread_cond_init(&group->done, NULL);
+    group->pending = pending;
+    group->on_done = NULL;
+    group->on_done_arg = NULL;
+}
+
+void TaskGroupSetCallback(struct TaskGroup *group, ThreadPoolFunc on_done,
+                          void *arg) {
+    group->on_done = on_done;
+    group->on_done_arg = arg;
+}
+
+void TaskGroupWait(struct TaskGroup *group) {
+    pthread_mutex_lock(&group->mutex);
+    while (group->pending > 0)
+        pthread_cond_wait(&group->done, &group->mutex);
+    pthread_mutex_unlock(&group->mutex);
+}
+
+void TaskGroupDestroy(struct TaskGroup *group) {
+    pthread_cond_destroy(&group->done);
+    pthread_mutex_destroy(&group->mutex);
+}
+
+void TaskGroupFinishOne(struct TaskGroup *group) {
+    pthread_mutex_lock(&group->mutex);
+    bool last = --group->pending == 0;
+    ThreadPoolFunc on_done = group->on_done;
+    void *on_done_arg = group->on_done_arg;
+    if (last && !on_done)
+        pthread_cond_signal(&group->done);
+    pthread_mutex_unlock(&group->mutex);
+
+    // После разблокировки группа может быть уже освобождена
+    if (last && on_done)
+        on_done(on_done_arg);
+}
+
+static void *ThreadPoolWorker(void *arg) {
+    struct ThreadPool *pool = (struct ThreadPool *)arg;
+
+    while (true) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->count == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->not_empty, &pool->mutex);
+
+        if (pool->count == 0) {
+            // Очередь пуста и пул останавливается
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+
+        struct ThreadPoolTask task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->mutex);
+
+        task.func(task.arg);
+        if (task.group)
+            TaskGroupFinishOne(task.group);
+    }
+
+    return NULL;
+}
+
+bool ThreadPoolInit(struct ThreadPool *pool, int threads_num, size_t capacity) {
+    pool->threads = malloc(sizeof(pthread_t) * threads_num);
+    pool->queue = malloc(sizeof(struct ThreadPoolTask) * capacity);
+    if (!pool->threads || !pool->queue) {
+        free(pool->threads);
+        free(pool->queue);
+        return false;
+    }
+
+    pool->threads_num = 0;
+    pool->capacity = capacity;
+    pool->head = 0;
+    pool->count = 0;
+    pool->stopping = false;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+
+    for (int i = 0; i < threads_num; i++) {
+        if (pthread_create(&pool->threads[i], NULL, ThreadPoolWorker, pool)) {
+            fprintf(stderr, "Error: pthread_create failed!\n");
+            ThreadPoolDestroy(pool);
+            return false;
+        }
+        pool->threads_num++;
+    }
+
+    return true;
+}
+
+// Вызывается под mutex при свободном месте в очереди
+static void PushTask(struct ThreadPool *pool, ThreadPoolFunc func, void *arg,
+                     struct TaskGroup *group) {
+    size_t tail = (pool->head + pool->count) % pool->capacity;
+    pool->queue[tail].func = func;
+    pool->queue[tail].arg = arg;
+    pool->queue[tail].group = group;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+}
+
+void ThreadPoolSubmit(struct ThreadPool *pool, ThreadPoolFunc func, void *arg,
+                      struct TaskGroup *group) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->count == pool->capacity)
+        pthread_cond_wait(&pool->not_full, &pool->mutex);
+    PushTask(pool, func, arg, group);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+bool ThreadPoolTrySubmit(struct ThreadPool *pool, ThreadPoolFunc func, void *arg,
+                         struct TaskGroup *group) {
+    pthread_mutex_lock(&pool->mutex);
+    bool has_room = pool->count < pool->capacity;
+    if (has_room)
+        PushTask(pool, func, arg, group);
+    pthread_mutex_unlock(&pool->mutex);
+    return has_room;
+}
+
+size_t ThreadPoolFreeSlots(struct ThreadPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    size_t free_slots = pool->capacity - pool->count;
+    pthread_mutex_unlock(&pool->mutex);
+    return free_slots;
+}
+
+size_t ThreadPoolQueueDepth(struct ThreadPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    size_t depth = pool->count;
+    pthread_mutex_unlock(&pool->mutex);
+    return depth;
+}
+
+void ThreadPoolDestroy(struct ThreadPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->threads_num; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->not_full);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool->queue);
+}
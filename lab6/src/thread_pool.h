@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*ThreadPoolFunc)(void *arg);
+
+// Счётчик завершения группы задач одного запроса
+struct TaskGroup {
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+    int pending;
+
+    // Вызывается в потоке, завершившем последнюю задачу группы,
+    // вместо пробуждения TaskGroupWait. Может освобождать группу.
+    ThreadPoolFunc on_done;
+    void *on_done_arg;
+};
+
+struct ThreadPoolTask {
+    ThreadPoolFunc func;
+    void *arg;
+    struct TaskGroup *group;  // может быть NULL
+};
+
+// Пул потоков фиксированного размера с ограниченной очередью задач
+struct ThreadPool {
+    pthread_t *threads;
+    int threads_num;
+
+    struct ThreadPoolTask *queue;  // кольцевой буфер
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    bool stopping;
+};
+
+void TaskGroupInit(struct TaskGroup *group, int pending);
+void TaskGroupSetCallback(struct TaskGroup *group, ThreadPoolFunc on_done,
+                          void *arg);
+void TaskGroupWait(struct TaskGroup *group);
+
+// Отметка о завершении одной задачи группы
+void TaskGroupFinishOne(struct TaskGroup *group);
+void TaskGroupDestroy(struct TaskGroup *group);
+
+// Запуск threads_num потоков, false при ошибке
+bool ThreadPoolInit(struct ThreadPool *pool, int threads_num, size_t capacity);
+
+// Постановка задачи в очередь, блокируется при заполненной очереди
+void ThreadPoolSubmit(struct ThreadPool *pool, ThreadPoolFunc func, void *arg,
+                      struct TaskGroup *group);
+
+// То же без ожидания: false, если очередь заполнена
+bool ThreadPoolTrySubmit(struct ThreadPool *pool, ThreadPoolFunc func, void *arg,
+                         struct TaskGroup *group);
+
+// Свободные места в очереди. Если задачи ставит один поток, столько
+// задач подряд встанут без ожидания: рабочие потоки места только освобождают.
+size_t ThreadPoolFreeSlots(struct ThreadPool *pool);
+
+// Число задач, ждущих в очереди
+size_t ThreadPoolQueueDepth(struct ThreadPool *pool);
+
+// Дожидается выполнения поставленных задач и останавливает потоки
+void ThreadPoolDestroy(struct ThreadPool *pool);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,184 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "work_queue.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+static double NowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool WorkQueueInit(struct WorkQueue *queue, uint64_t begin, uint64_t end,
+                   const struct ModContext *ctx, int workers) {
+    queue->items_capacity = 64;
+    queue->items = malloc(sizeof(struct WorkItem) * queue->items_capacity);
+    queue->retry = malloc(sizeof(size_t) * queue->items_capacity);
+    if (!queue->items || !queue->retry) {
+        free(queue->items);
+        free(queue->retry);
+        return false;
+    }
+
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->next = begin;
+    queue->last = end;
+    queue->total = begin <= end ? end - begin + 1 : 0;
+    queue->workers = workers > 0 ? workers : 1;
+    queue->active = workers;
+    queue->items_num = 0;
+    queue->retry_num = 0;
+    queue->ctx = ctx;
+    queue->product = 1 % ctx->mod;
+    queue->covered = 0;
+    return true;
+}
+
+void WorkQueueDestroy(struct WorkQueue *queue) {
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->items);
+    free(queue->retry);
+}
+
+// Отрезание нового участка от ещё не выданной части диапазона
+static bool TakeFresh(struct WorkQueue *queue, uint64_t want, size_t *id) {
+    // next == 0 после выдачи участка, заканчивающегося на UINT64_MAX
+    if (queue->next == 0 || queue->next > queue->last)
+        return false;
+
+    if (queue->items_num == queue->items_capacity) {
+        size_t capacity = queue->items_capacity * 2;
+        struct WorkItem *items = realloc(queue->items, sizeof(struct WorkItem) * capacity);
+        if (!items)
+            return false;
+        queue->items = items;
+        size_t *retry = realloc(queue->retry, sizeof(size_t) * capacity);
+        if (!retry)
+            return false;
+        queue->retry = retry;
+        queue->items_capacity = capacity;
+    }
+
+    // Не больше половины доли остатка на соединение
+    uint64_t left = queue->last - queue->next + 1;
+    uint64_t share = left / (2 * (uint64_t)queue->workers);
+    uint64_t size = want < share ? want : share;
+    if (size == 0)
+        size = 1;
+    if (size > left)
+        size = left;
+
+    struct WorkItem *item = &queue->items[queue->items_num];
+    item->range.begin = queue->next;
+    item->range.end = queue->next + (size - 1);
+    item->state = WORK_RUNNING;
+    item->copies = 0;
+    item->started_at = NowSeconds();
+    queue->next = item->range.end + 1;
+    *id = queue->items_num++;
+    return true;
+}
+
+// Самый старый участок, который считает только один сервер
+static bool TakeStraggler(struct WorkQueue *queue, size_t *id) {
+    bool found = false;
+    for (size_t i = 0; i < queue->items_num; i++) {
+        const struct WorkItem *item = &queue->items[i];
+        if (item->state != WORK_RUNNING || item->copies != 1)
+            continue;
+        if (!found || item->started_at < queue->items[*id].started_at) {
+            *id = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool WorkQueueTake(struct WorkQueue *queue, uint64_t want, bool wait,
+                   bool speculate, size_t *id, struct WorkRange *range) {
+    pthread_mutex_lock(&queue->mutex);
+
+    bool taken = false;
+    while (queue->covered < queue->total) {
+        if (queue->retry_num > 0) {
+            *id = queue->retry[--queue->retry_num];
+            queue->items[*id].state = WORK_RUNNING;
+            taken = true;
+        } else {
+            taken = TakeFresh(queue, want, id) ||
+                    (wait && speculate && TakeStraggler(queue, id));
+        }
+        if (taken || !wait)
+            break;
+        pthread_cond_wait(&queue->changed, &queue->mutex);
+    }
+
+    if (taken) {
+        queue->items[*id].copies++;
+        *range = queue->items[*id].range;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return taken;
+}
+
+void WorkQueueComplete(struct WorkQueue *queue, size_t id, uint64_t result) {
+    pthread_mutex_lock(&queue->mutex);
+    struct WorkItem *item = &queue->items[id];
+    item->copies--;
+    if (item->state != WORK_DONE) {
+        item->state = WORK_DONE;
+        queue->product = ModMul(queue->ctx, queue->product, result);
+        queue->covered += item->range.end - item->range.begin + 1;
+    }
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void WorkQueueFail(struct WorkQueue *queue, size_t id) {
+    pthread_mutex_lock(&queue->mutex);
+    struct WorkItem *item = &queue->items[id];
+    item->copies--;
+    if (item->state == WORK_RUNNING && item->copies == 0) {
+        item->state = WORK_PENDING;
+        queue->retry[queue->retry_num++] = id;
+    }
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+bool WorkQueueFinished(struct WorkQueue *queue) {
+    pthread_mutex_lock(&queue->mutex);
+    bool finished = queue->covered == queue->total;
+    pthread_mutex_unlock(&queue->mutex);
+    return finished;
+}
+
+void WorkQueueLeave(struct WorkQueue *queue) {
+    pthread_mutex_lock(&queue->mutex);
+    queue->active--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void WorkQueueWait(struct WorkQueue *queue) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->covered < queue->total && queue->active > 0)
+        pthread_cond_wait(&queue->changed, &queue->mutex);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+uint64_t WorkChunkSize(double rate, uint64_t target_ms, uint64_t min_chunk) {
+    if (rate <= 0)
+        return min_chunk;
+
+    double size = rate * (double)target_ms / 1000.0;
+    if (size < (double)min_chunk)
+        return min_chunk;
+    if (size >= 1e18)
+        return UINT64_MAX;
+    return (uint64_t)size;
+}
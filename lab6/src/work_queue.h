@@ -0,0 +1,90 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mod_arith.h"
+
+// Участок диапазона, выданный одному серверу
+struct WorkRange {
+    uint64_t begin;
+    uint64_t end;
+};
+
+enum WorkState {
+    WORK_PENDING,  // ждёт повторной выдачи после ошибки
+    WORK_RUNNING,  // считается хотя бы одним сервером
+    WORK_DONE
+};
+
+struct WorkItem {
+    struct WorkRange range;
+    enum WorkState state;
+    int copies;         // сколько серверов сейчас считают участок
+    double started_at;  // время первой выдачи
+};
+
+// Общая очередь работы клиента: соединения с серверами забирают
+// участки [begin, end] по мере освобождения, поэтому быстрые серверы
+// получают больше работы, чем медленные. Участки упавших серверов
+// возвращаются в очередь и выдаются заново.
+struct WorkQueue {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;  // участок завершён или возвращён
+    uint64_t next;  // первое ещё не выданное число
+    uint64_t last;
+    uint64_t total;  // сколько чисел нужно покрыть
+    int workers;     // число соединений, делящих очередь
+    int active;      // сколько из них ещё работает
+
+    struct WorkItem *items;  // номер участка - индекс
+    size_t items_num;
+    size_t items_capacity;
+    size_t *retry;  // стек номеров участков WORK_PENDING
+    size_t retry_num;
+
+    const struct ModContext *ctx;
+    uint64_t product;  // произведение всех завершённых участков
+    uint64_t covered;  // сколько чисел в него вошло
+};
+
+bool WorkQueueInit(struct WorkQueue *queue, uint64_t begin, uint64_t end,
+                   const struct ModContext *ctx, int workers);
+void WorkQueueDestroy(struct WorkQueue *queue);
+
+// Выдача участка длиной не больше want, false если выдавать нечего.
+// Сначала выдаются возвращённые участки, затем новые; ближе к концу
+// участки уменьшаются, чтобы серверы закончили вместе.
+//
+// С wait == true вызов ждёт, пока другие серверы завершат или вернут
+// свои участки, и возвращает false только когда всё посчитано. Если
+// при этом speculate == true, простаивающий сервер вместо ожидания
+// получает копию дольше всех считающегося участка.
+bool WorkQueueTake(struct WorkQueue *queue, uint64_t want, bool wait,
+                   bool speculate, size_t *id, struct WorkRange *range);
+
+// Учёт результата участка, повторный результат той же части игнорируется
+void WorkQueueComplete(struct WorkQueue *queue, size_t id, uint64_t result);
+
+// Участок не посчитан: если других копий нет, он вернётся в очередь
+void WorkQueueFail(struct WorkQueue *queue, size_t id);
+
+// Все ли числа покрыты результатами
+bool WorkQueueFinished(struct WorkQueue *queue);
+
+// Соединение прекратило работу с очередью
+void WorkQueueLeave(struct WorkQueue *queue);
+
+// Ожидание, пока всё посчитано или не осталось работающих соединений.
+// Соединения, ждущие ответа на дублированный участок, после этого можно
+// прервать.
+void WorkQueueWait(struct WorkQueue *queue);
+
+// Размер участка, который сервер с производительностью rate (чисел в
+// секунду, 0 - ещё не измерена) посчитает примерно за target_ms
+uint64_t WorkChunkSize(double rate, uint64_t target_ms, uint64_t min_chunk);
+
+#endif // WORK_QUEUE_H
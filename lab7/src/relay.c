@@ -0,0 +1,530 @@
+#define _GNU_SOURCE
+
+#include "relay.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#define SADDR struct sockaddr
+// Сколько порций подряд обрабатывается в одном событии
+#define CHUNKS_PER_EVENT 16
+
+// Запись в общий файл или pipe из всех потоков
+static pthread_mutex_t target_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Буфер эха MSG_ZEROCOPY: ядро отправляет прямо из этих страниц, поэтому
+// буфер нельзя трогать, пока не придёт уведомление с его номером
+struct ZeroCopyChunk {
+  struct ZeroCopyChunk *next;
+  uint32_t last_id;  // номер последнего send, который ссылается на буфер
+  size_t len;
+  size_t sent;
+  char data[];
+};
+
+static bool ZeroCopyEcho(const struct ServerConfig *config) {
+  return config->mode == SINK_ECHO && config->zerocopy;
+}
+
+bool RelayHandles(const struct ServerConfig *config) {
+  return config->mode >= SINK_RELAY || ZeroCopyEcho(config);
+}
+
+// host:port, если строка так разбирается
+static bool ParseAddress(const char *target, struct sockaddr_in *addr) {
+  const char *colon = strrchr(target, ':');
+  if (!colon || colon == target) return false;
+
+  char host[64];
+  size_t host_len = colon - target;
+  if (host_len >= sizeof(host)) return false;
+  memcpy(host, target, host_len);
+  host[host_len] = '\0';
+
+  char *end;
+  long port = strtol(colon + 1, &end, 10);
+  if (*end != '\0' || port <= 0 || port > 65535) return false;
+
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(port);
+  return inet_pton(AF_INET, host, &addr->sin_addr) == 1;
+}
+
+bool RelayConfigure(struct ServerConfig *config) {
+  config->target_fd = -1;
+
+  if (config->tee && config->mode != SINK_SPLICE) {
+    fprintf(stderr, "--tee works only with --mode splice\n");
+    return false;
+  }
+  if (config->zerocopy && config->mode != SINK_ECHO) {
+    fprintf(stderr, "--zerocopy works only with --mode echo\n");
+    return false;
+  }
+  if (config->mode < SINK_RELAY) return true;
+  if (!config->target) {
+    fprintf(stderr, "--target is required for this mode\n");
+    return false;
+  }
+
+  if (config->mode == SINK_DOWNLOAD || config->mode == SINK_SENDFILE) {
+    config->target_fd = open(config->target, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (config->target_fd < 0 || fstat(config->target_fd, &st) < 0 ||
+        !S_ISREG(st.st_mode)) {
+      fprintf(stderr, "Can not read regular file %s\n", config->target);
+      return false;
+    }
+    config->file_size = st.st_size;
+    return true;
+  }
+
+  if (strcmp(config->target, "-") == 0) {
+    config->target_fd = STDOUT_FILENO;
+    return true;
+  }
+  if (ParseAddress(config->target, &config->target_addr)) return true;
+
+  // Без O_APPEND: splice в файл, открытый на дозапись, не поддерживается
+  config->target_fd =
+      open(config->target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (config->target_fd < 0) {
+    perror(config->target);
+    return false;
+  }
+  return true;
+}
+
+static bool OpenPipe(int fds[2], size_t size, size_t *capacity) {
+  if (pipe2(fds, O_CLOEXEC) < 0) {
+    perror("pipe");
+    return false;
+  }
+  // Ёмкость pipe - предел одного splice; больше pipe-max-size не дадут
+  int got = fcntl(fds[1], F_SETPIPE_SZ, (int)size);
+  if (got < 0) got = fcntl(fds[1], F_GETPIPE_SZ);
+  if (capacity) *capacity = got > 0 ? (size_t)got : 65536;
+  return true;
+}
+
+static void ClosePipe(int fds[2]) {
+  if (fds[0] >= 0) close(fds[0]);
+  if (fds[1] >= 0) close(fds[1]);
+  fds[0] = fds[1] = -1;
+}
+
+bool RelayWorkerInit(struct Worker *worker) {
+  worker->pipe[0] = worker->pipe[1] = -1;
+  if (worker->config->mode != SINK_SPLICE) return true;
+  return OpenPipe(worker->pipe, worker->config->bufsize, &worker->pipe_size);
+}
+
+void RelayWorkerDestroy(struct Worker *worker) {
+  ClosePipe(worker->pipe);
+  while (worker->zc_free) {
+    struct ZeroCopyChunk *chunk = worker->zc_free;
+    worker->zc_free = chunk->next;
+    free(chunk);
+  }
+}
+
+bool RelayConnectionInit(struct Worker *worker, struct Connection *conn) {
+  const struct ServerConfig *config = worker->config;
+  conn->target_fd = config->target_fd;
+  conn->echo_pipe[0] = conn->echo_pipe[1] = -1;
+
+  if (ZeroCopyEcho(config)) {
+    int one = 1;
+    if (setsockopt(conn->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+      perror("setsockopt SO_ZEROCOPY");
+      return false;
+    }
+  }
+  if (config->tee && !OpenPipe(conn->echo_pipe, worker->pipe_size, &conn->echo_pipe_size))
+    return false;
+
+  if ((config->mode == SINK_RELAY || config->mode == SINK_SPLICE) &&
+      config->target_fd < 0) {
+    conn->target_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn->target_fd < 0 ||
+        connect(conn->target_fd, (const SADDR *)&config->target_addr,
+                sizeof(config->target_addr)) < 0) {
+      perror("connect to target");
+      return false;
+    }
+  }
+  return true;
+}
+
+void RelayConnectionDestroy(struct Worker *worker, struct Connection *conn) {
+  if (conn->target_fd >= 0 && conn->target_fd != worker->config->target_fd)
+    close(conn->target_fd);
+  ClosePipe(conn->echo_pipe);
+
+  // При закрытии с ошибкой уведомления уже не придут; данные этого
+  // соединения больше не нужны, так что буферы можно переиспользовать
+  while (conn->zc_head) {
+    struct ZeroCopyChunk *chunk = conn->zc_head;
+    conn->zc_head = chunk->next;
+    chunk->next = worker->zc_free;
+    worker->zc_free = chunk;
+  }
+}
+
+bool RelayHasOutput(const struct Worker *worker, const struct Connection *conn) {
+  switch (worker->config->mode) {
+    case SINK_SPLICE:
+      return conn->echo_pipe_len > 0 || conn->pending_sent < conn->pending.len;
+    case SINK_DOWNLOAD:
+    case SINK_SENDFILE:
+      return conn->file_offset < worker->config->file_size;
+    case SINK_ECHO:
+      return conn->zc_tail && conn->zc_tail->sent < conn->zc_tail->len;
+    default:
+      return false;
+  }
+}
+
+// Запись в цель. Общий файл или pipe пишут все потоки, поэтому порция
+// пишется под мьютексом целиком
+static bool LockTarget(struct Worker *worker, struct Connection *conn) {
+  if (conn->target_fd != worker->config->target_fd) return false;
+  pthread_mutex_lock(&target_mutex);
+  return true;
+}
+
+static void UnlockTarget(bool locked) {
+  if (locked) pthread_mutex_unlock(&target_mutex);
+}
+
+// relay: обычный путь с копированием, для сравнения со splice
+static bool RelayCopy(struct Worker *worker, struct Connection *conn) {
+  for (int i = 0; i < CHUNKS_PER_EVENT; i++) {
+    ssize_t nread = recv(conn->fd, worker->buf, worker->config->bufsize, 0);
+    if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (nread < 0 && errno == EINTR) continue;
+    if (nread <= 0) return false;
+    worker->bytes_in += nread;
+
+    struct iovec iov = {worker->buf, nread};
+    bool locked = LockTarget(worker, conn);
+    bool ok = WriteAll(conn->target_fd, &iov, 1);
+    UnlockTarget(locked);
+    if (!ok) return false;
+    worker->bytes_out += nread;
+  }
+  return true;
+}
+
+// Отправка эха из pipe в сокет клиента, затем - того, что не поместилось
+// в pipe эха и было скопировано в pending
+static bool FlushEchoPipe(struct Worker *worker, struct Connection *conn) {
+  while (conn->echo_pipe_len > 0) {
+    ssize_t sent = splice(conn->echo_pipe[0], NULL, conn->fd, NULL,
+                          conn->echo_pipe_len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    conn->echo_pipe_len -= sent;
+    worker->bytes_out += sent;
+  }
+  while (conn->pending_sent < conn->pending.len) {
+    ssize_t sent = send(conn->fd, conn->pending.data + conn->pending_sent,
+                        conn->pending.len - conn->pending_sent, MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    conn->pending_sent += sent;
+    worker->bytes_out += sent;
+  }
+  conn->pending.len = 0;
+  conn->pending_sent = 0;
+  return !conn->read_closed;
+}
+
+// Слив pipe потока в цель. Если не удалось, в pipe могли остаться данные
+// этого клиента - pipe пересоздаётся, чтобы они не попали к следующему
+static bool DrainPipe(struct Worker *worker, struct Connection *conn, size_t len) {
+  bool locked = LockTarget(worker, conn);
+  while (len > 0) {
+    ssize_t moved = splice(worker->pipe[0], NULL, conn->target_fd, NULL, len,
+                           SPLICE_F_MOVE);
+    if (moved < 0 && errno == EINTR) continue;
+    if (moved <= 0) break;
+    len -= moved;
+    worker->bytes_out += moved;
+  }
+  UnlockTarget(locked);
+
+  if (len > 0) {
+    perror("splice to target");
+    ClosePipe(worker->pipe);
+    OpenPipe(worker->pipe, worker->config->bufsize, &worker->pipe_size);
+    return false;
+  }
+  return true;
+}
+
+// Хвост порции, не поместившийся в pipe эха: он копируется из pipe потока
+// в цель и в pending соединения, чтобы pipe потока остался пустым
+static bool CopyPipeTail(struct Worker *worker, struct Connection *conn, size_t len) {
+  while (len > 0) {
+    size_t chunk = len < worker->config->bufsize ? len : worker->config->bufsize;
+    ssize_t got = read(worker->pipe[0], worker->buf, chunk);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) {
+      perror("read pipe");
+      ClosePipe(worker->pipe);
+      OpenPipe(worker->pipe, worker->config->bufsize, &worker->pipe_size);
+      return false;
+    }
+    struct iovec iov = {worker->buf, got};
+    bool locked = LockTarget(worker, conn);
+    bool ok = WriteAll(conn->target_fd, &iov, 1);
+    UnlockTarget(locked);
+    if (!ok || !BufferAppend(&conn->pending, worker->buf, got)) return false;
+    worker->bytes_out += got;
+    len -= got;
+  }
+  return true;
+}
+
+// splice: сокет -> pipe -> цель, данные не покидают ядро. С --tee перед
+// сливом ссылки на те же страницы дублируются в pipe эха
+static bool RelaySplice(struct Worker *worker, struct Connection *conn) {
+  // Без CAP_SYS_RESOURCE F_SETPIPE_SZ отказывает после pipe-user-pages-soft,
+  // и pipe эха остаётся меньше pipe потока
+  size_t limit = worker->pipe_size;
+  if (worker->config->tee && conn->echo_pipe_size < limit) limit = conn->echo_pipe_size;
+
+  for (int i = 0; i < CHUNKS_PER_EVENT; i++) {
+    ssize_t nread = splice(conn->fd, NULL, worker->pipe[1], NULL, limit,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (nread < 0 && errno == EINTR) continue;
+    if (nread <= 0) {
+      // EOF: эхо, которое ещё не ушло, дописывается перед закрытием
+      conn->read_closed = true;
+      return nread == 0 && RelayHasOutput(worker, conn);
+    }
+    worker->bytes_in += nread;
+
+    ssize_t teed = nread;
+    if (worker->config->tee) {
+      // pipe эха пуст (иначе чтение не включено), но tee копирует буферы
+      // pipe целиком, по слоту на буфер: мелкие сегменты TCP займут все
+      // слоты меньшего pipe эха раньше, чем его ёмкость в байтах
+      teed = tee(worker->pipe[0], conn->echo_pipe[1], nread, SPLICE_F_NONBLOCK);
+      if (teed < 0 && errno != EAGAIN) {
+        perror("tee");
+        DrainPipe(worker, conn, nread);
+        return false;
+      }
+      if (teed < 0) teed = 0;
+      conn->echo_pipe_len = teed;
+    }
+    if (!DrainPipe(worker, conn, teed)) return false;
+    if (teed < nread && !CopyPipeTail(worker, conn, nread - teed)) return false;
+
+    if (worker->config->tee) {
+      if (!FlushEchoPipe(worker, conn)) return false;
+      // Следующая порция встала бы в pipe эха раньше неотправленного
+      // хвоста в pending
+      if (RelayHasOutput(worker, conn)) return true;
+    }
+  }
+  return true;
+}
+
+// Уведомления о завершении send с MSG_ZEROCOPY: диапазоны номеров
+// [ee_info, ee_data]. Для TCP они приходят по порядку, поэтому
+// освобождаются буферы из головы очереди.
+bool RelayCompletions(struct Worker *worker, struct Connection *conn) {
+  while (true) {
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(conn->fd, &msg, MSG_ERRQUEUE) < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      return false;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR) continue;
+      struct sock_extended_err serr;
+      memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+      if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) return false;  // ошибка сокета
+
+      uint32_t lo = serr.ee_info, hi = serr.ee_data;
+      worker->zc_completions += hi - lo + 1;
+      // Ядро скопировало данные (например, на loopback) - выигрыша нет
+      if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) worker->zc_copied += hi - lo + 1;
+
+      while (conn->zc_head && conn->zc_head->sent == conn->zc_head->len &&
+             (int32_t)(conn->zc_head->last_id - hi) <= 0) {
+        struct ZeroCopyChunk *chunk = conn->zc_head;
+        conn->zc_head = chunk->next;
+        if (!conn->zc_head) conn->zc_tail = NULL;
+        chunk->next = worker->zc_free;
+        worker->zc_free = chunk;
+      }
+    }
+  }
+  // EPOLLERR без уведомлений в очереди - ошибка самого сокета (например,
+  // RST от клиента). SO_ERROR её сбрасывает, иначе epoll сообщал бы о ней
+  // снова и снова.
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0)
+    return false;
+  // Клиент закрыл соединение: закрываем, когда все буферы вернулись
+  return !(conn->read_closed && !conn->zc_head);
+}
+
+// Клиент закрыл свою сторону и всё эхо в сокете: отвечаем FIN сразу, не
+// дожидаясь уведомлений. Иначе клиент ждёт EOF, его ACK откладывается
+// (delayed ACK, ~40 мс), а без ACK не приходят и уведомления.
+static void ZeroCopyShutdown(struct Connection *conn) {
+  if (conn->read_closed && conn->zc_tail && conn->zc_tail->sent == conn->zc_tail->len)
+    shutdown(conn->fd, SHUT_WR);
+}
+
+static bool ZeroCopySend(struct Worker *worker, struct Connection *conn) {
+  for (struct ZeroCopyChunk *chunk = conn->zc_head; chunk; chunk = chunk->next) {
+    while (chunk->sent < chunk->len) {
+      ssize_t sent = send(conn->fd, chunk->data + chunk->sent,
+                          chunk->len - chunk->sent, MSG_ZEROCOPY | MSG_NOSIGNAL);
+      // ENOBUFS - переполнен лимит уведомлений; ждём их, как и места в сокете
+      if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS))
+        return true;
+      if (sent < 0 && errno == EINTR) continue;
+      if (sent <= 0) return false;
+      chunk->sent += sent;
+      chunk->last_id = conn->zc_next_id++;
+      worker->bytes_out += sent;
+    }
+  }
+  ZeroCopyShutdown(conn);
+  return true;
+}
+
+static bool ZeroCopyEchoRead(struct Worker *worker, struct Connection *conn) {
+  size_t bufsize = worker->config->bufsize;
+  for (int i = 0; i < CHUNKS_PER_EVENT && !RelayHasOutput(worker, conn); i++) {
+    struct ZeroCopyChunk *chunk = worker->zc_free;
+    if (chunk) {
+      worker->zc_free = chunk->next;
+    } else {
+      chunk = malloc(sizeof(struct ZeroCopyChunk) + bufsize);
+      if (!chunk) return false;
+    }
+
+    ssize_t nread = recv(conn->fd, chunk->data, bufsize, 0);
+    if (nread <= 0) {
+      chunk->next = worker->zc_free;
+      worker->zc_free = chunk;
+      if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+      if (nread < 0 && errno == EINTR) continue;
+      if (nread < 0) return false;
+      conn->read_closed = true;
+      ZeroCopyShutdown(conn);
+      return conn->zc_head != NULL;
+    }
+    worker->bytes_in += nread;
+
+    chunk->next = NULL;
+    chunk->len = nread;
+    chunk->sent = 0;
+    if (conn->zc_tail)
+      conn->zc_tail->next = chunk;
+    else
+      conn->zc_head = chunk;
+    conn->zc_tail = chunk;
+    if (!ZeroCopySend(worker, conn)) return false;
+  }
+  return true;
+}
+
+bool RelayRead(struct Worker *worker, struct Connection *conn) {
+  switch (worker->config->mode) {
+    case SINK_RELAY:
+      return RelayCopy(worker, conn);
+    case SINK_SPLICE:
+      return RelaySplice(worker, conn);
+    case SINK_ECHO:
+      return ZeroCopyEchoRead(worker, conn);
+    default:
+      // download/sendfile входящие данные не читают; сюда попадают,
+      // только когда отправлять уже нечего
+      return RelayFlush(worker, conn);
+  }
+}
+
+static bool SendFileCopy(struct Worker *worker, struct Connection *conn) {
+  const struct ServerConfig *config = worker->config;
+  for (int i = 0; i < CHUNKS_PER_EVENT && conn->file_offset < config->file_size; i++) {
+    size_t len = config->file_size - conn->file_offset;
+    if (len > config->bufsize) len = config->bufsize;
+    ssize_t got = pread(config->target_fd, worker->buf, len, conn->file_offset);
+    if (got <= 0) return false;
+
+    ssize_t sent = send(conn->fd, worker->buf, got, MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    conn->file_offset += sent;
+    worker->bytes_out += sent;
+  }
+  return conn->file_offset < config->file_size;
+}
+
+static bool SendFileZeroCopy(struct Worker *worker, struct Connection *conn) {
+  const struct ServerConfig *config = worker->config;
+  for (int i = 0; i < CHUNKS_PER_EVENT && conn->file_offset < config->file_size; i++) {
+    off_t before = conn->file_offset;
+    ssize_t sent = sendfile(conn->fd, config->target_fd, &conn->file_offset,
+                            config->file_size - conn->file_offset);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    worker->bytes_out += conn->file_offset - before;
+  }
+  return conn->file_offset < config->file_size;
+}
+
+bool RelayFlush(struct Worker *worker, struct Connection *conn) {
+  switch (worker->config->mode) {
+    case SINK_SPLICE:
+      return FlushEchoPipe(worker, conn);
+    case SINK_DOWNLOAD:
+      return SendFileCopy(worker, conn);
+    case SINK_SENDFILE:
+      return SendFileZeroCopy(worker, conn);
+    case SINK_ECHO:
+      if (!ZeroCopySend(worker, conn)) return false;
+      return !(conn->read_closed && !conn->zc_head);
+    default:
+      return true;
+  }
+}
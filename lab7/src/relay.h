@@ -0,0 +1,42 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include "tcpserver.h"
+
+// Режимы tcpserver без копирования данных через пространство пользователя.
+//
+//   relay    - клиент -> --target через буфер потока (для сравнения);
+//   splice   - клиент -> pipe -> --target через splice; с --tee данные
+//              ещё и дублируются tee во второй pipe и уходят обратно
+//              клиенту тоже через splice;
+//   download - файл --target -> клиент через pread + send (для сравнения);
+//   sendfile - файл --target -> клиент через sendfile;
+//   echo --zerocopy - эхо через send с MSG_ZEROCOPY: буфер освобождается
+//              только после уведомления из очереди ошибок сокета.
+//
+// --target: путь к файлу, "-" (stdout) или host:port - тогда для каждого
+// клиента открывается своё соединение. Запись в цель блокирующая:
+// медленная цель притормаживает поток, а не копит данные в памяти.
+//
+// Функции обработки возвращают false, если соединение нужно закрыть.
+
+// Разбор и открытие --target; false при неверной комбинации параметров
+bool RelayConfigure(struct ServerConfig *config);
+// Обрабатывает ли relay.c соединения в этом режиме
+bool RelayHandles(const struct ServerConfig *config);
+
+bool RelayWorkerInit(struct Worker *worker);
+void RelayWorkerDestroy(struct Worker *worker);
+
+bool RelayConnectionInit(struct Worker *worker, struct Connection *conn);
+void RelayConnectionDestroy(struct Worker *worker, struct Connection *conn);
+
+bool RelayHasOutput(const struct Worker *worker, const struct Connection *conn);
+// Сокет клиента готов к чтению
+bool RelayRead(struct Worker *worker, struct Connection *conn);
+// Сокет клиента готов к записи
+bool RelayFlush(struct Worker *worker, struct Connection *conn);
+// Уведомления MSG_ZEROCOPY в очереди ошибок
+bool RelayCompletions(struct Worker *worker, struct Connection *conn);
+
+#endif  // RELAY_H
@@ -1,40 +1,560 @@
+#define _GNU_SOURCE
+
 #include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "uring.h"
+
 #define BUFSIZE 100
 #define SADDR struct sockaddr
 #define SIZE sizeof(struct sockaddr_in)
 
+// Нагрузочный режим (--load): --threads потоков, каждый по очереди
+// открывает соединения, передаёт по --bytes байт кусками по --msg и
+// закрывает свою сторону. Ответ сервера читается одновременно с отправкой;
+// с --echo он должен совпасть с отправленным байт в байт (без --echo ответ
+// только считается - так меряется скачивание с --bytes 0). Итог -
+// соединений в секунду и МБ/с.
+//
+// Поток - строки из псевдослучайных букв с периодом PATTERN_PERIOD: байт
+// по смещению o равен pattern[o % PATTERN_PERIOD], поэтому переставленные
+// или потерянные куски эха видны при сравнении. Период - простое число,
+// чтобы не совпадать с размерами буферов и pipe сервера.
+#define PATTERN_PERIOD 65521
+//
+// --engine uring: вместо poll и send/recv на каждый кусок отправки
+// ставятся в io_uring связками по URING_SEND_CHAIN (IOSQE_IO_LINK
+// сохраняет порядок, MSG_WAITALL - целостность куска), а ответ читает
+// один multishot recv в кольцо выданных буферов потока. В интерактивном
+// режиме чтение stdin и запись в сокет тоже связываются попарно, и на
+// системный вызов приходится до URING_CHAIN кусков по BUFSIZE.
+#define URING_ENTRIES 256
+#define URING_SEND_CHAIN 64
+#define URING_CHAIN 32
+#define URING_BUFS 64
+#define URING_BUF_SIZE (64 * 1024)
+
+struct LoadConfig {
+  struct sockaddr_in servaddr;
+  int threads;
+  long connections;
+  size_t bytes;
+  size_t msg;
+  bool echo;
+  bool uring;
+};
+
+// Буфер шаблона длиной PATTERN_PERIOD + PatternTail: кусок отправки или
+// приёма с любого смещения в периоде читается подряд
+static size_t PatternTail(const struct LoadConfig *config) {
+  return config->msg > URING_BUF_SIZE ? config->msg : URING_BUF_SIZE;
+}
+
+static char *CreatePattern(const struct LoadConfig *config) {
+  size_t len = PATTERN_PERIOD + PatternTail(config);
+  char *pattern = malloc(len);
+  if (!pattern) return NULL;
+  uint32_t state = 2463534242u;
+  for (size_t i = 0; i < PATTERN_PERIOD; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    pattern[i] = (i % 64 == 63) ? '\n' : 'a' + state % 26;
+  }
+  for (size_t i = PATTERN_PERIOD; i < len; i++) pattern[i] = pattern[i - PATTERN_PERIOD];
+  return pattern;
+}
+
+// Совпадает ли принятое с отправленным по тому же смещению потока
+static bool EchoMatches(const char *pattern, size_t offset, const char *data,
+                        size_t len) {
+  return memcmp(pattern + offset % PATTERN_PERIOD, data, len) == 0;
+}
+
+struct LoadWorker {
+  const struct LoadConfig *config;
+  long connections;  // сколько соединений сделать этому потоку
+  pthread_t thread;
+  // Номер соединения в user_data: CQE от прошлых соединений отбрасываются
+  uint64_t generation;
+
+  long done;
+  long failed;
+  uint64_t bytes_out;
+  uint64_t bytes_in;
+};
+
+static double NowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Одно соединение нагрузочного режима; false при ошибке или несовпадении эха
+static bool LoadConnection(struct LoadWorker *worker, const char *pattern, char *buf) {
+  const struct LoadConfig *config = worker->config;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  if (connect(fd, (SADDR *)&config->servaddr, SIZE) < 0) {
+    close(fd);
+    return false;
+  }
+
+  size_t sent = 0, received = 0;
+  bool write_closed = false, mismatch = false;
+  while (!mismatch) {
+    if (sent == config->bytes && !write_closed) {
+      shutdown(fd, SHUT_WR);
+      write_closed = true;
+    }
+
+    struct pollfd pfd = {fd, POLLIN | (write_closed ? 0 : POLLOUT), 0};
+    if (poll(&pfd, 1, 10000) <= 0) break;
+
+    if (pfd.revents & POLLOUT) {
+      size_t chunk = config->bytes - sent < config->msg ? config->bytes - sent
+                                                        : config->msg;
+      ssize_t written = send(fd, pattern + sent % PATTERN_PERIOD, chunk,
+                             MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (written < 0 && errno != EAGAIN && errno != EINTR) break;
+      if (written > 0) sent += written;
+    }
+    if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t nread = recv(fd, buf, config->msg, MSG_DONTWAIT);
+      if (nread < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+      if (nread <= 0) break;
+      if (config->echo &&
+          (received + nread > config->bytes ||
+           !EchoMatches(pattern, received, buf, nread)))
+        mismatch = true;
+      received += nread;
+    }
+  }
+  close(fd);
+
+  worker->bytes_out += sent;
+  worker->bytes_in += received;
+  if (mismatch) fprintf(stderr, "Echo mismatch near offset %zu\n", received);
+  return !mismatch && sent == config->bytes &&
+         (!config->echo || received == config->bytes);
+}
+
+enum LoadOp { LOAD_SEND, LOAD_RECV };
+
+static uint64_t LoadTag(uint64_t generation, enum LoadOp op) {
+  return generation << 1 | op;
+}
+
+static bool ArmLoadRecv(struct Uring *ring, const struct UringBufRing *bufs, int fd,
+                        uint64_t generation) {
+  struct io_uring_sqe *sqe = UringGetSqe(ring);
+  if (!sqe) return false;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = bufs->group;
+  sqe->user_data = LoadTag(generation, LOAD_RECV);
+  return true;
+}
+
+// Следующая связка отправок; за последним куском - shutdown(SHUT_WR) в той
+// же связке. Возвращает число поставленных запросов.
+static int QueueLoadSends(struct Uring *ring, int fd, const char *pattern,
+                          const struct LoadConfig *config, size_t *queued,
+                          bool *write_closed, uint64_t generation) {
+  int count = 0;
+  struct io_uring_sqe *sqe = NULL;
+  while (count < URING_SEND_CHAIN && *queued < config->bytes) {
+    size_t chunk = config->bytes - *queued < config->msg ? config->bytes - *queued
+                                                         : config->msg;
+    if (sqe) sqe->flags |= IOSQE_IO_LINK;
+    if (!(sqe = UringGetSqe(ring))) return -1;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)(pattern + *queued % PATTERN_PERIOD);
+    sqe->len = (uint32_t)chunk;
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->user_data = LoadTag(generation, LOAD_SEND);
+    *queued += chunk;
+    count++;
+  }
+  if (*queued == config->bytes) {
+    if (sqe) sqe->flags |= IOSQE_IO_LINK;
+    if (!(sqe = UringGetSqe(ring))) return -1;
+    sqe->opcode = IORING_OP_SHUTDOWN;
+    sqe->fd = fd;
+    sqe->len = SHUT_WR;
+    sqe->user_data = LoadTag(generation, LOAD_SEND);
+    *write_closed = true;
+    count++;
+  }
+  return count;
+}
+
+// То же соединение, что LoadConnection, через io_uring
+static bool LoadConnectionUring(struct LoadWorker *worker, struct Uring *ring,
+                                struct UringBufRing *bufs, const char *pattern) {
+  const struct LoadConfig *config = worker->config;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  if (connect(fd, (SADDR *)&config->servaddr, SIZE) < 0) {
+    close(fd);
+    return false;
+  }
+
+  uint64_t generation = ++worker->generation;
+  size_t queued = 0, sent = 0, received = 0;
+  int sends_inflight = 0;
+  bool write_closed = false;
+  bool recv_armed = ArmLoadRecv(ring, bufs, fd, generation);
+  bool failed = !recv_armed;
+
+  while (!failed && (recv_armed || sends_inflight > 0 || !write_closed)) {
+    if (sends_inflight == 0 && !write_closed) {
+      sends_inflight =
+          QueueLoadSends(ring, fd, pattern, config, &queued, &write_closed, generation);
+      if (sends_inflight < 0) break;
+    }
+
+    if (UringSubmitAndWait(ring, 1, 10000) < 0) break;
+    struct io_uring_cqe *slot = UringPeekCqe(ring);
+    if (!slot) break;  // 10 с без ответа
+    for (; slot; slot = UringPeekCqe(ring)) {
+      struct io_uring_cqe cqe = *slot;
+      UringCqeSeen(ring);
+
+      enum LoadOp op = cqe.user_data & 1;
+      bool current = cqe.user_data >> 1 == generation;
+      // Буфер возвращается, даже если CQE от прошлого соединения
+      if (op == LOAD_RECV && (cqe.flags & IORING_CQE_F_BUFFER)) {
+        uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        if (current && !failed && cqe.res > 0 && config->echo &&
+            (received + cqe.res > config->bytes ||
+             !EchoMatches(pattern, received, UringBufRingData(bufs, bid), cqe.res))) {
+          fprintf(stderr, "Echo mismatch near offset %zu\n", received);
+          failed = true;
+        }
+        UringBufRingRecycle(bufs, bid);
+      }
+      if (!current) continue;
+
+      if (op == LOAD_SEND) {
+        sends_inflight--;
+        if (cqe.res < 0)
+          failed = true;
+        else
+          sent += cqe.res;
+        continue;
+      }
+      if (cqe.res > 0) received += cqe.res;
+      if (cqe.flags & IORING_CQE_F_MORE) continue;
+      // Multishot recv закончился: EOF, ошибка или кончились буферы
+      if (cqe.res > 0 || cqe.res == -ENOBUFS)
+        recv_armed = ArmLoadRecv(ring, bufs, fd, generation);
+      else
+        recv_armed = false;
+      if (cqe.res < 0 && cqe.res != -ENOBUFS) failed = true;
+    }
+  }
+  // Незавершённые запросы доделает shutdown; их CQE придут уже с чужим номером
+  if (recv_armed || sends_inflight > 0) shutdown(fd, SHUT_RDWR);
+  close(fd);
+
+  worker->bytes_out += sent;
+  worker->bytes_in += received;
+  return !failed && sent == config->bytes &&
+         (!config->echo || received == config->bytes);
+}
+
+static void *LoadMain(void *arg) {
+  struct LoadWorker *worker = arg;
+  const struct LoadConfig *config = worker->config;
+  char *pattern = CreatePattern(config);
+  char *buf = malloc(config->msg);
+  if (!pattern || !buf) {
+    worker->failed = worker->connections;
+    free(pattern);
+    free(buf);
+    return NULL;
+  }
+
+  struct Uring ring;
+  struct UringBufRing bufs;
+  if (config->uring) {
+    if (!UringInit(&ring, URING_ENTRIES)) {
+      worker->failed = worker->connections;
+      free(pattern);
+      free(buf);
+      return NULL;
+    }
+    if (!UringBufRingInit(&ring, &bufs, 0, URING_BUFS, URING_BUF_SIZE)) {
+      worker->failed = worker->connections;
+      UringDestroy(&ring);
+      free(pattern);
+      free(buf);
+      return NULL;
+    }
+  }
+
+  for (long i = 0; i < worker->connections; i++) {
+    bool ok = config->uring ? LoadConnectionUring(worker, &ring, &bufs, pattern)
+                            : LoadConnection(worker, pattern, buf);
+    if (ok)
+      worker->done++;
+    else
+      worker->failed++;
+  }
+
+  if (config->uring) {
+    UringDestroy(&ring);
+    UringBufRingDestroy(&bufs);
+  }
+  free(pattern);
+  free(buf);
+  return NULL;
+}
+
+static int RunLoad(struct LoadConfig *config) {
+  struct LoadWorker *workers = calloc(config->threads, sizeof(struct LoadWorker));
+  if (!workers) {
+    fprintf(stderr, "Memory allocation failed\n");
+    return 1;
+  }
+
+  double start = NowSeconds();
+  for (int i = 0; i < config->threads; i++) {
+    workers[i].config = config;
+    workers[i].connections = config->connections / config->threads +
+                             (i < config->connections % config->threads);
+    if (pthread_create(&workers[i].thread, NULL, LoadMain, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+
+  long done = 0, failed = 0;
+  uint64_t bytes_out = 0, bytes_in = 0;
+  for (int i = 0; i < config->threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    done += workers[i].done;
+    failed += workers[i].failed;
+    bytes_out += workers[i].bytes_out;
+    bytes_in += workers[i].bytes_in;
+  }
+  double seconds = NowSeconds() - start;
+
+  printf("Connections: %ld done, %ld failed in %.3f s\n", done, failed, seconds);
+  printf("Connections/s: %.0f\n", done / seconds);
+  printf("Sent: %.1f MB, %.1f MB/s\n", bytes_out / 1e6, bytes_out / 1e6 / seconds);
+  if (bytes_in > 0)
+    printf("Received: %.1f MB, %.1f MB/s\n", bytes_in / 1e6,
+           bytes_in / 1e6 / seconds);
+  printf("Elapsed time: %.3f ms\n", seconds * 1000);
+
+  free(workers);
+  return failed ? 1 : 0;
+}
+
+struct ChainOp {
+  bool read;
+  size_t offset;
+  size_t len;
+};
+
+// stdin -> сокет связками "чтение, запись, чтение, ..." на одном
+// зарегистрированном буфере: связка выполняется строго по порядку, так что
+// следующее чтение не затрёт ещё не отправленное. Короткое чтение (конец
+// строки с терминала, хвост pipe) или короткая запись рвут связку; то, что
+// осталось в буфере, уходит первой записью следующей.
+static int RunInteractiveUring(int fd) {
+  static char buf[BUFSIZE];
+  struct Uring ring;
+  if (!UringInit(&ring, 2 * URING_CHAIN + 1)) return 1;
+  if (!UringRegisterBuffer(&ring, buf, sizeof(buf))) {
+    UringDestroy(&ring);
+    return 1;
+  }
+
+  struct ChainOp ops[2 * URING_CHAIN + 1];
+  int results[2 * URING_CHAIN + 1];
+  size_t pending_offset = 0, pending_len = 0;
+  int status = 0;
+  bool eof = false;
+
+  while (!eof && status == 0) {
+    int count = 0;
+    if (pending_len > 0)
+      ops[count++] = (struct ChainOp){false, pending_offset, pending_len};
+    for (int i = 0; i < URING_CHAIN; i++) {
+      ops[count++] = (struct ChainOp){true, 0, BUFSIZE};
+      ops[count++] = (struct ChainOp){false, 0, BUFSIZE};
+    }
+
+    for (int i = 0; i < count; i++) {
+      struct io_uring_sqe *sqe = UringGetSqe(&ring);
+      sqe->opcode = ops[i].read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+      sqe->fd = ops[i].read ? STDIN_FILENO : fd;
+      sqe->off = ops[i].read ? (uint64_t)-1 : 0;  // stdin - с текущей позиции
+      sqe->addr = (uint64_t)(uintptr_t)(buf + ops[i].offset);
+      sqe->len = (uint32_t)ops[i].len;
+      sqe->buf_index = 0;
+      sqe->flags = i + 1 < count ? IOSQE_IO_LINK : 0;
+      sqe->user_data = i;
+    }
+    // CQE приходят на каждый запрос связки, в том числе отменённые
+    for (int waited = 0; waited < count;) {
+      if (UringSubmitAndWait(&ring, count - waited, -1) < 0) {
+        perror("io_uring_enter");
+        status = 1;
+        break;
+      }
+      struct io_uring_cqe *cqe;
+      while ((cqe = UringPeekCqe(&ring))) {
+        results[cqe->user_data] = cqe->res;
+        UringCqeSeen(&ring);
+        waited++;
+      }
+    }
+
+    pending_len = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+      int res = results[i];
+      if (res == -ECANCELED) break;
+      if (res < 0) {
+        fprintf(stderr, "%s: %s\n", ops[i].read ? "read" : "write", strerror(-res));
+        status = 1;
+        break;
+      }
+      if (ops[i].read) {
+        eof = res == 0;
+        pending_offset = 0;
+        pending_len = res;
+      } else {
+        pending_offset = ops[i].offset + res;
+        pending_len = ops[i].len - res;
+      }
+      if ((size_t)res < ops[i].len) break;
+    }
+  }
+
+  UringDestroy(&ring);
+  return status;
+}
+
 int main(int argc, char *argv[]) {
   int fd;
   int nread;
   char buf[BUFSIZE];
   struct sockaddr_in servaddr;
-  if (argc < 3) {
+  bool load = false;
+  struct LoadConfig config = {.threads = 1,
+                              .connections = 1000,
+                              .bytes = 4096,
+                              .msg = 4096,
+                              .echo = false};
+
+  while (true) {
+    static struct option options[] = {{"load", no_argument, 0, 0},
+                                      {"threads", required_argument, 0, 0},
+                                      {"connections", required_argument, 0, 0},
+                                      {"bytes", required_argument, 0, 0},
+                                      {"msg", required_argument, 0, 0},
+                                      {"echo", no_argument, 0, 0},
+                                      {"engine", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1) break;
+    if (c != 0) exit(1);
+
+    switch (option_index) {
+      case 0:
+        load = true;
+        break;
+      case 1:
+        config.threads = atoi(optarg);
+        if (config.threads <= 0) {
+          printf("threads must be positive\n");
+          exit(1);
+        }
+        break;
+      case 2:
+        config.connections = atol(optarg);
+        if (config.connections <= 0) {
+          printf("connections must be positive\n");
+          exit(1);
+        }
+        break;
+      case 3:
+        config.bytes = strtoull(optarg, NULL, 10);
+        break;
+      case 4:
+        config.msg = strtoull(optarg, NULL, 10);
+        if (config.msg == 0) {
+          printf("msg must be positive\n");
+          exit(1);
+        }
+        break;
+      case 5:
+        config.echo = true;
+        break;
+      case 6:
+        if (strcmp(optarg, "uring") != 0 && strcmp(optarg, "epoll") != 0) {
+          printf("engine must be epoll or uring\n");
+          exit(1);
+        }
+        config.uring = strcmp(optarg, "uring") == 0;
+        break;
+    }
+  }
+
+  if (argc - optind < 2) {
     printf("Too few arguments \n");
+    printf("Usage: %s <ip> <port> [--engine epoll|uring] [--load [--threads 1] "
+           "[--connections 1000] [--bytes 4096] [--msg 4096] [--echo]]\n",
+           argv[0]);
     exit(1);
   }
 
-  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-    perror("socket creating");
-    exit(1);
+  if (config.uring && !UringSupported()) {
+    fprintf(stderr, "io_uring is not available, falling back to epoll\n");
+    config.uring = false;
   }
 
   memset(&servaddr, 0, SIZE);
   servaddr.sin_family = AF_INET;
 
-  if (inet_pton(AF_INET, argv[1], &servaddr.sin_addr) <= 0) {
+  if (inet_pton(AF_INET, argv[optind], &servaddr.sin_addr) <= 0) {
     perror("bad address");
     exit(1);
   }
 
-  servaddr.sin_port = htons(atoi(argv[2]));
+  servaddr.sin_port = htons(atoi(argv[optind + 1]));
+
+  if (load) {
+    config.servaddr = servaddr;
+    return RunLoad(&config);
+  }
+
+  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    perror("socket creating");
+    exit(1);
+  }
 
   if (connect(fd, (SADDR *)&servaddr, SIZE) < 0) {
     perror("connect");
@@ -42,6 +562,11 @@ int main(int argc, char *argv[]) {
   }
 
   write(1, "Input message to send\n", 22);
+  if (config.uring) {
+    int status = RunInteractiveUring(fd);
+    close(fd);
+    exit(status);
+  }
   while ((nread = read(0, buf, BUFSIZE)) > 0) {
     if (write(fd, buf, nread) < 0) {
       perror("write");
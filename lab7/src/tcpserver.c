@@ -1,62 +1,558 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include "relay.h"
+#include "tcpserver.h"
+#include "uring.h"
+#include "uring_server.h"
+
+// Многопоточный TCP-сервер приёма строк.
+//
+// Каждый из --threads потоков открывает собственный слушающий сокет на
+// общем порту с SO_REUSEPORT (ядро распределяет входящие соединения между
+// ними по хешу адресов) и обслуживает свои соединения в собственном
+// epoll без общих блокировок. Сокеты неблокирующие, данные читаются в
+// большой буфер потока, выделенный один раз.
+//
+// Куда идут данные (--mode):
+//   stdout  - в стандартный вывод целыми строками, как в исходной версии;
+//   discard - отбрасываются (замер самого приёма);
+//   echo    - отправляются обратно клиенту;
+//   relay, splice, download, sendfile и echo --zerocopy - см. relay.h.
+//
+// --engine uring заменяет цикл epoll на io_uring (см. uring_server.h) для
+// stdout, discard и echo; если ядро не даёт io_uring, остаётся epoll.
+
 #define SERV_PORT 10050
-#define BUFSIZE 100
+#define BUFSIZE (256 * 1024)
+#define BACKLOG 1024
+#define MAX_EVENTS 256
+// Сколько раз подряд читается одно соединение, прежде чем перейти к
+// следующим событиям, чтобы быстрый клиент не занимал поток целиком
+#define READS_PER_EVENT 16
 #define SADDR struct sockaddr
 
-int main() {
-  const size_t kSize = sizeof(struct sockaddr_in);
+static const char *const sink_names[SINK_MODES_NUM] = {
+    "stdout", "discard", "echo", "relay", "splice", "download", "sendfile"};
+static const char *const engine_names[ENGINES_NUM] = {"epoll", "uring"};
 
-  int lfd, cfd;
-  int nread;
-  char buf[BUFSIZE];
-  struct sockaddr_in servaddr;
-  struct sockaddr_in cliaddr;
+static volatile sig_atomic_t stop_requested = 0;
+
+// stdout общий для всех потоков: строки одного write не должны
+// перемешиваться со строками других соединений
+static pthread_mutex_t stdout_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void StopHandler(int sig) {
+  (void)sig;
+  stop_requested = 1;
+}
+
+bool StopRequested(void) { return stop_requested; }
+
+static double NowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool BufferAppend(struct ByteBuffer *buf, const char *data, size_t len) {
+  if (buf->len + len > buf->cap) {
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < buf->len + len) cap *= 2;
+    char *grown = realloc(buf->data, cap);
+    if (!grown) return false;
+    buf->data = grown;
+    buf->cap = cap;
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+  return true;
+}
+
+bool WriteAll(int fd, struct iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t written = writev(fd, iov, iovcnt);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      perror("write");
+      return false;
+    }
+    while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+// Вывод в stdout только целыми строками; хвост без '\n' ждёт следующих
+// данных соединения. Строка длиннее буфера выводится частями.
+bool SinkLines(struct Worker *worker, struct Connection *conn, const char *data,
+               size_t len, bool eof) {
+  struct ByteBuffer *tail = &conn->pending;
+  const char *last = len ? memrchr(data, '\n', len) : NULL;
+
+  if (!last && !eof && tail->len + len <= worker->config->bufsize)
+    return BufferAppend(tail, data, len);
+
+  size_t head = last ? (size_t)(last - data) + 1 : len;
+  if (eof) head = len;
+  if (tail->len + head > 0) {
+    struct iovec iov[2] = {{tail->data, tail->len}, {(char *)data, head}};
+    pthread_mutex_lock(&stdout_mutex);
+    WriteAll(STDOUT_FILENO, iov, 2);
+    pthread_mutex_unlock(&stdout_mutex);
+  }
+  tail->len = 0;
+  return BufferAppend(tail, data + head, len - head);
+}
+
+static void CloseConnection(struct Worker *worker, struct Connection *conn) {
+  if (worker->config->mode == SINK_STDOUT)
+    SinkLines(worker, conn, NULL, 0, true);
+  if (RelayHandles(worker->config)) RelayConnectionDestroy(worker, conn);
+  epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+  close(conn->fd);
+  free(conn->pending.data);
+  free(conn);
+}
+
+// В режиме stdout в pending лежит недописанная строка, а не ответ
+static bool HasOutput(const struct Worker *worker, const struct Connection *conn) {
+  if (RelayHandles(worker->config)) return RelayHasOutput(worker, conn);
+  return worker->config->mode == SINK_ECHO &&
+         conn->pending_sent < conn->pending.len;
+}
+
+// Пока ответ не отправлен, новые данные не читаются: клиент, который не
+// забирает эхо, упирается в окно TCP, а не в память сервера. Соединение
+// без событий (клиент закрылся, ждём уведомлений MSG_ZEROCOPY) всё равно
+// получает EPOLLERR.
+static void UpdateEvents(struct Worker *worker, struct Connection *conn) {
+  struct epoll_event ev;
+  ev.events = HasOutput(worker, conn) ? EPOLLOUT : conn->read_closed ? 0 : EPOLLIN;
+  ev.data.ptr = conn;
+  epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+// Отправка накопленного эха; false, если соединение нужно закрыть
+static bool FlushEcho(struct Worker *worker, struct Connection *conn) {
+  while (conn->pending_sent < conn->pending.len) {
+    ssize_t sent = send(conn->fd, conn->pending.data + conn->pending_sent,
+                        conn->pending.len - conn->pending_sent, MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    conn->pending_sent += sent;
+    worker->bytes_out += sent;
+  }
+  conn->pending.len = 0;
+  conn->pending_sent = 0;
+  return !conn->read_closed;
+}
+
+// Эхо сначала отправляется сразу из буфера потока, в буфер соединения
+// копируется только то, что не поместилось в сокет
+static bool EchoData(struct Worker *worker, struct Connection *conn,
+                     const char *data, size_t len) {
+  size_t offset = 0;
+  while (offset < len) {
+    ssize_t sent = send(conn->fd, data + offset, len - offset, MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    offset += sent;
+    worker->bytes_out += sent;
+  }
+  return BufferAppend(&conn->pending, data + offset, len - offset);
+}
+
+static void ReadConnection(struct Worker *worker, struct Connection *conn) {
+  const struct ServerConfig *config = worker->config;
+  if (RelayHandles(config)) {
+    if (RelayRead(worker, conn))
+      UpdateEvents(worker, conn);
+    else
+      CloseConnection(worker, conn);
+    return;
+  }
+
+  for (int i = 0; i < READS_PER_EVENT; i++) {
+    ssize_t nread = recv(conn->fd, worker->buf, config->bufsize, 0);
+    if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (nread < 0 && errno == EINTR) continue;
+    if (nread <= 0) {
+      // EOF: эхо, которое ещё не ушло, дописывается перед закрытием
+      if (nread < 0) perror("recv");
+      conn->read_closed = true;
+      if (nread == 0 && HasOutput(worker, conn)) break;
+      CloseConnection(worker, conn);
+      return;
+    }
+    worker->bytes_in += nread;
+
+    bool ok = true;
+    if (config->mode == SINK_STDOUT)
+      ok = SinkLines(worker, conn, worker->buf, nread, false);
+    else if (config->mode == SINK_ECHO)
+      ok = EchoData(worker, conn, worker->buf, nread);
+    if (!ok) {
+      CloseConnection(worker, conn);
+      return;
+    }
+    if (HasOutput(worker, conn)) break;
+    if ((size_t)nread < config->bufsize) break;  // сокет, скорее всего, пуст
+  }
+  UpdateEvents(worker, conn);
+}
+
+static void AcceptConnections(struct Worker *worker) {
+  while (true) {
+    int cfd = accept4(worker->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (cfd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        perror("accept");
+      return;
+    }
+
+    struct Connection *conn = calloc(1, sizeof(struct Connection));
+    if (!conn) {
+      fprintf(stderr, "Memory allocation failed\n");
+      close(cfd);
+      continue;
+    }
+    conn->fd = cfd;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, cfd, &ev) < 0) {
+      perror("epoll_ctl");
+      close(cfd);
+      free(conn);
+      continue;
+    }
+    worker->connections++;
+
+    if (RelayHandles(worker->config)) {
+      if (!RelayConnectionInit(worker, conn)) {
+        CloseConnection(worker, conn);
+        continue;
+      }
+      UpdateEvents(worker, conn);  // download и sendfile сразу пишут
+    }
+  }
+}
 
-  if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+// Слушающий сокет потока на общем порту
+static int OpenListener(int port) {
+  int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (lfd < 0) {
     perror("socket");
-    exit(1);
+    return -1;
+  }
+
+  int opt_val = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+  if (setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &opt_val, sizeof(opt_val)) < 0) {
+    perror("setsockopt SO_REUSEPORT");
+    close(lfd);
+    return -1;
   }
 
-  memset(&servaddr, 0, kSize);
+  struct sockaddr_in servaddr;
+  memset(&servaddr, 0, sizeof(servaddr));
   servaddr.sin_family = AF_INET;
   servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-  servaddr.sin_port = htons(SERV_PORT);
+  servaddr.sin_port = htons(port);
 
-  if (bind(lfd, (SADDR *)&servaddr, kSize) < 0) {
+  if (bind(lfd, (SADDR *)&servaddr, sizeof(servaddr)) < 0) {
     perror("bind");
-    exit(1);
+    close(lfd);
+    return -1;
   }
-
-  if (listen(lfd, 5) < 0) {
+  if (listen(lfd, BACKLOG) < 0) {
     perror("listen");
-    exit(1);
+    close(lfd);
+    return -1;
   }
+  return lfd;
+}
 
-  while (1) {
-    unsigned int clilen = kSize;
+static bool WorkerInit(struct Worker *worker) {
+  worker->epoll_fd = -1;
+  worker->listen_fd = OpenListener(worker->config->port);
+  if (worker->listen_fd < 0) return false;
 
-    if ((cfd = accept(lfd, (SADDR *)&cliaddr, &clilen)) < 0) {
-      perror("accept");
-      exit(1);
+  if (!RelayWorkerInit(worker)) {
+    fprintf(stderr, "Can not create worker %d\n", worker->id);
+    return false;
+  }
+  if (worker->config->engine == ENGINE_URING) {
+    if (!UringServerInit(worker)) {
+      fprintf(stderr, "Can not create worker %d\n", worker->id);
+      return false;
     }
-    printf("connection established\n");
+    return true;
+  }
+
+  worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  worker->buf = malloc(worker->config->bufsize);
+  if (worker->epoll_fd < 0 || !worker->buf) {
+    fprintf(stderr, "Can not create worker %d\n", worker->id);
+    return false;
+  }
+
+  // Слушающий сокет отличается от соединений пустым указателем
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->listen_fd, &ev) < 0) {
+    perror("epoll_ctl");
+    return false;
+  }
+  return true;
+}
+
+static void *WorkerMain(void *arg) {
+  struct Worker *worker = arg;
+  struct epoll_event events[MAX_EVENTS];
 
-    while ((nread = read(cfd, buf, BUFSIZE)) > 0) {
-      write(1, &buf, nread);
+  // Таймаут нужен, чтобы заметить сигнал остановки, пришедший в другой поток
+  while (!stop_requested) {
+    int ready = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, 200);
+    if (ready < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      break;
     }
 
-    if (nread == -1) {
-      perror("read");
-      exit(1);
+    for (int i = 0; i < ready; i++) {
+      struct Connection *conn = events[i].data.ptr;
+      if (!conn) {
+        AcceptConnections(worker);
+        continue;
+      }
+      bool relay = RelayHandles(worker->config);
+      uint32_t ready_events = events[i].events;
+      // Уведомления MSG_ZEROCOPY приходят как EPOLLERR; после их разбора
+      // остальные события соединения обрабатываются как обычно
+      if ((ready_events & EPOLLERR) && relay && worker->config->zerocopy) {
+        if (!RelayCompletions(worker, conn)) {
+          CloseConnection(worker, conn);
+          continue;
+        }
+        ready_events &= ~EPOLLERR;
+        if (!(ready_events & (EPOLLIN | EPOLLOUT | EPOLLHUP))) {
+          UpdateEvents(worker, conn);
+          continue;
+        }
+      }
+      if (ready_events & EPOLLOUT) {
+        if (!(relay ? RelayFlush(worker, conn) : FlushEcho(worker, conn))) {
+          CloseConnection(worker, conn);
+          continue;
+        }
+        UpdateEvents(worker, conn);
+      } else if (ready_events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        ReadConnection(worker, conn);
+      }
     }
-    close(cfd);
   }
+  return NULL;
+}
+
+static void PrintStats(const struct Worker *workers, int threads, double seconds) {
+  uint64_t connections = 0, bytes_in = 0, bytes_out = 0;
+  uint64_t zc_completions = 0, zc_copied = 0;
+  for (int i = 0; i < threads; i++) {
+    fprintf(stderr, "Thread %d: %llu connections, %.1f MB in, %.1f MB out\n", i,
+            (unsigned long long)workers[i].connections, workers[i].bytes_in / 1e6,
+            workers[i].bytes_out / 1e6);
+    connections += workers[i].connections;
+    bytes_in += workers[i].bytes_in;
+    bytes_out += workers[i].bytes_out;
+    zc_completions += workers[i].zc_completions;
+    zc_copied += workers[i].zc_copied;
+  }
+  fprintf(stderr,
+          "Total: %llu connections in %.1f s (%.0f connections/s), "
+          "%.1f MB in (%.1f MB/s), %.1f MB out\n",
+          (unsigned long long)connections, seconds, connections / seconds,
+          bytes_in / 1e6, bytes_in / 1e6 / seconds, bytes_out / 1e6);
+  if (zc_completions)
+    fprintf(stderr, "MSG_ZEROCOPY: %llu sends completed, %llu of them copied\n",
+            (unsigned long long)zc_completions, (unsigned long long)zc_copied);
+}
+
+int main(int argc, char **argv) {
+  struct ServerConfig config;
+  memset(&config, 0, sizeof(config));
+  config.port = SERV_PORT;
+  config.threads = 1;
+  config.bufsize = BUFSIZE;
+  config.mode = SINK_STDOUT;
+
+  while (true) {
+    static struct option options[] = {{"port", required_argument, 0, 0},
+                                      {"threads", required_argument, 0, 0},
+                                      {"bufsize", required_argument, 0, 0},
+                                      {"mode", required_argument, 0, 0},
+                                      {"target", required_argument, 0, 0},
+                                      {"tee", no_argument, 0, 0},
+                                      {"zerocopy", no_argument, 0, 0},
+                                      {"engine", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1) break;
+
+    if (c != 0) {
+      fprintf(stderr,
+              "Usage: %s [--port %d] [--threads 1] [--bufsize %d] "
+              "[--mode stdout|discard|echo|relay|splice|download|sendfile] "
+              "[--target file|-|host:port] [--tee] [--zerocopy] "
+              "[--engine epoll|uring]\n",
+              argv[0], SERV_PORT, BUFSIZE);
+      return 1;
+    }
+
+    switch (option_index) {
+      case 0:
+        config.port = atoi(optarg);
+        if (config.port <= 0 || config.port > 65535) {
+          fprintf(stderr, "port must be in 1..65535\n");
+          return 1;
+        }
+        break;
+      case 1:
+        config.threads = atoi(optarg);
+        if (config.threads <= 0) {
+          fprintf(stderr, "threads must be positive\n");
+          return 1;
+        }
+        break;
+      case 2:
+        config.bufsize = strtoul(optarg, NULL, 10);
+        if (config.bufsize == 0) {
+          fprintf(stderr, "bufsize must be positive\n");
+          return 1;
+        }
+        break;
+      case 3: {
+        int mode = -1;
+        for (int i = 0; i < SINK_MODES_NUM; i++)
+          if (strcmp(optarg, sink_names[i]) == 0) mode = i;
+        if (mode < 0) {
+          fprintf(stderr, "Unknown mode %s\n", optarg);
+          return 1;
+        }
+        config.mode = (enum SinkMode)mode;
+        break;
+      }
+      case 4:
+        config.target = optarg;
+        break;
+      case 5:
+        config.tee = true;
+        break;
+      case 6:
+        config.zerocopy = true;
+        break;
+      case 7: {
+        int engine = -1;
+        for (int i = 0; i < ENGINES_NUM; i++)
+          if (strcmp(optarg, engine_names[i]) == 0) engine = i;
+        if (engine < 0) {
+          fprintf(stderr, "Unknown engine %s\n", optarg);
+          return 1;
+        }
+        config.engine = (enum Engine)engine;
+        break;
+      }
+    }
+  }
+
+  if (!RelayConfigure(&config)) return 1;
+  if (config.engine == ENGINE_URING) {
+    if (RelayHandles(&config)) {
+      fprintf(stderr, "--engine uring supports stdout, discard and echo modes\n");
+      return 1;
+    }
+    if (!UringSupported()) {
+      fprintf(stderr, "io_uring is not available, falling back to epoll\n");
+      config.engine = ENGINE_EPOLL;
+    }
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = StopHandler;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  struct Worker *workers = calloc(config.threads, sizeof(struct Worker));
+  if (!workers) {
+    fprintf(stderr, "Memory allocation failed\n");
+    return 1;
+  }
+  for (int i = 0; i < config.threads; i++) {
+    workers[i].id = i;
+    workers[i].config = &config;
+    if (!WorkerInit(&workers[i])) return 1;
+  }
+
+  fprintf(stderr,
+          "Listening on port %d: %d threads, mode %s, engine %s, buffer %zu bytes\n",
+          config.port, config.threads, sink_names[config.mode],
+          engine_names[config.engine], config.bufsize);
+
+  double start = NowSeconds();
+  int started = 0;
+  for (; started < config.threads; started++) {
+    void *(*main_loop)(void *) =
+        config.engine == ENGINE_URING ? UringServerMain : WorkerMain;
+    if (pthread_create(&workers[started].thread, NULL, main_loop,
+                       &workers[started]) != 0) {
+      perror("pthread_create");
+      stop_requested = 1;
+      break;
+    }
+  }
+  for (int i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+
+  PrintStats(workers, config.threads, NowSeconds() - start);
+
+  for (int i = 0; i < config.threads; i++) {
+    close(workers[i].listen_fd);
+    if (workers[i].epoll_fd >= 0) close(workers[i].epoll_fd);
+    free(workers[i].buf);
+    RelayWorkerDestroy(&workers[i]);
+    UringServerDestroy(&workers[i]);
+  }
+  free(workers);
+  return 0;
 }
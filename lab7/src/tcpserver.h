@@ -0,0 +1,116 @@
+#ifndef TCPSERVER_H
+#define TCPSERVER_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Общие типы tcpserver: конфигурация, соединение и поток-обработчик.
+// Цикл epoll и простые режимы - в tcpserver.c, режимы без копирования
+// данных в пространство пользователя - в relay.c, цикл на io_uring -
+// в uring_server.c.
+
+enum SinkMode {
+  SINK_STDOUT,    // в stdout целыми строками
+  SINK_DISCARD,   // отбросить
+  SINK_ECHO,      // обратно клиенту (--zerocopy: MSG_ZEROCOPY)
+  SINK_RELAY,     // в --target через буфер: recv + write
+  SINK_SPLICE,    // в --target через pipe: splice (--tee: и эхо клиенту)
+  SINK_DOWNLOAD,  // файл --target клиенту через буфер: pread + send
+  SINK_SENDFILE,  // файл --target клиенту: sendfile
+  SINK_MODES_NUM
+};
+
+// Чем поток ждёт событий: epoll + системный вызов на каждое чтение и
+// запись или io_uring, где пачка операций уходит одним вызовом
+enum Engine {
+  ENGINE_EPOLL,
+  ENGINE_URING,
+  ENGINES_NUM
+};
+
+struct ServerConfig {
+  int port;
+  int threads;
+  size_t bufsize;
+  enum SinkMode mode;
+  const char *target;
+  bool tee;
+  bool zerocopy;
+  enum Engine engine;
+
+  // Заполняется RelayConfigure
+  int target_fd;               // общий файл или pipe; -1 для сокета
+  struct sockaddr_in target_addr;  // --target host:port: сокет на соединение
+  off_t file_size;             // размер файла для download/sendfile
+};
+
+// Растущий буфер байтов соединения: недописанная строка для stdout или
+// ещё не отправленные данные для echo и splice --tee
+struct ByteBuffer {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+struct ZeroCopyChunk;
+struct UringServer;
+
+struct Connection {
+  int fd;
+  struct ByteBuffer pending;
+  size_t pending_sent;
+  bool read_closed;  // клиент закрыл свою сторону, осталось дописать ответ
+
+  // relay.c
+  int target_fd;
+  int echo_pipe[2];     // копия данных для эха в режиме splice --tee
+  size_t echo_pipe_len;
+  size_t echo_pipe_size;  // ёмкость; может оказаться меньше pipe потока
+  off_t file_offset;
+  struct ZeroCopyChunk *zc_head;  // буферы, отправленные с MSG_ZEROCOPY
+  struct ZeroCopyChunk *zc_tail;
+  uint32_t zc_next_id;
+
+  // uring_server.c
+  char *slice;         // зарегистрированный буфер эха
+  size_t write_len;    // эхо в slice, отправленное write_done байтами
+  size_t write_done;
+  int inflight;        // запросов в io_uring по этому соединению
+  bool closing;
+};
+
+struct Worker {
+  int id;
+  const struct ServerConfig *config;
+  int listen_fd;
+  int epoll_fd;
+  char *buf;
+  pthread_t thread;
+
+  // relay.c
+  int pipe[2];
+  size_t pipe_size;
+  struct ZeroCopyChunk *zc_free;
+
+  // uring_server.c
+  struct UringServer *uring;
+
+  uint64_t connections;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t zc_completions;
+  uint64_t zc_copied;
+};
+
+bool BufferAppend(struct ByteBuffer *buf, const char *data, size_t len);
+bool WriteAll(int fd, struct iovec *iov, int iovcnt);
+bool SinkLines(struct Worker *worker, struct Connection *conn, const char *data,
+               size_t len, bool eof);
+bool StopRequested(void);
+
+#endif  // TCPSERVER_H
@@ -1,35 +1,264 @@
+#define _GNU_SOURCE
+
 #include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #define SERV_PORT 20001
 #define BUFSIZE 1024
 #define SADDR struct sockaddr
 #define SLEN sizeof(struct sockaddr_in)
+#define BATCH 64
+
+// Режим замера (--bench): --count датаграмм с порядковыми номерами, в
+// полёте не больше --window. Окно скользящее, как в selective repeat:
+// номер next отправляется, только пока next < base + window, где base -
+// наименьший незавершённый номер, поэтому слот seq % window однозначен.
+// Датаграмма без ответа за --timeout мс отправляется повторно, после
+// --retries повторов считается потерянной. RTT меряется по времени
+// отправки, которое сервер возвращает в эхе, поэтому ответ на повтор не
+// путается с ответом на исходную отправку.
+
+struct BenchConfig {
+  long count;
+  int window;
+  size_t size;
+  int timeout_ms;
+  int retries;
+};
+
+// Заголовок датаграммы; остальное до --size - заполнитель
+struct Probe {
+  uint64_t seq;
+  uint64_t sent_ns;
+};
+
+struct Slot {
+  long seq;
+  int tries;
+  uint64_t deadline_ns;
+  bool active;
+};
+
+static uint64_t NowNanos(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double Percentile(const double *sorted, long count, double p) {
+  long rank = (long)(p / 100.0 * count + 0.999999);
+  if (rank < 1) rank = 1;
+  if (rank > count) rank = count;
+  return sorted[rank - 1];
+}
+
+static bool SendProbe(int sockfd, char *buf, size_t size, long seq) {
+  struct Probe probe = {(uint64_t)seq, NowNanos()};
+  memcpy(buf, &probe, sizeof(probe));
+  return send(sockfd, buf, size, 0) >= 0 || errno == ECONNREFUSED;
+}
+
+static int RunBench(int sockfd, const struct BenchConfig *config) {
+  char *buf = malloc(config->size);
+  char *replies = malloc((size_t)BATCH * config->size);
+  struct Slot *slots = calloc(config->window, sizeof(struct Slot));
+  bool *done = calloc(config->count, sizeof(bool));
+  double *rtts = malloc(config->count * sizeof(double));
+  if (!buf || !replies || !slots || !done || !rtts) {
+    fprintf(stderr, "Memory allocation failed\n");
+    return 1;
+  }
+  memset(buf, 'x', config->size);
+
+  struct mmsghdr msgs[BATCH];
+  struct iovec iovs[BATCH];
+  memset(msgs, 0, sizeof(msgs));
+  for (int i = 0; i < BATCH; i++) {
+    iovs[i].iov_base = replies + (size_t)i * config->size;
+    iovs[i].iov_len = config->size;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  uint64_t timeout_ns = (uint64_t)config->timeout_ms * 1000000ull;
+  long base = 0, next = 0, in_flight = 0;
+  long rtt_count = 0, lost = 0, retransmits = 0, duplicates = 0, transmissions = 0;
+  uint64_t start = NowNanos();
+
+  while (base < config->count) {
+    // Новые датаграммы, пока окно не заполнено
+    while (next < config->count && next < base + config->window) {
+      if (!SendProbe(sockfd, buf, config->size, next)) {
+        perror("sendto problem");
+        return 1;
+      }
+      struct Slot *slot = &slots[next % config->window];
+      *slot = (struct Slot){next, 1, NowNanos() + timeout_ns, true};
+      transmissions++;
+      in_flight++;
+      next++;
+    }
+
+    // Ждём ответов не дольше, чем до ближайшего таймаута
+    uint64_t now = NowNanos();
+    uint64_t nearest = UINT64_MAX;
+    for (int i = 0; i < config->window; i++)
+      if (slots[i].active && slots[i].deadline_ns < nearest)
+        nearest = slots[i].deadline_ns;
+    int wait_ms = nearest <= now ? 0 : (int)((nearest - now + 999999) / 1000000);
+    struct pollfd pfd = {sockfd, POLLIN, 0};
+    poll(&pfd, 1, in_flight ? wait_ms : 0);
+
+    int n;
+    while ((n = recvmmsg(sockfd, msgs, BATCH, MSG_DONTWAIT, NULL)) > 0) {
+      uint64_t received_at = NowNanos();
+      for (int i = 0; i < n; i++) {
+        if (msgs[i].msg_len < sizeof(struct Probe)) continue;
+        struct Probe probe;
+        memcpy(&probe, iovs[i].iov_base, sizeof(probe));
+        long seq = (long)probe.seq;
+        struct Slot *slot = &slots[seq % config->window];
+        if (seq < base || seq >= next || !slot->active || slot->seq != seq) {
+          duplicates++;  // ответ на повтор или на уже списанную датаграмму
+          continue;
+        }
+        rtts[rtt_count++] = (received_at - probe.sent_ns) / 1000.0;
+        slot->active = false;
+        done[seq] = true;
+        in_flight--;
+      }
+    }
+
+    // Повторы и потери по таймауту
+    now = NowNanos();
+    for (int i = 0; i < config->window; i++) {
+      struct Slot *slot = &slots[i];
+      if (!slot->active || slot->deadline_ns > now) continue;
+      if (slot->tries > config->retries) {
+        slot->active = false;
+        done[slot->seq] = true;
+        in_flight--;
+        lost++;
+        continue;
+      }
+      SendProbe(sockfd, buf, config->size, slot->seq);
+      slot->tries++;
+      slot->deadline_ns = now + timeout_ns;
+      retransmits++;
+      transmissions++;
+    }
+
+    while (base < next && done[base]) base++;
+  }
+  double seconds = (NowNanos() - start) / 1e9;
+
+  qsort(rtts, rtt_count, sizeof(double), CompareDoubles);
+  printf("Datagrams: %ld, window %d, size %zu bytes\n", config->count,
+         config->window, config->size);
+  printf("Transmissions: %ld (%ld retransmits), duplicate replies: %ld\n",
+         transmissions, retransmits, duplicates);
+  printf("Replies: %ld in %.3f s, %.0f per second\n", rtt_count, seconds,
+         rtt_count / seconds);
+  printf("Lost after %d retries: %ld (%.3f%%), per transmission: %.3f%%\n",
+         config->retries, lost, 100.0 * lost / config->count,
+         100.0 * (transmissions - rtt_count - duplicates) / transmissions);
+  if (rtt_count > 0)
+    printf("RTT us: min %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+           rtts[0], Percentile(rtts, rtt_count, 50), Percentile(rtts, rtt_count, 90),
+           Percentile(rtts, rtt_count, 99), Percentile(rtts, rtt_count, 99.9),
+           rtts[rtt_count - 1]);
+
+  free(buf);
+  free(replies);
+  free(slots);
+  free(done);
+  free(rtts);
+  return lost ? 1 : 0;
+}
 
 int main(int argc, char **argv) {
   int sockfd, n;
   char sendline[BUFSIZE], recvline[BUFSIZE + 1];
   struct sockaddr_in servaddr;
-  struct sockaddr_in cliaddr;
+  int port = SERV_PORT;
+  bool bench = false;
+  struct BenchConfig config = {100000, 64, 64, 200, 3};
+
+  while (true) {
+    static struct option options[] = {{"port", required_argument, 0, 0},
+                                      {"bench", no_argument, 0, 0},
+                                      {"count", required_argument, 0, 0},
+                                      {"window", required_argument, 0, 0},
+                                      {"size", required_argument, 0, 0},
+                                      {"timeout", required_argument, 0, 0},
+                                      {"retries", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
 
-  if (argc != 2) {
-    printf("usage: client <IPaddress of server>\n");
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1) break;
+    if (c != 0) exit(1);
+
+    switch (option_index) {
+      case 0:
+        port = atoi(optarg);
+        break;
+      case 1:
+        bench = true;
+        break;
+      case 2:
+        config.count = atol(optarg);
+        break;
+      case 3:
+        config.window = atoi(optarg);
+        break;
+      case 4:
+        config.size = strtoul(optarg, NULL, 10);
+        break;
+      case 5:
+        config.timeout_ms = atoi(optarg);
+        break;
+      case 6:
+        config.retries = atoi(optarg);
+        break;
+    }
+  }
+
+  if (argc - optind != 1 || port <= 0 || port > 65535 || config.count <= 0 ||
+      config.window <= 0 || config.size < sizeof(struct Probe) ||
+      config.size > 65507 || config.timeout_ms <= 0 || config.retries < 0) {
+    printf("usage: client <IPaddress of server> [--port %d] [--timeout ms] [--retries n]\n"
+           "       client <IPaddress of server> --bench [--count n] [--window n] "
+           "[--size bytes]\n",
+           SERV_PORT);
     exit(1);
   }
 
   memset(&servaddr, 0, sizeof(servaddr));
   servaddr.sin_family = AF_INET;
-  servaddr.sin_port = htons(SERV_PORT);
+  servaddr.sin_port = htons(port);
 
-  if (inet_pton(AF_INET, argv[1], &servaddr.sin_addr) < 0) {
+  if (inet_pton(AF_INET, argv[optind], &servaddr.sin_addr) <= 0) {
     perror("inet_pton problem");
     exit(1);
   }
@@ -38,19 +267,45 @@ int main(int argc, char **argv) {
     exit(1);
   }
 
+  if (bench) {
+    // Подключённый сокет: ответы только от сервера, send без адреса
+    if (connect(sockfd, (SADDR *)&servaddr, SLEN) < 0) {
+      perror("connect problem");
+      exit(1);
+    }
+    int rcvbuf = 4 << 20;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    int status = RunBench(sockfd, &config);
+    close(sockfd);
+    return status;
+  }
+
+  // Без таймаута потерянная датаграмма подвешивала клиента навсегда
+  struct timeval timeout = {config.timeout_ms / 1000, (config.timeout_ms % 1000) * 1000};
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
   write(1, "Enter string\n", 13);
 
   while ((n = read(0, sendline, BUFSIZE)) > 0) {
-    if (sendto(sockfd, sendline, n, 0, (SADDR *)&servaddr, SLEN) == -1) {
-      perror("sendto problem");
-      exit(1);
+    int tries = 0;
+    ssize_t got = -1;
+    while (got < 0 && tries++ <= config.retries) {
+      if (sendto(sockfd, sendline, n, 0, (SADDR *)&servaddr, SLEN) == -1) {
+        perror("sendto problem");
+        exit(1);
+      }
+      got = recvfrom(sockfd, recvline, BUFSIZE, 0, NULL, NULL);
+      if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        perror("recvfrom problem");
+        exit(1);
+      }
     }
 
-    if (recvfrom(sockfd, recvline, BUFSIZE, 0, NULL, NULL) == -1) {
-      perror("recvfrom problem");
-      exit(1);
+    if (got < 0) {
+      printf("NO REPLY FROM SERVER after %d attempts\n", config.retries + 1);
+      continue;
     }
-
+    recvline[got] = 0;
     printf("REPLY FROM SERVER= %s\n", recvline);
   }
   close(sockfd);
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+// Генератор нагрузки для udpserver: --threads потоков, у каждого свой
+// сокет (свой порт источника, значит и свой поток сервера при
+// SO_REUSEPORT). Поток отправляет датаграммы пачками по --batch через
+// sendmmsg и забирает ответы recvmmsg, держа в полёте не больше --window
+// датаграмм. Если ответы перестали приходить, недостающие считаются
+// потерянными и окно открывается заново. Итог - пакетов в секунду
+// отправлено и получено, доля потерь.
+
+#define SERV_PORT 20001
+#define SADDR struct sockaddr
+#define SLEN sizeof(struct sockaddr_in)
+// Сколько ждать ответа, прежде чем признать датаграммы в полёте потерянными
+#define LOSS_TIMEOUT_MS 20
+
+struct LoadConfig {
+  struct sockaddr_in servaddr;
+  int threads;
+  int batch;
+  int window;
+  size_t size;
+  double duration;
+};
+
+struct LoadWorker {
+  const struct LoadConfig *config;
+  pthread_t thread;
+  uint64_t sent;
+  uint64_t received;
+  bool failed;
+};
+
+static double NowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *LoadMain(void *arg) {
+  struct LoadWorker *worker = arg;
+  const struct LoadConfig *config = worker->config;
+  int batch = config->batch;
+
+  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sockfd < 0 || connect(sockfd, (SADDR *)&config->servaddr, SLEN) < 0) {
+    perror("socket problem");
+    worker->failed = true;
+    return NULL;
+  }
+  int rcvbuf = 4 << 20;
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  // Все отправляемые датаграммы одинаковые, ответы пишутся в общий буфер
+  char *payload = malloc(config->size);
+  char *replies = malloc((size_t)batch * config->size);
+  struct mmsghdr *out = calloc(batch, sizeof(struct mmsghdr));
+  struct mmsghdr *in = calloc(batch, sizeof(struct mmsghdr));
+  struct iovec *out_iov = calloc(batch, sizeof(struct iovec));
+  struct iovec *in_iov = calloc(batch, sizeof(struct iovec));
+  if (!payload || !replies || !out || !in || !out_iov || !in_iov) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  memset(payload, 'x', config->size);
+  for (int i = 0; i < batch; i++) {
+    out_iov[i].iov_base = payload;
+    out_iov[i].iov_len = config->size;
+    out[i].msg_hdr.msg_iov = &out_iov[i];
+    out[i].msg_hdr.msg_iovlen = 1;
+    in_iov[i].iov_base = replies + (size_t)i * config->size;
+    in_iov[i].iov_len = config->size;
+    in[i].msg_hdr.msg_iov = &in_iov[i];
+    in[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  double deadline = NowSeconds() + config->duration;
+  uint64_t in_flight = 0;
+  while (NowSeconds() < deadline) {
+    if (in_flight + batch <= (uint64_t)config->window) {
+      int n = sendmmsg(sockfd, out, batch, 0);
+      if (n > 0) {
+        worker->sent += n;
+        in_flight += n;
+      }
+    }
+
+    int n = recvmmsg(sockfd, in, batch, MSG_DONTWAIT, NULL);
+    if (n > 0) {
+      worker->received += n;
+      in_flight = (uint64_t)n < in_flight ? in_flight - n : 0;
+      continue;
+    }
+    if (in_flight + batch <= (uint64_t)config->window) continue;
+
+    // Окно заполнено: ждём ответов, а по таймауту списываем их в потери
+    struct pollfd pfd = {sockfd, POLLIN, 0};
+    if (poll(&pfd, 1, LOSS_TIMEOUT_MS) == 0) in_flight = 0;
+  }
+
+  // Ответы, которые ещё в пути
+  double drain_end = NowSeconds() + LOSS_TIMEOUT_MS / 1000.0;
+  while (NowSeconds() < drain_end) {
+    int n = recvmmsg(sockfd, in, batch, MSG_DONTWAIT, NULL);
+    if (n > 0)
+      worker->received += n;
+    else
+      usleep(1000);
+  }
+
+  close(sockfd);
+  free(payload);
+  free(replies);
+  free(out);
+  free(in);
+  free(out_iov);
+  free(in_iov);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  struct LoadConfig config;
+  memset(&config, 0, sizeof(config));
+  config.threads = 1;
+  config.batch = 64;
+  config.window = 1024;
+  config.size = 64;
+  config.duration = 3;
+  int port = SERV_PORT;
+
+  while (true) {
+    static struct option options[] = {{"port", required_argument, 0, 0},
+                                      {"threads", required_argument, 0, 0},
+                                      {"batch", required_argument, 0, 0},
+                                      {"window", required_argument, 0, 0},
+                                      {"size", required_argument, 0, 0},
+                                      {"duration", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1) break;
+    if (c != 0) exit(1);
+
+    switch (option_index) {
+      case 0:
+        port = atoi(optarg);
+        break;
+      case 1:
+        config.threads = atoi(optarg);
+        break;
+      case 2:
+        config.batch = atoi(optarg);
+        break;
+      case 3:
+        config.window = atoi(optarg);
+        break;
+      case 4:
+        config.size = strtoul(optarg, NULL, 10);
+        break;
+      case 5:
+        config.duration = atof(optarg);
+        break;
+    }
+  }
+
+  if (optind >= argc || config.threads <= 0 || config.batch <= 0 ||
+      config.window < config.batch || config.size == 0 || config.size > 65507 ||
+      config.duration <= 0 || port <= 0 || port > 65535) {
+    printf("usage: %s <IPaddress of server> [--port %d] [--threads 1] [--batch 64] "
+           "[--window 1024] [--size 64] [--duration 3]\n",
+           argv[0], SERV_PORT);
+    printf("window must be at least batch, size at most 65507\n");
+    exit(1);
+  }
+
+  config.servaddr.sin_family = AF_INET;
+  config.servaddr.sin_port = htons(port);
+  if (inet_pton(AF_INET, argv[optind], &config.servaddr.sin_addr) <= 0) {
+    perror("inet_pton problem");
+    exit(1);
+  }
+
+  struct LoadWorker *workers = calloc(config.threads, sizeof(struct LoadWorker));
+  if (!workers) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+
+  double start = NowSeconds();
+  for (int i = 0; i < config.threads; i++) {
+    workers[i].config = &config;
+    if (pthread_create(&workers[i].thread, NULL, LoadMain, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+
+  uint64_t sent = 0, received = 0;
+  bool failed = false;
+  for (int i = 0; i < config.threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    sent += workers[i].sent;
+    received += workers[i].received;
+    failed |= workers[i].failed;
+  }
+  double seconds = NowSeconds() - start;
+
+  printf("Datagrams: %llu sent, %llu received in %.2f s\n", (unsigned long long)sent,
+         (unsigned long long)received, seconds);
+  printf("Sent: %.0f pps, received: %.0f pps (%.1f MB/s)\n", sent / seconds,
+         received / seconds, received * config.size / 1e6 / seconds);
+  printf("Loss: %.3f%%\n", sent ? 100.0 * (sent - received) / sent : 0.0);
+
+  free(workers);
+  return failed || received == 0 ? 1 : 0;
+}
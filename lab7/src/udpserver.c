@@ -1,56 +1,323 @@
+#define _GNU_SOURCE
+
 #include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+// Эхо-сервер UDP с пакетной обработкой.
+//
+// Каждый из --threads потоков держит свой сокет на общем порту с
+// SO_REUSEPORT и за один системный вызов recvmmsg забирает до --batch
+// датаграмм, а одним sendmmsg возвращает их отправителям из тех же
+// буферов. Вместо печати каждого запроса раз в --stats секунд выводятся
+// счётчики пакетов; --sample N печатает каждый N-й запрос в старом виде.
+
 #define SERV_PORT 20001
 #define BUFSIZE 1024
+#define BATCH 64
 #define SADDR struct sockaddr
 #define SLEN sizeof(struct sockaddr_in)
 
-int main() {
-  int sockfd, n;
-  char mesg[BUFSIZE], ipadr[16];
-  struct sockaddr_in servaddr;
-  struct sockaddr_in cliaddr;
+struct ServerConfig {
+  int port;
+  int threads;
+  int batch;
+  size_t bufsize;
+  uint64_t sample;
+};
+
+struct Worker {
+  int id;
+  const struct ServerConfig *config;
+  int sockfd;
+  pthread_t thread;
+
+  // Пишет только поток-владелец, читает поток статистики
+  atomic_uint_fast64_t packets_in;
+  atomic_uint_fast64_t packets_out;
+  atomic_uint_fast64_t bytes_in;
+  atomic_uint_fast64_t batches;
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void StopHandler(int sig) {
+  (void)sig;
+  stop_requested = 1;
+}
+
+static double NowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-  if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+static int OpenSocket(int port) {
+  int sockfd;
+  if ((sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0) {
     perror("socket problem");
-    exit(1);
+    return -1;
   }
 
+  int opt_val = 1;
+  if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt_val, sizeof(opt_val)) < 0) {
+    perror("setsockopt SO_REUSEPORT");
+    close(sockfd);
+    return -1;
+  }
+  // Большой приёмный буфер сглаживает всплески, пока поток отвечает
+  int rcvbuf = 4 << 20;
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  // Таймаут, чтобы заметить сигнал остановки, пришедший в другой поток
+  struct timeval timeout = {0, 200000};
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  struct sockaddr_in servaddr;
   memset(&servaddr, 0, SLEN);
   servaddr.sin_family = AF_INET;
   servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-  servaddr.sin_port = htons(SERV_PORT);
+  servaddr.sin_port = htons(port);
 
   if (bind(sockfd, (SADDR *)&servaddr, SLEN) < 0) {
     perror("bind problem");
+    close(sockfd);
+    return -1;
+  }
+  return sockfd;
+}
+
+static void PrintRequest(const char *mesg, int n, const struct sockaddr_in *cliaddr) {
+  char ipadr[16];
+  printf("REQUEST %.*s      FROM %s : %d\n", n, mesg,
+         inet_ntop(AF_INET, (void *)&cliaddr->sin_addr.s_addr, ipadr, 16),
+         ntohs(cliaddr->sin_port));
+}
+
+static void *WorkerMain(void *arg) {
+  struct Worker *worker = arg;
+  const struct ServerConfig *config = worker->config;
+  int batch = config->batch;
+
+  char *bufs = malloc((size_t)batch * config->bufsize);
+  struct mmsghdr *msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct iovec *iovs = calloc(batch, sizeof(struct iovec));
+  struct sockaddr_in *addrs = calloc(batch, sizeof(struct sockaddr_in));
+  if (!bufs || !msgs || !iovs || !addrs) {
+    fprintf(stderr, "Memory allocation failed\n");
     exit(1);
   }
-  printf("SERVER starts...\n");
 
-  while (1) {
-    unsigned int len = SLEN;
+  uint64_t received = 0;
+  while (!stop_requested) {
+    for (int i = 0; i < batch; i++) {
+      iovs[i].iov_base = bufs + (size_t)i * config->bufsize;
+      iovs[i].iov_len = config->bufsize;
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = SLEN;
+    }
 
-    if ((n = recvfrom(sockfd, mesg, BUFSIZE, 0, (SADDR *)&cliaddr, &len)) < 0) {
-      perror("recvfrom");
+    // MSG_WAITFORONE: ждём первую датаграмму, остальные - только уже пришедшие
+    int n = recvmmsg(worker->sockfd, msgs, batch, MSG_WAITFORONE, NULL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+      perror("recvmmsg");
       exit(1);
     }
-    mesg[n] = 0;
 
-    printf("REQUEST %s      FROM %s : %d\n", mesg,
-           inet_ntop(AF_INET, (void *)&cliaddr.sin_addr.s_addr, ipadr, 16),
-           ntohs(cliaddr.sin_port));
+    uint64_t bytes = 0;
+    for (int i = 0; i < n; i++) {
+      // Ответ - те же байты по адресу отправителя
+      iovs[i].iov_len = msgs[i].msg_len;
+      bytes += msgs[i].msg_len;
+      if (config->sample && (received + i) % config->sample == 0)
+        PrintRequest(iovs[i].iov_base, msgs[i].msg_len, &addrs[i]);
+    }
+    received += n;
+
+    int sent = 0;
+    while (sent < n) {
+      int done = sendmmsg(worker->sockfd, msgs + sent, n - sent, 0);
+      if (done < 0) {
+        if (errno == EINTR) continue;
+        // Ошибка одной датаграммы (например, ICMP от закрытого порта
+        // клиента) не должна останавливать остальные
+        sent++;
+        continue;
+      }
+      sent += done;
+      atomic_fetch_add_explicit(&worker->packets_out, done, memory_order_relaxed);
+    }
 
-    if (sendto(sockfd, mesg, n, 0, (SADDR *)&cliaddr, len) < 0) {
-      perror("sendto");
+    atomic_fetch_add_explicit(&worker->packets_in, n, memory_order_relaxed);
+    atomic_fetch_add_explicit(&worker->bytes_in, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&worker->batches, 1, memory_order_relaxed);
+  }
+
+  free(bufs);
+  free(msgs);
+  free(iovs);
+  free(addrs);
+  return NULL;
+}
+
+static void SumCounters(struct Worker *workers, int threads, uint64_t *packets_in,
+                        uint64_t *packets_out, uint64_t *bytes_in, uint64_t *batches) {
+  *packets_in = *packets_out = *bytes_in = *batches = 0;
+  for (int i = 0; i < threads; i++) {
+    *packets_in += atomic_load_explicit(&workers[i].packets_in, memory_order_relaxed);
+    *packets_out += atomic_load_explicit(&workers[i].packets_out, memory_order_relaxed);
+    *bytes_in += atomic_load_explicit(&workers[i].bytes_in, memory_order_relaxed);
+    *batches += atomic_load_explicit(&workers[i].batches, memory_order_relaxed);
+  }
+}
+
+int main(int argc, char **argv) {
+  struct ServerConfig config = {SERV_PORT, 1, BATCH, BUFSIZE, 0};
+  double stats_interval = 1.0;
+
+  while (true) {
+    static struct option options[] = {{"port", required_argument, 0, 0},
+                                      {"threads", required_argument, 0, 0},
+                                      {"batch", required_argument, 0, 0},
+                                      {"bufsize", required_argument, 0, 0},
+                                      {"sample", required_argument, 0, 0},
+                                      {"stats", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1) break;
+
+    if (c != 0) {
+      fprintf(stderr,
+              "Usage: %s [--port %d] [--threads 1] [--batch %d] [--bufsize %d] "
+              "[--sample N] [--stats seconds]\n",
+              argv[0], SERV_PORT, BATCH, BUFSIZE);
+      exit(1);
+    }
+
+    switch (option_index) {
+      case 0:
+        config.port = atoi(optarg);
+        if (config.port <= 0 || config.port > 65535) {
+          fprintf(stderr, "port must be in 1..65535\n");
+          exit(1);
+        }
+        break;
+      case 1:
+        config.threads = atoi(optarg);
+        if (config.threads <= 0) {
+          fprintf(stderr, "threads must be positive\n");
+          exit(1);
+        }
+        break;
+      case 2:
+        config.batch = atoi(optarg);
+        if (config.batch <= 0 || config.batch > 1024) {
+          fprintf(stderr, "batch must be in 1..1024\n");
+          exit(1);
+        }
+        break;
+      case 3:
+        config.bufsize = strtoul(optarg, NULL, 10);
+        if (config.bufsize == 0 || config.bufsize > 65536) {
+          fprintf(stderr, "bufsize must be in 1..65536\n");
+          exit(1);
+        }
+        break;
+      case 4:
+        config.sample = strtoull(optarg, NULL, 10);
+        break;
+      case 5:
+        stats_interval = atof(optarg);
+        break;
+    }
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = StopHandler;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  struct Worker *workers = calloc(config.threads, sizeof(struct Worker));
+  if (!workers) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  for (int i = 0; i < config.threads; i++) {
+    workers[i].id = i;
+    workers[i].config = &config;
+    workers[i].sockfd = OpenSocket(config.port);
+    if (workers[i].sockfd < 0) exit(1);
+  }
+  printf("SERVER starts on port %d: %d threads, batch %d\n", config.port,
+         config.threads, config.batch);
+  fflush(stdout);
+
+  double start = NowSeconds();
+  for (int i = 0; i < config.threads; i++) {
+    if (pthread_create(&workers[i].thread, NULL, WorkerMain, &workers[i]) != 0) {
+      perror("pthread_create");
       exit(1);
     }
   }
+
+  // Счётчики за интервал вместо строки на каждый пакет
+  uint64_t prev_in = 0, prev_out = 0;
+  double prev_time = start;
+  while (!stop_requested) {
+    if (stats_interval > 0) {
+      struct timespec interval = {(time_t)stats_interval,
+                                  (long)((stats_interval - (time_t)stats_interval) * 1e9)};
+      nanosleep(&interval, NULL);
+    } else {
+      pause();
+    }
+    if (stop_requested || stats_interval <= 0) break;
+
+    uint64_t in, out, bytes, batches;
+    SumCounters(workers, config.threads, &in, &out, &bytes, &batches);
+    double now = NowSeconds();
+    if (in != prev_in) {
+      printf("%.0f pps in, %.0f pps out, %llu packets total, %.1f per batch\n",
+             (in - prev_in) / (now - prev_time), (out - prev_out) / (now - prev_time),
+             (unsigned long long)in, batches ? (double)in / batches : 0.0);
+      fflush(stdout);
+    }
+    prev_in = in;
+    prev_out = out;
+    prev_time = now;
+  }
+
+  for (int i = 0; i < config.threads; i++) pthread_join(workers[i].thread, NULL);
+
+  uint64_t in, out, bytes, batches;
+  SumCounters(workers, config.threads, &in, &out, &bytes, &batches);
+  double seconds = NowSeconds() - start;
+  printf("Total: %llu packets in, %llu out, %.1f MB in %.1f s (%.0f pps), "
+         "%.1f packets per batch\n",
+         (unsigned long long)in, (unsigned long long)out, bytes / 1e6, seconds,
+         in / seconds, batches ? (double)in / batches : 0.0);
+
+  for (int i = 0; i < config.threads; i++) close(workers[i].sockfd);
+  free(workers);
+  return 0;
 }
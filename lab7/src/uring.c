@@ -0,0 +1,344 @@
+#define _GNU_SOURCE
+
+#include "uring.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Заголовок ядра может быть старше ядра; флаги, которых в нём нет
+#ifndef IORING_SETUP_COOP_TASKRUN
+#define IORING_SETUP_COOP_TASKRUN (1U << 8)
+#endif
+
+static int SysSetup(unsigned entries, struct io_uring_params *params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int SysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                    void *arg, size_t argsz) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg,
+                      argsz);
+}
+
+static int SysRegister(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Ядро пишет в хвост CQ и голову SQ из другого контекста, поэтому чтение
+// этих индексов - с acquire, а публикация своих - с release
+static unsigned LoadAcquire(const unsigned *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void StoreRelease(unsigned *p, unsigned v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static int Setup(unsigned entries, struct io_uring_params *params) {
+  // COOP_TASKRUN: завершения доставляются при следующем входе в ядро, без
+  // прерывания потока; старые ядра его не знают
+  memset(params, 0, sizeof(*params));
+  params->flags = IORING_SETUP_COOP_TASKRUN;
+  int fd = SysSetup(entries, params);
+  if (fd < 0 && errno == EINVAL) {
+    memset(params, 0, sizeof(*params));
+    fd = SysSetup(entries, params);
+  }
+  return fd;
+}
+
+bool UringInit(struct Uring *ring, unsigned entries) {
+  memset(ring, 0, sizeof(*ring));
+  struct io_uring_params params;
+  ring->fd = Setup(entries, &params);
+  if (ring->fd < 0) {
+    perror("io_uring_setup");
+    return false;
+  }
+  // Таймаут ожидания передаётся через IORING_ENTER_EXT_ARG (ядро 5.11+)
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    fprintf(stderr, "io_uring: kernel is too old (no IORING_FEAT_EXT_ARG)\n");
+    close(ring->fd);
+    return false;
+  }
+
+  ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_map_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+    perror("mmap io_uring");
+    if (ring->sq_map == MAP_FAILED) ring->sq_map = NULL;
+    if (ring->cq_map == MAP_FAILED) ring->cq_map = NULL;
+    if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+    UringDestroy(ring);
+    return false;
+  }
+
+  char *sq = ring->sq_map;
+  ring->sq_entries = params.sq_entries;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sqe_tail = *ring->sq_tail;
+  // Массив индексов SQ заполняется один раз: i-й слот - i-й SQE
+  unsigned *array = (unsigned *)(sq + params.sq_off.array);
+  for (unsigned i = 0; i < params.sq_entries; i++) array[i] = i;
+
+  char *cq = ring->cq_map;
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  return true;
+}
+
+void UringDestroy(struct Uring *ring) {
+  if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_map) munmap(ring->cq_map, ring->cq_map_size);
+  if (ring->sq_map) munmap(ring->sq_map, ring->sq_map_size);
+  if (ring->fd >= 0) close(ring->fd);
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+static int Enter(struct Uring *ring, unsigned wait_nr, int timeout_ms) {
+  StoreRelease(ring->sq_tail, ring->sqe_tail);
+  unsigned to_submit = ring->sqe_tail - LoadAcquire(ring->sq_head);
+
+  struct __kernel_timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000LL};
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = (uint64_t)(uintptr_t)&ts;
+
+  unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+  void *argp = NULL;
+  size_t argsz = 0;
+  if (wait_nr && timeout_ms >= 0) {
+    flags |= IORING_ENTER_EXT_ARG;
+    argp = &arg;
+    argsz = sizeof(arg);
+  }
+
+  while (true) {
+    int ret = SysEnter(ring->fd, to_submit, wait_nr, flags, argp, argsz);
+    if (ret >= 0) return ret;
+    if (errno == ETIME || errno == EINTR) return 0;
+    // Ядру не хватило памяти или CQ переполнена: отданное уже принято,
+    // остальное уйдёт со следующим вызовом
+    if (errno == EAGAIN || errno == EBUSY) return 0;
+    return -errno;
+  }
+}
+
+struct io_uring_sqe *UringGetSqe(struct Uring *ring) {
+  if (ring->sqe_tail - LoadAcquire(ring->sq_head) >= ring->sq_entries) {
+    if (Enter(ring, 0, 0) < 0) return NULL;
+    if (ring->sqe_tail - LoadAcquire(ring->sq_head) >= ring->sq_entries) return NULL;
+  }
+  struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sqe_tail++;
+  return sqe;
+}
+
+int UringSubmit(struct Uring *ring) { return Enter(ring, 0, 0); }
+
+int UringSubmitAndWait(struct Uring *ring, unsigned wait_nr, int timeout_ms) {
+  return Enter(ring, wait_nr, timeout_ms);
+}
+
+struct io_uring_cqe *UringPeekCqe(struct Uring *ring) {
+  unsigned head = *ring->cq_head;
+  if (head == LoadAcquire(ring->cq_tail)) return NULL;
+  return &ring->cqes[head & ring->cq_mask];
+}
+
+void UringCqeSeen(struct Uring *ring) { StoreRelease(ring->cq_head, *ring->cq_head + 1); }
+
+bool UringRegisterBuffer(struct Uring *ring, void *addr, size_t len) {
+  struct iovec iov = {addr, len};
+  if (SysRegister(ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+    perror("io_uring_register buffers");
+    return false;
+  }
+  return true;
+}
+
+static bool BufRingInit(struct Uring *ring, struct UringBufRing *bufs, uint16_t group,
+                        unsigned entries, size_t size, bool verbose) {
+  memset(bufs, 0, sizeof(*bufs));
+  bufs->entries = entries;
+  bufs->size = size;
+  bufs->group = group;
+
+  // Кольцо описателей должно начинаться с границы страницы
+  bufs->ring = mmap(NULL, entries * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  bufs->data = mmap(NULL, entries * size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (bufs->ring == MAP_FAILED || bufs->data == MAP_FAILED) {
+    if (verbose) perror("mmap buffer ring");
+    if (bufs->ring == MAP_FAILED) bufs->ring = NULL;
+    if (bufs->data == MAP_FAILED) bufs->data = NULL;
+    UringBufRingDestroy(bufs);
+    return false;
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)bufs->ring;
+  reg.ring_entries = entries;
+  reg.bgid = group;
+  if (SysRegister(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    // Ядра до 5.19 не знают IORING_REGISTER_PBUF_RING
+    if (verbose) perror("io_uring_register buffer ring");
+    UringBufRingDestroy(bufs);
+    return false;
+  }
+
+  for (unsigned i = 0; i < entries; i++) UringBufRingRecycle(bufs, i);
+  return true;
+}
+
+bool UringBufRingInit(struct Uring *ring, struct UringBufRing *bufs, uint16_t group,
+                      unsigned entries, size_t size) {
+  return BufRingInit(ring, bufs, group, entries, size, true);
+}
+
+void UringBufRingDestroy(struct UringBufRing *bufs) {
+  // Регистрация снимается вместе с кольцом io_uring
+  if (bufs->ring) munmap(bufs->ring, bufs->entries * sizeof(struct io_uring_buf));
+  if (bufs->data) munmap(bufs->data, bufs->entries * bufs->size);
+  memset(bufs, 0, sizeof(*bufs));
+}
+
+char *UringBufRingData(const struct UringBufRing *bufs, uint16_t bid) {
+  return bufs->data + (size_t)bid * bufs->size;
+}
+
+void UringBufRingRecycle(struct UringBufRing *bufs, uint16_t bid) {
+  struct io_uring_buf *buf = &bufs->ring->bufs[bufs->tail & (bufs->entries - 1)];
+  buf->addr = (uint64_t)(uintptr_t)UringBufRingData(bufs, bid);
+  buf->len = (uint32_t)bufs->size;
+  buf->bid = bid;
+  bufs->tail++;
+  __atomic_store_n(&bufs->ring->tail, bufs->tail, __ATOMIC_RELEASE);
+}
+
+// Опкоды, которые ставят tcpserver и tcpclient
+static const uint8_t required_ops[] = {IORING_OP_ACCEPT,     IORING_OP_RECV,
+                                       IORING_OP_SEND,       IORING_OP_READ_FIXED,
+                                       IORING_OP_WRITE_FIXED, IORING_OP_SHUTDOWN};
+
+static bool OpsSupported(const struct Uring *ring) {
+  size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *probe = calloc(1, size);
+  if (!probe) return false;
+  bool ok = SysRegister(ring->fd, IORING_REGISTER_PROBE, probe, 256) >= 0;
+  for (size_t i = 0; ok && i < sizeof(required_ops); i++) {
+    uint8_t op = required_ops[i];
+    ok = op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+  }
+  free(probe);
+  return ok;
+}
+
+// Ждать один CQE с данным user_data: true, если операция удалась и
+// multishot остался взведён (IORING_CQE_F_MORE)
+static bool WaitMultishot(struct Uring *ring, uint64_t user_data, int *res) {
+  if (UringSubmitAndWait(ring, 1, 1000) < 0) return false;
+  struct io_uring_cqe *cqe = UringPeekCqe(ring);
+  if (!cqe) return false;
+  bool ok = cqe->user_data == user_data && cqe->res >= 0 &&
+            (cqe->flags & IORING_CQE_F_MORE);
+  *res = cqe->res;
+  UringCqeSeen(ring);
+  return ok;
+}
+
+// Пробные multishot accept и multishot recv в кольцо выданных буферов через
+// loopback. Опкоды есть с 5.5-5.6, а multishot - только с 5.19 и 6.0:
+// на более старых ядрах они завершаются -EINVAL.
+static bool MultishotWorks(struct Uring *ring, const struct UringBufRing *bufs) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int client_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int accepted_fd = -1;
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  bool ok = listen_fd >= 0 && client_fd >= 0 &&
+            bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+            listen(listen_fd, 1) == 0 &&
+            getsockname(listen_fd, (struct sockaddr *)&addr, &len) == 0;
+
+  struct io_uring_sqe *sqe = ok ? UringGetSqe(ring) : NULL;
+  if (sqe) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = 1;
+    ok = UringSubmit(ring) >= 0 &&
+         connect(client_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+         WaitMultishot(ring, 1, &accepted_fd);
+  }
+  if (accepted_fd < 0) accepted_fd = -1;  // там мог остаться код ошибки
+
+  sqe = ok ? UringGetSqe(ring) : NULL;
+  if (sqe) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = accepted_fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bufs->group;
+    sqe->user_data = 2;
+    int received = 0;
+    ok = UringSubmit(ring) >= 0 && send(client_fd, "x", 1, MSG_NOSIGNAL) == 1 &&
+         WaitMultishot(ring, 2, &received) && received == 1;
+  } else {
+    ok = false;
+  }
+
+  // Взведённые операции отменит закрытие кольца вызывающим
+  if (accepted_fd >= 0) close(accepted_fd);
+  if (client_fd >= 0) close(client_fd);
+  if (listen_fd >= 0) close(listen_fd);
+  return ok;
+}
+
+bool UringSupported(void) {
+  struct io_uring_params params;
+  int fd = Setup(4, &params);
+  if (fd < 0) return false;
+  close(fd);
+  if (!(params.features & IORING_FEAT_EXT_ARG)) return false;
+
+  struct Uring ring;
+  struct UringBufRing bufs;
+  memset(&bufs, 0, sizeof(bufs));
+  if (!UringInit(&ring, 8)) return false;
+  bool ok = OpsSupported(&ring) && BufRingInit(&ring, &bufs, 0, 2, 64, false) &&
+            MultishotWorks(&ring, &bufs);
+  UringDestroy(&ring);
+  UringBufRingDestroy(&bufs);
+  return ok;
+}
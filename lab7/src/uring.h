@@ -0,0 +1,84 @@
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Минимальная обёртка над io_uring без liburing: кольца отображаются в
+// память напрямую, запросы передаются системными вызовами
+// io_uring_setup/io_uring_enter/io_uring_register.
+//
+// Запросы готовятся в SQ через UringGetSqe и уходят в ядро одним вызовом
+// UringSubmit/UringSubmitAndWait, сколько бы их ни было, - в этом и
+// выигрыш перед epoll, где каждое чтение и запись - отдельный вызов.
+// Кольцо рассчитано на один поток.
+
+struct Uring {
+  int fd;
+  unsigned sq_entries;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned sq_mask;
+  unsigned sqe_tail;  // следующий свободный SQE, ещё не видимый ядру
+  struct io_uring_sqe *sqes;
+
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_map;
+  size_t sq_map_size;
+  void *cq_map;
+  size_t cq_map_size;
+  size_t sqes_size;
+};
+
+// Кольцо выданных буферов (provided buffers): ядро само выбирает буфер
+// для recv в момент прихода данных, номер буфера приходит в CQE.
+// Буфер возвращается в кольцо через UringBufRingRecycle.
+struct UringBufRing {
+  struct io_uring_buf_ring *ring;
+  char *data;
+  unsigned entries;
+  size_t size;
+  uint16_t group;
+  uint16_t tail;
+};
+
+// false и сообщение в stderr, если io_uring недоступен (старое ядро,
+// запрет через kernel.io_uring_disabled, seccomp в контейнере)
+bool UringInit(struct Uring *ring, unsigned entries);
+void UringDestroy(struct Uring *ring);
+// Проба без сообщений: можно ли выбрать io_uring. Проверяется всё, на что
+// опираются tcpserver и tcpclient: таймаут ожидания (5.11), опкоды через
+// IORING_REGISTER_PROBE, кольцо выданных буферов (5.19) и пробные
+// multishot accept и recv (5.19 и 6.0).
+bool UringSupported(void);
+
+// Свободный SQE, обнулённый; при заполненной SQ готовые запросы
+// отправляются в ядро. NULL только при ошибке io_uring_enter.
+struct io_uring_sqe *UringGetSqe(struct Uring *ring);
+// Отправить подготовленные запросы; отрицательный errno при ошибке
+int UringSubmit(struct Uring *ring);
+// Отправить и дождаться wait_nr CQE, но не дольше timeout_ms (-1 - без
+// ограничения). Истёкший таймаут и сигнал ошибкой не считаются.
+int UringSubmitAndWait(struct Uring *ring, unsigned wait_nr, int timeout_ms);
+// Очередной CQE или NULL; после обработки - UringCqeSeen
+struct io_uring_cqe *UringPeekCqe(struct Uring *ring);
+void UringCqeSeen(struct Uring *ring);
+
+// Зарегистрировать область как буфер номер 0 для READ_FIXED/WRITE_FIXED:
+// ядро закрепляет страницы один раз, а не на каждую операцию
+bool UringRegisterBuffer(struct Uring *ring, void *addr, size_t len);
+
+// entries - степень двойки
+bool UringBufRingInit(struct Uring *ring, struct UringBufRing *bufs, uint16_t group,
+                      unsigned entries, size_t size);
+void UringBufRingDestroy(struct UringBufRing *bufs);
+char *UringBufRingData(const struct UringBufRing *bufs, uint16_t bid);
+void UringBufRingRecycle(struct UringBufRing *bufs, uint16_t bid);
+
+#endif  // URING_H
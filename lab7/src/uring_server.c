@@ -0,0 +1,314 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "uring.h"
+#include "uring_server.h"
+
+#define URING_ENTRIES 1024
+#define URING_WAIT_MS 200  // как таймаут epoll_wait: проверка сигнала остановки
+// stdout и discard: кольцо из URING_BUFS буферов по --bufsize. Мелкие
+// буферы дробят крупный поток на лишние CQE; степень двойки.
+#define URING_BUFS 32
+// echo: по куску зарегистрированной области на соединение
+#define URING_SLOTS 1024
+#define URING_SLICE_MAX (16 * 1024)
+
+// Тип операции в младших битах user_data, выше - указатель на соединение
+// (calloc выравнивает минимум на 8)
+enum UringOp { OP_ACCEPT, OP_RECV, OP_READ, OP_WRITE, OP_MASK = 7 };
+
+struct UringServer {
+  struct Uring ring;
+  struct UringBufRing bufs;
+  char *slices;
+  size_t slice_size;
+  char **free_slices;
+  int free_count;
+  uint64_t rejected;  // соединения без свободного куска для эха
+};
+
+static uint64_t Tag(const struct Connection *conn, enum UringOp op) {
+  return (uint64_t)(uintptr_t)conn | op;
+}
+
+static bool ArmAccept(struct Worker *worker) {
+  struct io_uring_sqe *sqe = UringGetSqe(&worker->uring->ring);
+  if (!sqe) return false;
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = worker->listen_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = Tag(NULL, OP_ACCEPT);
+  return true;
+}
+
+static bool ArmRecv(struct Worker *worker, struct Connection *conn) {
+  struct io_uring_sqe *sqe = UringGetSqe(&worker->uring->ring);
+  if (!sqe) return false;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = conn->fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = worker->uring->bufs.group;
+  sqe->user_data = Tag(conn, OP_RECV);
+  conn->inflight++;
+  return true;
+}
+
+static struct io_uring_sqe *PrepareFixed(struct Worker *worker, struct Connection *conn,
+                                         int opcode, char *addr, size_t len) {
+  struct io_uring_sqe *sqe = UringGetSqe(&worker->uring->ring);
+  if (!sqe) return NULL;
+  sqe->opcode = opcode;
+  sqe->fd = conn->fd;
+  sqe->addr = (uint64_t)(uintptr_t)addr;
+  sqe->len = (uint32_t)len;
+  sqe->buf_index = 0;  // вся область зарегистрирована одним буфером
+  sqe->user_data = Tag(conn, opcode == IORING_OP_READ_FIXED ? OP_READ : OP_WRITE);
+  conn->inflight++;
+  return sqe;
+}
+
+static bool QueueRead(struct Worker *worker, struct Connection *conn) {
+  return PrepareFixed(worker, conn, IORING_OP_READ_FIXED, conn->slice,
+                      worker->uring->slice_size) != NULL;
+}
+
+// Недописанное эхо и связанное с ним следующее чтение. Короткая запись
+// рвёт связь, чтение отменяется (-ECANCELED), и остаток ставится заново.
+static bool QueueEcho(struct Worker *worker, struct Connection *conn) {
+  struct io_uring_sqe *sqe =
+      PrepareFixed(worker, conn, IORING_OP_WRITE_FIXED, conn->slice + conn->write_done,
+                   conn->write_len - conn->write_done);
+  if (!sqe) return false;
+  sqe->flags = IOSQE_IO_LINK;
+  return QueueRead(worker, conn);
+}
+
+static void CloseConnection(struct Worker *worker, struct Connection *conn) {
+  struct UringServer *uring = worker->uring;
+  if (worker->config->mode == SINK_STDOUT) SinkLines(worker, conn, NULL, 0, true);
+  if (conn->slice) uring->free_slices[uring->free_count++] = conn->slice;
+  close(conn->fd);
+  free(conn->pending.data);
+  free(conn);
+}
+
+// Запросы по сокету в кольце держат ссылку на него, поэтому сокет не
+// закрывается, а останавливается: shutdown завершает ожидающие чтения,
+// и соединение закрывается с последним CQE
+static void StartClosing(struct Connection *conn) {
+  if (conn->closing) return;
+  conn->closing = true;
+  shutdown(conn->fd, SHUT_RDWR);
+}
+
+static void FinishCompletion(struct Worker *worker, struct Connection *conn) {
+  if (conn->closing && conn->inflight == 0) CloseConnection(worker, conn);
+}
+
+// Ошибки, после которых повторный accept вернёт то же самое: запрос
+// отвергнут (-EINVAL на ядре без multishot accept) или сокет негоден
+static bool AcceptFailedForGood(int res) {
+  return res == -EINVAL || res == -EBADF || res == -ENOTSOCK || res == -EFAULT;
+}
+
+static void HandleAccept(struct Worker *worker, const struct io_uring_cqe *cqe) {
+  struct UringServer *uring = worker->uring;
+  // Multishot accept снимается ядром при ошибке; ставим заново, если
+  // ошибка преходящая, иначе поток только дообслуживает соединения
+  if (!(cqe->flags & IORING_CQE_F_MORE)) {
+    if (AcceptFailedForGood(cqe->res))
+      fprintf(stderr, "Thread %d: accept stopped: %s\n", worker->id,
+              strerror(-cqe->res));
+    else if (!ArmAccept(worker))
+      fprintf(stderr, "Thread %d: can not arm accept\n", worker->id);
+  }
+  if (AcceptFailedForGood(cqe->res)) return;
+  if (cqe->res < 0) {
+    if (cqe->res != -EINTR && cqe->res != -EAGAIN)
+      fprintf(stderr, "accept: %s\n", strerror(-cqe->res));
+    return;
+  }
+
+  struct Connection *conn = calloc(1, sizeof(struct Connection));
+  if (!conn) {
+    fprintf(stderr, "Memory allocation failed\n");
+    close(cqe->res);
+    return;
+  }
+  conn->fd = cqe->res;
+  worker->connections++;
+
+  bool ok;
+  if (worker->config->mode == SINK_ECHO) {
+    if (uring->free_count == 0) {
+      uring->rejected++;
+      close(conn->fd);
+      free(conn);
+      return;
+    }
+    conn->slice = uring->free_slices[--uring->free_count];
+    ok = QueueRead(worker, conn);
+  } else {
+    ok = ArmRecv(worker, conn);
+  }
+  if (!ok) {
+    StartClosing(conn);
+    FinishCompletion(worker, conn);
+  }
+}
+
+static void HandleRecv(struct Worker *worker, struct Connection *conn,
+                       const struct io_uring_cqe *cqe) {
+  struct UringServer *uring = worker->uring;
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  if (!more) conn->inflight--;
+
+  if (cqe->res > 0) {
+    uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    worker->bytes_in += cqe->res;
+    if (!conn->closing && worker->config->mode == SINK_STDOUT &&
+        !SinkLines(worker, conn, UringBufRingData(&uring->bufs, bid), cqe->res, false))
+      StartClosing(conn);
+    UringBufRingRecycle(&uring->bufs, bid);
+    if (!more && !conn->closing && !ArmRecv(worker, conn)) StartClosing(conn);
+  } else if (cqe->res == -ENOBUFS && !conn->closing) {
+    // Кольцо буферов опустело; они уже возвращены, пока разбирались CQE
+    if (!ArmRecv(worker, conn)) StartClosing(conn);
+  } else {
+    if (cqe->res < 0 && cqe->res != -ECONNRESET && cqe->res != -ENOBUFS)
+      fprintf(stderr, "recv: %s\n", strerror(-cqe->res));
+    StartClosing(conn);
+  }
+  FinishCompletion(worker, conn);
+}
+
+static void HandleRead(struct Worker *worker, struct Connection *conn,
+                       const struct io_uring_cqe *cqe) {
+  conn->inflight--;
+  if (cqe->res > 0 && !conn->closing) {
+    worker->bytes_in += cqe->res;
+    conn->write_len = cqe->res;
+    conn->write_done = 0;
+    if (!QueueEcho(worker, conn)) StartClosing(conn);
+  } else if (cqe->res != -ECANCELED) {
+    // EOF: всё прочитанное уже отправлено - запись стоит перед чтением
+    if (cqe->res < 0 && cqe->res != -ECONNRESET)
+      fprintf(stderr, "read: %s\n", strerror(-cqe->res));
+    StartClosing(conn);
+  }
+  FinishCompletion(worker, conn);
+}
+
+static void HandleWrite(struct Worker *worker, struct Connection *conn,
+                        const struct io_uring_cqe *cqe) {
+  conn->inflight--;
+  if (cqe->res < 0) {
+    if (cqe->res != -ECANCELED && cqe->res != -EPIPE && cqe->res != -ECONNRESET)
+      fprintf(stderr, "write: %s\n", strerror(-cqe->res));
+    StartClosing(conn);
+  } else {
+    worker->bytes_out += cqe->res;
+    conn->write_done += cqe->res;
+    if (conn->write_done < conn->write_len && !conn->closing &&
+        !QueueEcho(worker, conn))
+      StartClosing(conn);
+  }
+  FinishCompletion(worker, conn);
+}
+
+bool UringServerInit(struct Worker *worker) {
+  const struct ServerConfig *config = worker->config;
+  struct UringServer *uring = calloc(1, sizeof(struct UringServer));
+  if (!uring) return false;
+  worker->uring = uring;
+
+  // Ожидание берёт на себя io_uring; с O_NONBLOCK accept вернул бы EAGAIN
+  int flags = fcntl(worker->listen_fd, F_GETFL);
+  fcntl(worker->listen_fd, F_SETFL, flags & ~O_NONBLOCK);
+
+  if (!UringInit(&uring->ring, URING_ENTRIES)) return false;
+
+  if (config->mode == SINK_ECHO) {
+    uring->slice_size =
+        config->bufsize < URING_SLICE_MAX ? config->bufsize : URING_SLICE_MAX;
+    size_t size = URING_SLOTS * uring->slice_size;
+    uring->slices = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1, 0);
+    uring->free_slices = malloc(URING_SLOTS * sizeof(char *));
+    if (uring->slices == MAP_FAILED || !uring->free_slices) {
+      uring->slices = NULL;
+      return false;
+    }
+    if (!UringRegisterBuffer(&uring->ring, uring->slices, size)) return false;
+    for (int i = URING_SLOTS - 1; i >= 0; i--)
+      uring->free_slices[uring->free_count++] = uring->slices + i * uring->slice_size;
+  } else {
+    if (!UringBufRingInit(&uring->ring, &uring->bufs, 0, URING_BUFS, config->bufsize))
+      return false;
+  }
+  return ArmAccept(worker);
+}
+
+void UringServerDestroy(struct Worker *worker) {
+  struct UringServer *uring = worker->uring;
+  if (!uring) return;
+  if (uring->rejected)
+    fprintf(stderr, "Thread %d: %llu connections rejected, all %d echo buffers busy\n",
+            worker->id, (unsigned long long)uring->rejected, URING_SLOTS);
+  // Сначала кольцо: ядро отпускает зарегистрированную память
+  UringDestroy(&uring->ring);
+  UringBufRingDestroy(&uring->bufs);
+  if (uring->slices) munmap(uring->slices, URING_SLOTS * uring->slice_size);
+  free(uring->free_slices);
+  free(uring);
+  worker->uring = NULL;
+}
+
+void *UringServerMain(void *arg) {
+  struct Worker *worker = arg;
+  struct Uring *ring = &worker->uring->ring;
+
+  while (!StopRequested()) {
+    int ret = UringSubmitAndWait(ring, 1, URING_WAIT_MS);
+    if (ret < 0) {
+      fprintf(stderr, "io_uring_enter: %s\n", strerror(-ret));
+      break;
+    }
+
+    struct io_uring_cqe *slot;
+    while ((slot = UringPeekCqe(ring))) {
+      // Копия освобождает место в CQ до того, как обработчик поставит
+      // новые запросы
+      struct io_uring_cqe cqe = *slot;
+      UringCqeSeen(ring);
+
+      struct Connection *conn =
+          (struct Connection *)(uintptr_t)(cqe.user_data & ~(uint64_t)OP_MASK);
+      switch (cqe.user_data & OP_MASK) {
+        case OP_ACCEPT:
+          HandleAccept(worker, &cqe);
+          break;
+        case OP_RECV:
+          HandleRecv(worker, conn, &cqe);
+          break;
+        case OP_READ:
+          HandleRead(worker, conn, &cqe);
+          break;
+        case OP_WRITE:
+          HandleWrite(worker, conn, &cqe);
+          break;
+      }
+    }
+  }
+  return NULL;
+}
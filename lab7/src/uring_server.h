@@ -0,0 +1,22 @@
+#ifndef URING_SERVER_H
+#define URING_SERVER_H
+
+#include "tcpserver.h"
+
+// Цикл потока tcpserver на io_uring (--engine uring) для режимов stdout,
+// discard и echo. Вместо epoll_wait и системного вызова на каждое чтение
+// все операции потока ставятся в его кольцо и отправляются пачкой:
+//
+//   - слушающий сокет обслуживает один multishot accept;
+//   - stdout и discard: один multishot recv на соединение, буфер ядро
+//     берёт из кольца выданных буферов потока и возвращает номер в CQE;
+//   - echo: у соединения свой кусок зарегистрированной области, запись
+//     эха и следующее чтение в тот же кусок связаны (IOSQE_IO_LINK) и
+//     уходят вместе; чтение начнётся только после записи, так что клиент,
+//     который не забирает эхо, упирается в окно TCP.
+
+bool UringServerInit(struct Worker *worker);
+void UringServerDestroy(struct Worker *worker);
+void *UringServerMain(void *arg);
+
+#endif  // URING_SERVER_H
@@ -0,0 +1,280 @@
+#include "extrema.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EXTREMA_X86 1
+#endif
+
+enum ExtremaKernel {
+    KERNEL_SCALAR,
+    KERNEL_SSE4,
+    KERNEL_AVX2,
+    KERNEL_AVX512
+};
+
+static const struct {
+    const char *name;
+    enum ExtremaKernel kernel;
+} extrema_kernels[] = {
+    {"avx512", KERNEL_AVX512},
+    {"avx2", KERNEL_AVX2},
+    {"sse4", KERNEL_SSE4},
+    {"scalar", KERNEL_SCALAR},
+};
+
+#define EXTREMA_KERNELS_NUM \
+    ((int)(sizeof(extrema_kernels) / sizeof(extrema_kernels[0])))
+
+static int extrema_kernel_index = EXTREMA_KERNELS_NUM - 1;
+
+// Индексы в векторных ядрах 32-битные для 32-битных типов, поэтому
+// массив обрабатывается блоками не длиннее 2^30 элементов
+#define EXTREMA_BLOCK ((size_t)1 << 30)
+
+// Слияние и скалярный проход. x != x истинно только для NaN; для целых
+// типов компилятор выбрасывает эту проверку.
+#define EXTREMA_SCALAR(Suffix, T)                                            \
+    void MergeExtrema##Suffix(struct Extrema##Suffix *acc,                   \
+                              const struct Extrema##Suffix *part) {          \
+        if (part->argmin != EXTREMA_NONE &&                                  \
+            (acc->argmin == EXTREMA_NONE || part->min < acc->min ||          \
+             (part->min == acc->min && part->argmin < acc->argmin))) {       \
+            acc->min = part->min;                                            \
+            acc->argmin = part->argmin;                                      \
+        }                                                                    \
+        if (part->argmax != EXTREMA_NONE &&                                  \
+            (acc->argmax == EXTREMA_NONE || part->max > acc->max ||          \
+             (part->max == acc->max && part->argmax < acc->argmax))) {       \
+            acc->max = part->max;                                            \
+            acc->argmax = part->argmax;                                      \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    static void Scan##Suffix(const T *array, size_t begin, size_t end,       \
+                             struct Extrema##Suffix *acc, bool *saw_nan) {   \
+        for (size_t i = begin; i < end; i++) {                               \
+            T x = array[i];                                                  \
+            if (x != x) {                                                    \
+                *saw_nan = true;                                             \
+                continue;                                                    \
+            }                                                                \
+            if (acc->argmin == EXTREMA_NONE || x < acc->min) {               \
+                acc->min = x;                                                \
+                acc->argmin = i;                                             \
+            }                                                                \
+            if (acc->argmax == EXTREMA_NONE || x > acc->max) {               \
+                acc->max = x;                                                \
+                acc->argmax = i;                                             \
+            }                                                                \
+        }                                                                    \
+    }
+
+#ifdef EXTREMA_X86
+
+// Векторное ядро на векторных расширениях GCC: один и тот же текст
+// собирается под SSE4.2, AVX2 и AVX-512 атрибутом target.
+//
+// В каждой дорожке хранятся текущие min/max и их индексы; обновление
+// только при строгом неравенстве, поэтому в дорожке остаётся первое
+// вхождение. Дорожка, начавшаяся с NaN, принимает первое не-NaN
+// значение. Маски сравнения - целые векторы из 0 и -1, выбор значений
+// делается побитово без ветвлений.
+#define EXTREMA_SIMD(Suffix, T, IT, Level, Bytes, Target)                     \
+    typedef T Vec##Suffix##Level __attribute__((vector_size(Bytes)));        \
+    typedef IT IVec##Suffix##Level __attribute__((vector_size(Bytes)));      \
+                                                                             \
+    __attribute__((target(Target)))                                          \
+    static void Simd##Suffix##Level(const T *array, size_t begin, size_t end, \
+                                    struct Extrema##Suffix *acc,             \
+                                    bool *saw_nan) {                         \
+        typedef Vec##Suffix##Level Vec;                                      \
+        typedef IVec##Suffix##Level IVec;                                    \
+        enum { L = Bytes / sizeof(T) };                                      \
+        if (end - begin < 2 * L) {                                           \
+            Scan##Suffix(array, begin, end, acc, saw_nan);                   \
+            return;                                                          \
+        }                                                                    \
+                                                                             \
+        Vec min, max, x;                                                     \
+        IVec idx, imin, imax;                                                \
+        IT lanes[L];                                                         \
+        for (int j = 0; j < L; j++)                                          \
+            lanes[j] = (IT)j;                                                \
+        memcpy(&idx, lanes, sizeof(idx));                                    \
+        memcpy(&min, array + begin, sizeof(min));                            \
+        max = min;                                                           \
+        imin = idx;                                                          \
+        imax = idx;                                                          \
+        IVec nan = (IVec)(min != min);                                       \
+                                                                             \
+        size_t i = begin + L;                                                \
+        for (; i + L <= end; i += L) {                                       \
+            memcpy(&x, array + i, sizeof(x));                                \
+            idx += (IT)L;                                                    \
+            IVec x_nan = (IVec)(x != x);                                     \
+            nan |= x_nan;                                                    \
+            IVec lt = (IVec)(x < min) | ((IVec)(min != min) & ~x_nan);       \
+            IVec gt = (IVec)(x > max) | ((IVec)(max != max) & ~x_nan);       \
+            min = (Vec)(((IVec)x & lt) | ((IVec)min & ~lt));                 \
+            max = (Vec)(((IVec)x & gt) | ((IVec)max & ~gt));                 \
+            imin = (idx & lt) | (imin & ~lt);                                \
+            imax = (idx & gt) | (imax & ~gt);                                \
+        }                                                                    \
+                                                                             \
+        T mins[L], maxs[L];                                                  \
+        IT imins[L], imaxs[L], nans[L];                                      \
+        memcpy(mins, &min, sizeof(min));                                     \
+        memcpy(maxs, &max, sizeof(max));                                     \
+        memcpy(imins, &imin, sizeof(imin));                                  \
+        memcpy(imaxs, &imax, sizeof(imax));                                  \
+        memcpy(nans, &nan, sizeof(nan));                                     \
+        for (int j = 0; j < L; j++) {                                        \
+            if (nans[j])                                                     \
+                *saw_nan = true;                                             \
+            if (mins[j] != mins[j])                                          \
+                continue; /* в дорожке только NaN */                         \
+            struct Extrema##Suffix part = {                                  \
+                mins[j], maxs[j], begin + (size_t)imins[j],                  \
+                begin + (size_t)imaxs[j]};                                   \
+            MergeExtrema##Suffix(acc, &part);                                \
+        }                                                                    \
+        Scan##Suffix(array, i, end, acc, saw_nan);                           \
+    }
+
+#define EXTREMA_SIMD_ALL(Suffix, T, IT)                                      \
+    EXTREMA_SIMD(Suffix, T, IT, Sse4, 16, "sse4.2")                          \
+    EXTREMA_SIMD(Suffix, T, IT, Avx2, 32, "avx2")                            \
+    EXTREMA_SIMD(Suffix, T, IT, Avx512, 64, "avx512f")
+
+#define EXTREMA_DISPATCH(Suffix, array, begin, end, acc, saw_nan)            \
+    switch (extrema_kernels[extrema_kernel_index].kernel) {                  \
+        case KERNEL_AVX512:                                                  \
+            Simd##Suffix##Avx512(array, begin, end, acc, saw_nan);           \
+            break;                                                           \
+        case KERNEL_AVX2:                                                    \
+            Simd##Suffix##Avx2(array, begin, end, acc, saw_nan);             \
+            break;                                                           \
+        case KERNEL_SSE4:                                                    \
+            Simd##Suffix##Sse4(array, begin, end, acc, saw_nan);             \
+            break;                                                           \
+        default:                                                             \
+            Scan##Suffix(array, begin, end, acc, saw_nan);                   \
+    }
+
+#else
+
+#define EXTREMA_SIMD_ALL(Suffix, T, IT)
+#define EXTREMA_DISPATCH(Suffix, array, begin, end, acc, saw_nan) \
+    Scan##Suffix(array, begin, end, acc, saw_nan)
+
+#endif
+
+#define EXTREMA_FIND(Suffix, T)                                              \
+    static struct Extrema##Suffix Find##Suffix(const T *array, size_t count, \
+                                               bool *saw_nan) {              \
+        struct Extrema##Suffix acc;                                          \
+        memset(&acc, 0, sizeof(acc));                                        \
+        acc.argmin = EXTREMA_NONE;                                           \
+        acc.argmax = EXTREMA_NONE;                                           \
+        *saw_nan = false;                                                    \
+        for (size_t begin = 0; begin < count; begin += EXTREMA_BLOCK) {      \
+            size_t end = count - begin > EXTREMA_BLOCK ? begin + EXTREMA_BLOCK \
+                                                       : count;              \
+            EXTREMA_DISPATCH(Suffix, array, begin, end, &acc, saw_nan)       \
+        }                                                                    \
+        return acc;                                                          \
+    }
+
+#define EXTREMA_DEFINE(Suffix, T, IT) \
+    EXTREMA_SCALAR(Suffix, T)         \
+    EXTREMA_SIMD_ALL(Suffix, T, IT)   \
+    EXTREMA_FIND(Suffix, T)
+
+EXTREMA_DEFINE(I32, int32_t, int32_t)
+EXTREMA_DEFINE(I64, int64_t, int64_t)
+EXTREMA_DEFINE(U32, uint32_t, int32_t)
+EXTREMA_DEFINE(F32, float, int32_t)
+EXTREMA_DEFINE(F64, double, int64_t)
+
+struct ExtremaI32 FindExtremaI32(const int32_t *array, size_t count) {
+    bool saw_nan;
+    return FindI32(array, count, &saw_nan);
+}
+
+struct ExtremaI64 FindExtremaI64(const int64_t *array, size_t count) {
+    bool saw_nan;
+    return FindI64(array, count, &saw_nan);
+}
+
+struct ExtremaU32 FindExtremaU32(const uint32_t *array, size_t count) {
+    bool saw_nan;
+    return FindU32(array, count, &saw_nan);
+}
+
+// Для политики PROPAGATE индекс первого NaN ищется вторым проходом,
+// только если NaN действительно встретился
+#define EXTREMA_APPLY_NAN_POLICY(result, array, count, saw_nan, nan_policy)  \
+    do {                                                                     \
+        if (saw_nan && nan_policy == EXTREMA_NAN_PROPAGATE) {                \
+            size_t first = 0;                                                \
+            while (array[first] == array[first])                             \
+                first++;                                                     \
+            result.min = result.max = array[first];                          \
+            result.argmin = result.argmax = first;                           \
+        } else if (result.argmin == EXTREMA_NONE && count > 0) {             \
+            result.min = result.max = array[0]; /* все элементы NaN */       \
+        }                                                                    \
+    } while (0)
+
+struct ExtremaF32 FindExtremaF32(const float *array, size_t count,
+                                 enum ExtremaNanPolicy nan_policy) {
+    bool saw_nan;
+    struct ExtremaF32 result = FindF32(array, count, &saw_nan);
+    EXTREMA_APPLY_NAN_POLICY(result, array, count, saw_nan, nan_policy);
+    return result;
+}
+
+struct ExtremaF64 FindExtremaF64(const double *array, size_t count,
+                                 enum ExtremaNanPolicy nan_policy) {
+    bool saw_nan;
+    struct ExtremaF64 result = FindF64(array, count, &saw_nan);
+    EXTREMA_APPLY_NAN_POLICY(result, array, count, saw_nan, nan_policy);
+    return result;
+}
+
+static bool KernelSupported(enum ExtremaKernel kernel) {
+#ifdef EXTREMA_X86
+    switch (kernel) {
+        case KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case KERNEL_SSE4:
+            return __builtin_cpu_supports("sse4.2");
+        default:
+            return true;
+    }
+#else
+    return kernel == KERNEL_SCALAR;
+#endif
+}
+
+int ExtremaSelectKernel(const char *name) {
+    for (int i = 0; i < EXTREMA_KERNELS_NUM; i++) {
+        if (name != NULL && strcmp(name, extrema_kernels[i].name) != 0)
+            continue;
+        if (!KernelSupported(extrema_kernels[i].kernel)) {
+            if (name != NULL)
+                return -1;
+            continue;
+        }
+        extrema_kernel_index = i;
+        return 0;
+    }
+    return -1;
+}
+
+const char *ExtremaKernelName(void) {
+    return extrema_kernels[extrema_kernel_index].name;
+}
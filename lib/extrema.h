@@ -0,0 +1,58 @@
+#ifndef EXTREMA_H
+#define EXTREMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Поиск минимума, максимума и их индексов за один проход по массиву.
+//
+// Для каждого типа элементов своя функция FindExtrema<Тип>; все они
+// собраны из одного шаблона и векторизуются (SSE4.2, AVX2, AVX-512) с
+// выбором ядра во время выполнения. Индекс - позиция первого вхождения
+// экстремума. Для пустого массива (и для массива из одних NaN)
+// argmin = argmax = EXTREMA_NONE.
+
+#define EXTREMA_NONE SIZE_MAX
+
+// Обработка NaN в float/double
+enum ExtremaNanPolicy {
+    EXTREMA_NAN_IGNORE,     // NaN пропускаются
+    EXTREMA_NAN_PROPAGATE   // любой NaN - результат NaN с индексом первого NaN
+};
+
+#define EXTREMA_DECLARE(Suffix, T)                                        \
+    struct Extrema##Suffix {                                             \
+        T min;                                                           \
+        T max;                                                           \
+        size_t argmin;                                                   \
+        size_t argmax;                                                   \
+    };                                                                   \
+                                                                         \
+    /* Слияние результатов соседних частей; индексы part должны быть  */ \
+    /* уже сдвинуты к общему началу                                  */ \
+    void MergeExtrema##Suffix(struct Extrema##Suffix *acc,               \
+                              const struct Extrema##Suffix *part);
+
+EXTREMA_DECLARE(I32, int32_t)
+EXTREMA_DECLARE(I64, int64_t)
+EXTREMA_DECLARE(U32, uint32_t)
+EXTREMA_DECLARE(F32, float)
+EXTREMA_DECLARE(F64, double)
+
+struct ExtremaI32 FindExtremaI32(const int32_t *array, size_t count);
+struct ExtremaI64 FindExtremaI64(const int64_t *array, size_t count);
+struct ExtremaU32 FindExtremaU32(const uint32_t *array, size_t count);
+struct ExtremaF32 FindExtremaF32(const float *array, size_t count,
+                                 enum ExtremaNanPolicy nan_policy);
+struct ExtremaF64 FindExtremaF64(const double *array, size_t count,
+                                 enum ExtremaNanPolicy nan_policy);
+
+// Выбор ядра по имени ("scalar", "sse4", "avx2", "avx512") или, при
+// name == NULL, самого широкого из поддерживаемых процессором.
+// 0 при успехе, -1 если ядро неизвестно или не поддерживается.
+// До первого вызова используется scalar.
+int ExtremaSelectKernel(const char *name);
+const char *ExtremaKernelName(void);
+
+#endif // EXTREMA_H
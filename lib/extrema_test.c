@@ -0,0 +1,219 @@
+// Проверка ядер extrema.h: каждое поддерживаемое процессором ядро
+// сравнивается с простым скалярным эталоном на случайных массивах всех
+// типов - с повторами экстремумов, ±0, бесконечностями и NaN, с обеими
+// политиками NaN и невыровненным началом. Разбиение на две части и
+// MergeExtrema должны давать тот же ответ, что и весь массив.
+//
+//   ./extrema_test [seed]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extrema.h"
+
+#define MAX_COUNT 5000
+#define ROUNDS 300
+
+static const char *kernels[] = {"scalar", "sse4", "avx2", "avx512"};
+
+static uint64_t rng_state;
+
+static uint64_t Random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Длина: часто короче вектора и около границ векторов, иногда длинная
+static size_t RandomCount(void) {
+    switch (Random() % 4) {
+        case 0:
+            return Random() % 20;
+        case 1:
+            return Random() % 200;
+        default:
+            return Random() % MAX_COUNT;
+    }
+}
+
+// Значение: из узкого диапазона (много повторов) или из всего диапазона
+static int64_t RandomInt(int64_t narrow, uint64_t mask) {
+    if (Random() % 2)
+        return (int64_t)(Random() % (uint64_t)narrow) - narrow / 2;
+    return (int64_t)(Random() & mask);
+}
+
+static double RandomFloat(double nan_share) {
+    if ((double)(Random() % 1000) < nan_share * 1000)
+        return NAN;
+    switch (Random() % 8) {
+        case 0:
+            return (Random() % 2) ? 0.0 : -0.0;
+        case 1:
+            return (Random() % 2) ? INFINITY : -INFINITY;
+        case 2:
+            return (double)(int64_t)Random() / 3.0;
+        default:
+            return (double)(int)(Random() % 16) - 8;  // повторы
+    }
+}
+
+static int failures;
+
+// Эталон и проверка одного массива для типа с суффиксом Suffix.
+// IS_NAN - проверка на NaN (0 для целых); Find##Suffix - обёртки ниже,
+// у целых типов политика NaN отбрасывается.
+#define EXTREMA_CHECK(Suffix, T, IS_NAN)                                      \
+    static struct Extrema##Suffix Reference##Suffix(                          \
+        const T *array, size_t count, enum ExtremaNanPolicy nan_policy) {     \
+        struct Extrema##Suffix r;                                             \
+        memset(&r, 0, sizeof(r));                                             \
+        r.argmin = r.argmax = EXTREMA_NONE;                                   \
+        for (size_t i = 0; i < count; i++) {                                  \
+            if (IS_NAN(array[i])) {                                           \
+                if (nan_policy == EXTREMA_NAN_PROPAGATE) {                    \
+                    r.argmin = r.argmax = i;                                  \
+                    r.min = r.max = array[i];                                 \
+                    return r;                                                 \
+                }                                                             \
+                continue;                                                     \
+            }                                                                 \
+            if (r.argmin == EXTREMA_NONE || array[i] < r.min) {               \
+                r.min = array[i];                                             \
+                r.argmin = i;                                                 \
+            }                                                                 \
+            if (r.argmax == EXTREMA_NONE || array[i] > r.max) {               \
+                r.max = array[i];                                             \
+                r.argmax = i;                                                 \
+            }                                                                 \
+        }                                                                     \
+        return r;                                                             \
+    }                                                                         \
+                                                                              \
+    /* Индексы совпадают, значения - это элементы по этим индексам */        \
+    static int Same##Suffix(const struct Extrema##Suffix *got,                \
+                            const struct Extrema##Suffix *want,               \
+                            const T *array) {                                 \
+        if (got->argmin != want->argmin || got->argmax != want->argmax)       \
+            return 0;                                                         \
+        if (got->argmin != EXTREMA_NONE &&                                    \
+            memcmp(&got->min, &array[got->argmin], sizeof(T)) != 0)           \
+            return 0;                                                         \
+        if (got->argmax != EXTREMA_NONE &&                                    \
+            memcmp(&got->max, &array[got->argmax], sizeof(T)) != 0)           \
+            return 0;                                                         \
+        return 1;                                                             \
+    }                                                                         \
+                                                                              \
+    static void Check##Suffix(const char *kernel, const T *array,             \
+                              size_t count, enum ExtremaNanPolicy nan_policy) \
+    {                                                                         \
+        struct Extrema##Suffix want =                                         \
+            Reference##Suffix(array, count, nan_policy);                      \
+        struct Extrema##Suffix got =                                          \
+            Find##Suffix(array, count, nan_policy);                           \
+                                                                              \
+        /* Две части, слитые MergeExtrema, - тот же ответ. Слияние      */ \
+        /* NaN не знает, поэтому части ищутся с IGNORE                  */ \
+        size_t half = count ? Random() % (count + 1) : 0;                     \
+        struct Extrema##Suffix merged =                                       \
+            Find##Suffix(array, half, EXTREMA_NAN_IGNORE);                    \
+        struct Extrema##Suffix tail =                                         \
+            Find##Suffix(array + half, count - half, EXTREMA_NAN_IGNORE);     \
+        if (tail.argmin != EXTREMA_NONE)                                      \
+            tail.argmin += half;                                              \
+        if (tail.argmax != EXTREMA_NONE)                                      \
+            tail.argmax += half;                                              \
+        MergeExtrema##Suffix(&merged, &tail);                                 \
+        struct Extrema##Suffix want_merged =                                  \
+            Reference##Suffix(array, count, EXTREMA_NAN_IGNORE);              \
+                                                                              \
+        if (!Same##Suffix(&got, &want, array) ||                              \
+            !Same##Suffix(&merged, &want_merged, array)) {                    \
+            failures++;                                                       \
+            fprintf(stderr,                                                   \
+                    "%s " #Suffix " count %zu policy %d: argmin %zu/%zu "     \
+                    "argmax %zu/%zu, merged %zu/%zu %zu/%zu\n",               \
+                    kernel, count, (int)nan_policy, got.argmin, want.argmin,  \
+                    got.argmax, want.argmax, merged.argmin,                   \
+                    want_merged.argmin, merged.argmax, want_merged.argmax);   \
+        }                                                                     \
+    }
+
+#define NOT_NAN(x) 0
+#define FLOAT_NAN(x) ((x) != (x))
+
+// FindExtrema для целых типов без политики NaN
+#define FindI32(array, count, policy) FindExtremaI32(array, count)
+#define FindI64(array, count, policy) FindExtremaI64(array, count)
+#define FindU32(array, count, policy) FindExtremaU32(array, count)
+#define FindF32(array, count, policy) FindExtremaF32(array, count, policy)
+#define FindF64(array, count, policy) FindExtremaF64(array, count, policy)
+
+EXTREMA_CHECK(I32, int32_t, NOT_NAN)
+EXTREMA_CHECK(I64, int64_t, NOT_NAN)
+EXTREMA_CHECK(U32, uint32_t, NOT_NAN)
+EXTREMA_CHECK(F32, float, FLOAT_NAN)
+EXTREMA_CHECK(F64, double, FLOAT_NAN)
+
+// Запас в начале: проверки идут и с невыровненного адреса
+#define OFFSET_MAX 7
+
+static void CheckKernel(const char *kernel) {
+    static int32_t i32[MAX_COUNT + OFFSET_MAX];
+    static int64_t i64[MAX_COUNT + OFFSET_MAX];
+    static uint32_t u32[MAX_COUNT + OFFSET_MAX];
+    static float f32[MAX_COUNT + OFFSET_MAX];
+    static double f64[MAX_COUNT + OFFSET_MAX];
+    static const double nan_shares[] = {0, 0.001, 0.05, 0.5, 1};
+
+    for (int round = 0; round < ROUNDS; round++) {
+        size_t count = RandomCount();
+        size_t offset = Random() % (OFFSET_MAX + 1);
+        double nan_share = nan_shares[Random() % 5];
+
+        for (size_t i = 0; i < count; i++) {
+            i32[offset + i] = (int32_t)RandomInt(64, UINT32_MAX);
+            i64[offset + i] = RandomInt(64, UINT64_MAX);
+            // Верхняя половина диапазона проверяет беззнаковое сравнение
+            u32[offset + i] = (uint32_t)RandomInt(64, UINT32_MAX);
+            f32[offset + i] = (float)RandomFloat(nan_share);
+            f64[offset + i] = RandomFloat(nan_share);
+        }
+
+        CheckI32(kernel, i32 + offset, count, EXTREMA_NAN_IGNORE);
+        CheckI64(kernel, i64 + offset, count, EXTREMA_NAN_IGNORE);
+        CheckU32(kernel, u32 + offset, count, EXTREMA_NAN_IGNORE);
+        for (int policy = EXTREMA_NAN_IGNORE; policy <= EXTREMA_NAN_PROPAGATE; policy++) {
+            CheckF32(kernel, f32 + offset, count, policy);
+            CheckF64(kernel, f64 + offset, count, policy);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    rng_state = argc > 1 ? strtoull(argv[1], NULL, 10) : 20240601;
+    if (rng_state == 0)
+        rng_state = 1;
+
+    int checked = 0;
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (ExtremaSelectKernel(kernels[k]) != 0) {
+            printf("%-7s not supported by this CPU, skipped\n", kernels[k]);
+            continue;
+        }
+        int before = failures;
+        CheckKernel(kernels[k]);
+        printf("%-7s %s\n", kernels[k], failures == before ? "ok" : "FAILED");
+        checked++;
+    }
+
+    if (checked == 0 || failures > 0) {
+        fprintf(stderr, "%d mismatches\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "reduce.h"
+
+#include <stdlib.h>
+
+#define CACHE_LINE_SIZE 64
+
+struct ReduceJob {
+    const struct ReduceOps *ops;
+    void *ctx;
+    size_t begin;
+    size_t end;
+    size_t chunk;
+    char *accs;     // аккумуляторы потоков
+    size_t stride;  // acc_size, округлённый до кэш-линии
+};
+
+static size_t RoundUp(size_t value, size_t grain) {
+    if (grain <= 1)
+        return value;
+    return (value + grain - 1) / grain * grain;
+}
+
+size_t ReduceChunkSize(size_t n, int threads, size_t grain) {
+    size_t parts = (size_t)(threads > 0 ? threads : 1) * REDUCE_CHUNKS_PER_THREAD;
+    size_t chunk = RoundUp((n + parts - 1) / parts, grain);
+    return chunk > 0 ? chunk : 1;
+}
+
+void ReduceSplit(size_t begin, size_t end, size_t grain, int parts, int part,
+                 size_t *part_begin, size_t *part_end) {
+    if (grain == 0)
+        grain = 1;
+
+    // Делим по группам из grain элементов; неполной может быть только
+    // последняя группа
+    size_t groups = (end - begin + grain - 1) / grain;
+    size_t first = groups * part / parts;
+    size_t last = groups * (part + 1) / parts;
+
+    *part_begin = begin + first * grain;
+    *part_end = begin + last * grain;
+    if (*part_begin > end)
+        *part_begin = end;
+    if (*part_end > end)
+        *part_end = end;
+}
+
+static void ReduceChunk(void *arg, size_t index, int worker) {
+    struct ReduceJob *job = arg;
+    size_t begin = job->begin + index * job->chunk;
+    size_t end = begin + job->chunk;
+    if (end > job->end)
+        end = job->end;
+
+    void *acc = job->accs ? job->accs + job->stride * worker : NULL;
+    job->ops->accumulate(acc, begin, end, job->ctx);
+}
+
+static bool RunJob(struct WorkPool *pool, const struct ReduceOps *ops, void *ctx,
+                   size_t begin, size_t end, size_t chunk, void *result,
+                   bool pinned) {
+    int threads = WorkPoolThreads(pool);
+    if (ops->acc_size > 0)
+        ops->init(result, ctx);
+    if (end <= begin)
+        return true;
+
+    struct ReduceJob job = {ops, ctx, begin, end, chunk, NULL, 0};
+    if (job.chunk == 0)
+        job.chunk = ReduceChunkSize(end - begin, threads, ops->grain);
+    else
+        job.chunk = RoundUp(job.chunk, ops->grain);
+
+    if (ops->acc_size > 0) {
+        job.stride = RoundUp(ops->acc_size, CACHE_LINE_SIZE);
+        job.accs = aligned_alloc(CACHE_LINE_SIZE, job.stride * threads);
+        if (!job.accs)
+            return false;
+        for (int i = 0; i < threads; i++)
+            ops->init(job.accs + job.stride * i, ctx);
+    }
+
+    size_t chunks = (end - begin + job.chunk - 1) / job.chunk;
+    bool ok = pinned ? WorkPoolRunPinned(pool, ReduceChunk, &job, chunks)
+                     : WorkPoolRun(pool, ReduceChunk, &job, chunks);
+
+    if (job.accs) {
+        for (int i = 0; i < threads; i++)
+            ops->combine(result, job.accs + job.stride * i, ctx);
+        free(job.accs);
+    }
+    return ok;
+}
+
+bool ReduceRun(struct WorkPool *pool, const struct ReduceOps *ops, void *ctx,
+               size_t begin, size_t end, size_t chunk, void *result) {
+    return RunJob(pool, ops, ctx, begin, end, chunk, result, false);
+}
+
+bool ReduceRunPinned(struct WorkPool *pool, const struct ReduceOps *ops,
+                     void *ctx, size_t begin, size_t end, size_t chunk,
+                     void *result) {
+    return RunJob(pool, ops, ctx, begin, end, chunk, result, true);
+}
@@ -0,0 +1,54 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "work_pool.h"
+
+// Параллельная редукция по диапазону индексов [begin, end).
+//
+// Диапазон режется на части по chunk индексов, части выполняются в пуле
+// WorkPool. Каждый поток копит результат в своём аккумуляторе (по
+// отдельной кэш-линии на поток), после пакета аккумуляторы сводятся
+// combine в вызывающем потоке. Операция должна быть ассоциативной и
+// коммутативной: порядок частей и потоков не фиксирован.
+//
+// accumulate получает сразу целую часть, а не один элемент: так ядро
+// может держать аккумулятор в регистрах и использовать SIMD.
+struct ReduceOps {
+    size_t acc_size;  // 0 - редукция без результата (параллельный цикл)
+
+    // Границы частей кратны grain относительно begin (0 или 1 - любые),
+    // например числу элементов в кэш-линии
+    size_t grain;
+
+    void (*init)(void *acc, void *ctx);
+    void (*accumulate)(void *acc, size_t begin, size_t end, void *ctx);
+    void (*combine)(void *acc, const void *other, void *ctx);
+};
+
+// Частей на поток по умолчанию: больше частей - лучше балансировка за
+// счёт перехвата, меньше - меньше накладных расходов
+#define REDUCE_CHUNKS_PER_THREAD 4
+
+// Размер части для n элементов на threads потоках, кратный grain
+size_t ReduceChunkSize(size_t n, int threads, size_t grain);
+
+// Границы part-й из parts равных частей [begin, end), с учётом grain.
+// Для исполнителей вне пула, например дочерних процессов.
+void ReduceSplit(size_t begin, size_t end, size_t grain, int parts, int part,
+                 size_t *part_begin, size_t *part_end);
+
+// Редукция с записью в result (acc_size байт). chunk == 0 - размер по
+// ReduceChunkSize. false, если не хватило памяти.
+bool ReduceRun(struct WorkPool *pool, const struct ReduceOps *ops, void *ctx,
+               size_t begin, size_t end, size_t chunk, void *result);
+
+// То же через WorkPoolRunPinned: части не перехватываются, и два прогона
+// по одному диапазону с одним chunk делят его между потоками одинаково
+bool ReduceRunPinned(struct WorkPool *pool, const struct ReduceOps *ops,
+                     void *ctx, size_t begin, size_t end, size_t chunk,
+                     void *result);
+
+#endif // REDUCE_H
@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+
+#include "work_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Пакет задач одного вызова WorkPoolRun; живёт на стеке вызывающего
+struct WorkBatch {
+    atomic_size_t remaining;
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+    bool finished;
+};
+
+struct WorkTask {
+    WorkPoolFunc func;
+    void *arg;
+    size_t index;
+    bool stealable;
+    struct WorkBatch *batch;
+};
+
+// Очередь одного потока: владелец берёт задачи с головы, чтобы идти по
+// своему блоку по порядку, остальные потоки перехватывают с хвоста
+struct WorkDeque {
+    pthread_mutex_t mutex;
+    struct WorkTask *tasks;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct WorkPool {
+    pthread_t *threads;
+    int threads_num;
+    int started;  // успешно запущенные потоки
+    bool pin;
+    struct WorkDeque *deques;
+
+    // Задачи во всех очередях, которые можно перехватить; увеличивается
+    // до постановки в очередь, поэтому поток, увидевший 0 и пустую свою
+    // очередь под mutex, может спать спокойно
+    atomic_size_t queued;
+    atomic_size_t stolen;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    bool stopping;
+};
+
+struct WorkerArgs {
+    struct WorkPool *pool;
+    int id;
+};
+
+static void PinToCpu(int id) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0)
+        cpus = 1;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(id % cpus, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static bool PopHead(struct WorkDeque *deque, struct WorkTask *task) {
+    pthread_mutex_lock(&deque->mutex);
+    bool found = deque->head < deque->tail;
+    if (found)
+        *task = deque->tasks[deque->head++];
+    pthread_mutex_unlock(&deque->mutex);
+    return found;
+}
+
+static bool PopTail(struct WorkDeque *deque, struct WorkTask *task) {
+    pthread_mutex_lock(&deque->mutex);
+    bool found = deque->head < deque->tail && deque->tasks[deque->tail - 1].stealable;
+    if (found)
+        *task = deque->tasks[--deque->tail];
+    pthread_mutex_unlock(&deque->mutex);
+    return found;
+}
+
+// Постановка задач [first, last) пакета в очередь потока
+static bool PushBlock(struct WorkDeque *deque, WorkPoolFunc func, void *arg,
+                      size_t first, size_t last, bool stealable,
+                      struct WorkBatch *batch) {
+    size_t count = last - first;
+    pthread_mutex_lock(&deque->mutex);
+
+    if (deque->head == deque->tail)
+        deque->head = deque->tail = 0;
+    if (deque->tail + count > deque->capacity) {
+        // Сдвигаем оставшиеся задачи в начало и при нужде растём
+        size_t pending = deque->tail - deque->head;
+        size_t capacity = deque->capacity;
+        while (pending + count > capacity)
+            capacity = capacity ? capacity * 2 : 64;
+        struct WorkTask *tasks = deque->tasks;
+        if (capacity != deque->capacity) {
+            tasks = malloc(sizeof(struct WorkTask) * capacity);
+            if (!tasks) {
+                pthread_mutex_unlock(&deque->mutex);
+                return false;
+            }
+        }
+        for (size_t i = 0; i < pending; i++)
+            tasks[i] = deque->tasks[deque->head + i];
+        if (tasks != deque->tasks)
+            free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+        deque->head = 0;
+        deque->tail = pending;
+    }
+
+    for (size_t i = first; i < last; i++) {
+        struct WorkTask *task = &deque->tasks[deque->tail++];
+        task->func = func;
+        task->arg = arg;
+        task->index = i;
+        task->stealable = stealable;
+        task->batch = batch;
+    }
+
+    pthread_mutex_unlock(&deque->mutex);
+    return true;
+}
+
+static bool OwnQueueEmpty(struct WorkDeque *deque) {
+    pthread_mutex_lock(&deque->mutex);
+    bool empty = deque->head == deque->tail;
+    pthread_mutex_unlock(&deque->mutex);
+    return empty;
+}
+
+static bool TakeTask(struct WorkPool *pool, int id, struct WorkTask *task) {
+    if (PopHead(&pool->deques[id], task))
+        return true;
+
+    for (int i = 1; i < pool->threads_num; i++) {
+        if (PopTail(&pool->deques[(id + i) % pool->threads_num], task)) {
+            atomic_fetch_add_explicit(&pool->stolen, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Снимает с пакета done задач; последний будит ожидающего WorkPoolRun
+static void FinishTasks(struct WorkBatch *batch, size_t done) {
+    if (atomic_fetch_sub(&batch->remaining, done) != done)
+        return;
+
+    pthread_mutex_lock(&batch->mutex);
+    batch->finished = true;
+    pthread_cond_signal(&batch->done);
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+static void *WorkPoolWorker(void *arg) {
+    struct WorkerArgs args = *(struct WorkerArgs *)arg;
+    free(arg);
+    struct WorkPool *pool = args.pool;
+    if (pool->pin)
+        PinToCpu(args.id);
+
+    while (true) {
+        struct WorkTask task;
+        if (TakeTask(pool, args.id, &task)) {
+            if (task.stealable)
+                atomic_fetch_sub(&pool->queued, 1);
+            task.func(task.arg, task.index, args.id);
+            FinishTasks(task.batch, 1);
+            continue;
+        }
+
+        // Закреплённые задачи лежат только в очереди своего потока, в
+        // queued они не учитываются
+        struct WorkDeque *own = &pool->deques[args.id];
+        pthread_mutex_lock(&pool->mutex);
+        while (atomic_load(&pool->queued) == 0 && OwnQueueEmpty(own) &&
+               !pool->stopping)
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        bool stop = pool->stopping && atomic_load(&pool->queued) == 0 &&
+                    OwnQueueEmpty(own);
+        pthread_mutex_unlock(&pool->mutex);
+
+        // Если задачи учтены, но ещё не поставлены в очередь, следующий
+        // TakeTask повторит попытку
+        if (stop)
+            break;
+    }
+
+    return NULL;
+}
+
+struct WorkPool *WorkPoolCreate(int threads_num, bool pin) {
+    if (threads_num <= 0)
+        return NULL;
+
+    struct WorkPool *pool = calloc(1, sizeof(struct WorkPool));
+    if (!pool)
+        return NULL;
+    pool->threads = malloc(sizeof(pthread_t) * threads_num);
+    pool->deques = aligned_alloc(CACHE_LINE_SIZE,
+                                 sizeof(struct WorkDeque) * threads_num);
+    if (!pool->threads || !pool->deques) {
+        free(pool->threads);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pool->pin = pin;
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->stolen, 0);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    for (int i = 0; i < threads_num; i++) {
+        pthread_mutex_init(&pool->deques[i].mutex, NULL);
+        pool->deques[i].tasks = NULL;
+        pool->deques[i].capacity = 0;
+        pool->deques[i].head = 0;
+        pool->deques[i].tail = 0;
+    }
+
+    // Потоки перехватывают задачи из всех очередей, поэтому число
+    // очередей фиксируется до запуска первого потока
+    pool->threads_num = threads_num;
+    for (int i = 0; i < threads_num; i++) {
+        struct WorkerArgs *args = malloc(sizeof(struct WorkerArgs));
+        if (args) {
+            args->pool = pool;
+            args->id = i;
+        }
+        if (!args || pthread_create(&pool->threads[i], NULL, WorkPoolWorker, args)) {
+            free(args);
+            fprintf(stderr, "Error: pthread_create failed!\n");
+            WorkPoolDestroy(pool);
+            return NULL;
+        }
+        pool->started++;
+    }
+
+    return pool;
+}
+
+int WorkPoolThreads(const struct WorkPool *pool) {
+    return pool->threads_num;
+}
+
+static bool RunBatch(struct WorkPool *pool, WorkPoolFunc func, void *arg,
+                     size_t count, bool stealable) {
+    if (count == 0)
+        return true;
+
+    struct WorkBatch batch;
+    atomic_init(&batch.remaining, count);
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.done, NULL);
+    batch.finished = false;
+
+    if (stealable)
+        atomic_fetch_add(&pool->queued, count);
+
+    // Поток i получает непрерывный блок индексов, чтобы соседние задачи
+    // (и, как правило, соседние данные) обрабатывались одним потоком
+    bool ok = true;
+    size_t threads = (size_t)pool->threads_num;
+    for (size_t i = 0; i < threads; i++) {
+        size_t first = count * i / threads;
+        size_t last = count * (i + 1) / threads;
+        if (first == last)
+            continue;
+        if (!PushBlock(&pool->deques[i], func, arg, first, last, stealable,
+                       &batch)) {
+            if (stealable)
+                atomic_fetch_sub(&pool->queued, last - first);
+            FinishTasks(&batch, last - first);
+            ok = false;
+        }
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_lock(&batch.mutex);
+    while (!batch.finished)
+        pthread_cond_wait(&batch.done, &batch.mutex);
+    pthread_mutex_unlock(&batch.mutex);
+
+    pthread_cond_destroy(&batch.done);
+    pthread_mutex_destroy(&batch.mutex);
+    return ok;
+}
+
+bool WorkPoolRun(struct WorkPool *pool, WorkPoolFunc func, void *arg,
+                 size_t count) {
+    return RunBatch(pool, func, arg, count, true);
+}
+
+bool WorkPoolRunPinned(struct WorkPool *pool, WorkPoolFunc func, void *arg,
+                       size_t count) {
+    return RunBatch(pool, func, arg, count, false);
+}
+
+size_t WorkPoolStolen(const struct WorkPool *pool) {
+    return atomic_load_explicit(&((struct WorkPool *)pool)->stolen,
+                                memory_order_relaxed);
+}
+
+void WorkPoolDestroy(struct WorkPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->started; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    for (int i = 0; i < pool->threads_num; i++) {
+        pthread_mutex_destroy(&pool->deques[i].mutex);
+        free(pool->deques[i].tasks);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+}
@@ -0,0 +1,48 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Постоянный пул потоков с перехватом работы (work stealing).
+//
+// У каждого потока своя очередь задач. Пакет из count задач
+// раскладывается по очередям непрерывными блоками индексов: поток i
+// получает i-ю часть диапазона и выполняет её по порядку. Освободившийся
+// поток забирает задачи с другого конца чужой очереди, так что отставший
+// поток не задерживает весь пакет.
+//
+// Потоки создаются один раз и спят между пакетами, поэтому пул можно
+// переиспользовать для многих редукций подряд.
+
+struct WorkPool;
+
+// Задача пакета: index - номер задачи в пакете, worker - номер
+// выполняющего потока (0..threads_num-1)
+typedef void (*WorkPoolFunc)(void *arg, size_t index, int worker);
+
+// Запуск threads_num потоков. При pin поток i привязывается к
+// процессору i по модулю числа процессоров. NULL при ошибке.
+struct WorkPool *WorkPoolCreate(int threads_num, bool pin);
+
+int WorkPoolThreads(const struct WorkPool *pool);
+
+// Выполнение func(arg, i, worker) для i из [0, count); возвращается
+// после завершения всех задач. false, если не хватило памяти.
+bool WorkPoolRun(struct WorkPool *pool, WorkPoolFunc func, void *arg,
+                 size_t count);
+
+// То же без перехвата: задача выполняется тем потоком, в чью очередь
+// попала, так что при одинаковом count поток i каждый раз получает один
+// и тот же блок индексов. Нужно, когда важно, какой поток (и какой узел
+// NUMA) трогает данные, - ценой балансировки.
+bool WorkPoolRunPinned(struct WorkPool *pool, WorkPoolFunc func, void *arg,
+                       size_t count);
+
+// Число задач, выполненных потоками не из своей очереди
+size_t WorkPoolStolen(const struct WorkPool *pool);
+
+// Останавливает потоки; пакеты к этому моменту должны быть завершены
+void WorkPoolDestroy(struct WorkPool *pool);
+
+#endif // WORK_POOL_H